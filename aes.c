@@ -1,6 +1,9 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdint.h>
 #include <string.h>
+#include <stdlib.h>
+#include "bench.h"
 
 // AES-128 constants
 #define Nk 4  // Number of 32-bit words in the key (128 bits / 32 bits = 4)
@@ -209,7 +212,59 @@ void aes_ecb_encrypt(uint8_t* output, const uint8_t* input, size_t input_len, co
 }
 
 
-int main() {
+typedef struct {
+    uint8_t *input, *output;
+    size_t len;
+    uint8_t key[16];
+    uint8_t round_key[Nb * (Nr + 1) * 4];
+} aes_bench_t;
+
+static void *aes_bench_setup(const bench_params_t *params, const void *arg) {
+    (void)arg;
+    aes_bench_t *b = malloc(sizeof(aes_bench_t));
+    b->len = params->size;
+    b->input = malloc(b->len);
+    b->output = malloc(b->len + 16);  // room for the PKCS#7 block
+    return b;
+}
+
+static void aes_bench_prepare(void *ctx) {
+    aes_bench_t *b = ctx;
+    bench_fill_random(b->input, b->len);
+    bench_fill_random(b->key, sizeof(b->key));
+    key_expansion(b->round_key, b->key);
+}
+
+// Full ECB call: key expansion, every block and the padding block
+static void aes_bench_run_ecb(void *ctx) {
+    aes_bench_t *b = ctx;
+    aes_ecb_encrypt(b->output, b->input, b->len, b->key);
+}
+
+// Block function only, with the round keys already expanded
+static void aes_bench_run_blocks(void *ctx) {
+    aes_bench_t *b = ctx;
+    for (size_t i = 0; i + 16 <= b->len; i += 16) {
+        aes_encrypt_block(b->output + i, b->input + i, b->round_key);
+    }
+}
+
+static void aes_bench_teardown(void *ctx) {
+    aes_bench_t *b = ctx;
+    free(b->input);
+    free(b->output);
+    free(b);
+}
+
+static const bench_case_t aes_cases[] = {
+    {.name = "aes128", .backend = "ecb", .setup = aes_bench_setup, .prepare = aes_bench_prepare,
+     .run = aes_bench_run_ecb, .teardown = aes_bench_teardown},
+    {.name = "aes128", .backend = "block", .setup = aes_bench_setup, .prepare = aes_bench_prepare,
+     .run = aes_bench_run_blocks, .teardown = aes_bench_teardown},
+};
+
+// Usage: ./aes [bench.h flags]; the test vectors always run first
+int main(int argc, char **argv) {
     printf("--- AES-128 Single Block Test Vector ---\n");
 
     // FIPS-197 Appendix B Test Vector
@@ -270,6 +325,13 @@ int main() {
     
     printf("Multi-block Ciphertext (ECB with PKCS#7 padding, %d bytes):\n", 48);
     print_hex(multi_block_ciphertext, 48);
-    
-    return 0;
+
+    printf("\n--- AES-128 Throughput ---\n");
+    bench_config_t cfg;
+    bench_config_init(&cfg, 1000, 10);
+    cfg.sizes[0] = 16;
+    cfg.sizes[1] = 4096;
+    cfg.sizes[2] = 65536;
+    cfg.num_sizes = 3;
+    return bench_main(aes_cases, sizeof(aes_cases) / sizeof(aes_cases[0]), &cfg, argc - 1, argv + 1);
 }
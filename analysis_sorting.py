@@ -12,7 +12,7 @@ columns = ['algo', 'size', 'min_cycles', 'max_cycles', 'avg_cycles', 'med_cycles
 df.columns = columns
 
 # Define the algorithms and metrics to plot
-algos = ['bubble', 'quick', 'merge', 'heap']
+algos = ['bubble', 'quick', 'merge', 'heap', 'pdq', 'radix_lsd', 'radix_msd', 'pmerge', 'simd_quick', 'simd_merge', 'heap_bu', 'heap4', 'heap8']
 metrics = ['cycles', 'comps', 'swaps']
 stats = ['min', 'max', 'avg', 'med']
 
@@ -0,0 +1,703 @@
+// Shared benchmark harness for the programs in this repository.
+//
+// Timing uses the TSC with fences on both sides (lfence; rdtsc; lfence to start, rdtscp; lfence
+// to stop), so the measured region cannot drift across the timestamps. The cost of an empty
+// start/stop pair is measured once and subtracted from every sample, and the TSC is calibrated
+// against CLOCK_MONOTONIC_RAW to report nanoseconds next to cycles.
+//
+// A program describes its algorithms as bench_case_t entries (name, backend, setup/prepare/run/
+// teardown callbacks) and hands them to bench_main(), which sweeps every case over the configured
+// sizes and thread counts, rejects outliers (median +/- k * MAD), prints a table and optionally
+// writes CSV and JSON. Common flags:
+//   --runs N --warmup N --sizes a,b,c --threads a,b --filter substr --outlier-k K
+//   --csv path --json path --no-pmu
+//
+// Hardware counters (instructions, cycles, L1D/LLC misses, branch misses, uops) are read through
+// perf_event_open around every timed run, user space only, so they work without root whenever
+// kernel.perf_event_paranoid <= 2. They are started before the first timestamp and stopped after
+// the second, so the TSC figures do not include the ioctl calls. Counters the CPU or kernel does
+// not offer (e.g. inside most VMs) are reported as "-" and the timing is unaffected.
+//
+// Needs _GNU_SOURCE defined before the first system header (for the CPU affinity calls).
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <math.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <cpuid.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/sysinfo.h>
+#include <time.h>
+#include <unistd.h>
+#include <x86intrin.h>
+#include "sort_typed.h"
+
+#define BENCH_MAX_SWEEP 32
+#define BENCH_MAX_EXTRA 4
+
+// ---------------------------------------------------------------------------
+// Timestamps
+
+static inline uint64_t bench_start(void) {
+    _mm_lfence();
+    uint64_t t = __rdtsc();
+    _mm_lfence();
+    return t;
+}
+
+static inline uint64_t bench_stop(void) {
+    unsigned int aux;
+    uint64_t t = __rdtscp(&aux);
+    _mm_lfence();
+    return t;
+}
+
+static inline uint64_t bench_raw_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// TSC ticks per second, measured once over ~20 ms of wall time
+static inline double bench_tsc_hz(void) {
+    static double hz = 0.0;
+    if (hz == 0.0) {
+        uint64_t n0 = bench_raw_ns(), c0 = bench_start();
+        while (bench_raw_ns() - n0 < 20000000ULL) {
+        }
+        uint64_t c1 = bench_stop(), n1 = bench_raw_ns();
+        hz = (double)(c1 - c0) * 1e9 / (double)(n1 - n0);
+    }
+    return hz;
+}
+
+static inline double bench_cycles_to_ns(double cycles) {
+    return cycles * 1e9 / bench_tsc_hz();
+}
+
+// Cycles read by an empty start/stop pair: the minimum over many tries, so subtracting it
+// never removes time the measured code actually spent
+static inline uint64_t bench_overhead(void) {
+    static uint64_t overhead = UINT64_MAX;
+    if (overhead == UINT64_MAX) {
+        uint64_t best = UINT64_MAX;
+        for (int i = 0; i < 10000; i++) {
+            uint64_t t0 = bench_start();
+            uint64_t t1 = bench_stop();
+            if (t1 - t0 < best) best = t1 - t0;
+        }
+        overhead = best;
+    }
+    return overhead;
+}
+
+// ---------------------------------------------------------------------------
+// Hardware performance counters
+
+enum {
+    BENCH_PMU_INSTRUCTIONS,
+    BENCH_PMU_CYCLES,       // core cycles, unlike the TSC these follow frequency scaling
+    BENCH_PMU_L1D_MISSES,
+    BENCH_PMU_LLC_MISSES,
+    BENCH_PMU_BRANCH_MISSES,
+    BENCH_PMU_UOPS,         // raw event: issued uops on Intel, retired ops on AMD
+    BENCH_PMU_COUNT
+};
+
+static const char *const bench_pmu_names[BENCH_PMU_COUNT] = {"instructions", "cycles", "l1d_misses",
+                                                             "llc_misses", "branch_misses", "uops"};
+
+typedef struct {
+    int fd[BENCH_PMU_COUNT];    // -1 when the event could not be opened
+    int leader;                 // fd the group is enabled and disabled through
+    int num_open;
+    int error;                  // errno of the first failed open, for the diagnostic
+    uint64_t base[BENCH_PMU_COUNT][3];  // value, time enabled, time running at bench_pmu_start
+} bench_pmu_t;
+
+// Raw uops event for the running CPU vendor, or 0 when there is no known encoding
+static inline uint64_t bench_pmu_uops_config(void) {
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid(0, &eax, &ebx, &ecx, &edx)) return 0;
+    if (ebx == 0x756e6547) return 0x010e;   // "Genu": UOPS_ISSUED.ANY (event 0x0e, umask 0x01)
+    if (ebx == 0x68747541) return 0x00c1;   // "Auth": EX_RET_OPS (event 0xc1)
+    return 0;
+}
+
+static inline void bench_pmu_attr(int event, struct perf_event_attr *attr) {
+    memset(attr, 0, sizeof(*attr));
+    attr->size = sizeof(*attr);
+    attr->type = PERF_TYPE_HARDWARE;
+    switch (event) {
+    case BENCH_PMU_INSTRUCTIONS: attr->config = PERF_COUNT_HW_INSTRUCTIONS; break;
+    case BENCH_PMU_CYCLES: attr->config = PERF_COUNT_HW_CPU_CYCLES; break;
+    case BENCH_PMU_L1D_MISSES:
+        attr->type = PERF_TYPE_HW_CACHE;
+        attr->config = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                       (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        break;
+    case BENCH_PMU_LLC_MISSES: attr->config = PERF_COUNT_HW_CACHE_MISSES; break;
+    case BENCH_PMU_BRANCH_MISSES: attr->config = PERF_COUNT_HW_BRANCH_MISSES; break;
+    case BENCH_PMU_UOPS:
+        attr->type = PERF_TYPE_RAW;
+        attr->config = bench_pmu_uops_config();
+        break;
+    }
+    // User space only (allowed at paranoid 2); inherit follows threads the run creates
+    attr->disabled = 1;
+    attr->exclude_kernel = 1;
+    attr->exclude_hv = 1;
+    attr->inherit = 1;
+    attr->read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+}
+
+// Open the counters for the calling thread as one group so they are scheduled together. Events
+// that fail to open are left out; returns the number that opened.
+static inline int bench_pmu_open(bench_pmu_t *pmu) {
+    pmu->leader = -1;
+    pmu->num_open = 0;
+    pmu->error = 0;
+    for (int e = 0; e < BENCH_PMU_COUNT; e++) {
+        pmu->fd[e] = -1;
+        struct perf_event_attr attr;
+        bench_pmu_attr(e, &attr);
+        if (attr.type == PERF_TYPE_RAW && attr.config == 0) continue;
+        if (pmu->leader >= 0) attr.disabled = 0;    // members follow the leader
+        int fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, pmu->leader, 0);
+        if (fd < 0) {
+            if (!pmu->error) pmu->error = errno;
+            continue;
+        }
+        pmu->fd[e] = fd;
+        if (pmu->leader < 0) pmu->leader = fd;
+        pmu->num_open++;
+    }
+    return pmu->num_open;
+}
+
+static inline void bench_pmu_close(bench_pmu_t *pmu) {
+    for (int e = 0; e < BENCH_PMU_COUNT; e++) {
+        if (pmu->fd[e] >= 0) close(pmu->fd[e]);
+        pmu->fd[e] = -1;
+    }
+    pmu->leader = -1;
+    pmu->num_open = 0;
+}
+
+// Snapshot the counts and enable the group. Runs are measured as differences from this snapshot
+// rather than after PERF_EVENT_IOC_RESET: reset only clears live threads, while the counts of
+// inherited threads that have exited stay folded into the parent event.
+static inline void bench_pmu_start(bench_pmu_t *pmu) {
+    if (pmu->leader < 0) return;
+    for (int e = 0; e < BENCH_PMU_COUNT; e++) {
+        uint64_t *base = pmu->base[e];
+        if (pmu->fd[e] < 0 || read(pmu->fd[e], base, 3 * sizeof(uint64_t)) != 3 * (ssize_t)sizeof(uint64_t)) {
+            base[0] = base[1] = base[2] = 0;
+        }
+    }
+    ioctl(pmu->leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+}
+
+// Stop the group and store each count since bench_pmu_start, scaled up if the kernel multiplexed
+// it, in values (NAN for events that are not open)
+static inline void bench_pmu_stop(bench_pmu_t *pmu, double values[BENCH_PMU_COUNT]) {
+    if (pmu->leader >= 0) ioctl(pmu->leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+    for (int e = 0; e < BENCH_PMU_COUNT; e++) {
+        uint64_t buf[3];    // value, time enabled, time running
+        if (pmu->fd[e] < 0 || read(pmu->fd[e], buf, sizeof(buf)) != (ssize_t)sizeof(buf)) {
+            values[e] = NAN;
+            continue;
+        }
+        double count = (double)(buf[0] - pmu->base[e][0]);
+        uint64_t enabled = buf[1] - pmu->base[e][1], running = buf[2] - pmu->base[e][2];
+        values[e] = running && running < enabled ? count * (double)enabled / (double)running : count;
+    }
+}
+
+// Why nothing opened, for the note printed before the table
+static inline void bench_pmu_explain(const bench_pmu_t *pmu) {
+    int paranoid = -1;
+    FILE *fp = fopen("/proc/sys/kernel/perf_event_paranoid", "r");
+    if (fp) {
+        if (fscanf(fp, "%d", &paranoid) != 1) paranoid = -1;
+        fclose(fp);
+    }
+    printf("Hardware counters unavailable (%s, perf_event_paranoid = %d); IPC and miss rates omitted\n",
+           strerror(pmu->error ? pmu->error : ENOENT), paranoid);
+}
+
+// ---------------------------------------------------------------------------
+// Environment and inputs
+
+// Cores reserved by bench_setup_no_interruptions; count stays 0 until a reservation succeeds
+static int bench_reserved_first = 0;
+static int bench_reserved_count = 0;
+
+// Pin to the last `cores` cores, switch to SCHED_FIFO and lock memory. Each step is best effort:
+// a failure (too few cores, no privileges) is reported on stderr and the benchmark carries on.
+// Returns the number of steps that failed.
+static inline int bench_setup_no_interruptions(int cores) {
+    int failed = 0;
+    int num_cores = get_nprocs();
+    if (num_cores < cores) {
+        fprintf(stderr, "bench: only %d core(s); cannot set %d aside\n", num_cores, cores);
+        failed++;
+    } else {
+        cpu_set_t cpu_mask;
+        CPU_ZERO(&cpu_mask);
+        for (int c = num_cores - cores; c < num_cores; c++) CPU_SET(c, &cpu_mask);
+        if (sched_setaffinity(0, sizeof(cpu_mask), &cpu_mask) == -1) {
+            perror("bench: failed to set CPU affinity");
+            failed++;
+        } else {
+            bench_reserved_first = num_cores - cores;
+            bench_reserved_count = cores;
+        }
+    }
+
+    struct sched_param sched_params;
+    sched_params.sched_priority = sched_get_priority_max(SCHED_FIFO);
+    if (sched_setscheduler(0, SCHED_FIFO, &sched_params) == -1) {
+        perror("bench: failed to set real-time scheduling");
+        failed++;
+    }
+
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) == -1) {
+        perror("bench: failed to lock memory");
+        failed++;
+    }
+    return failed;
+}
+
+// Core for worker t: round robin over the reserved cores, or over every core if none were reserved
+static inline int bench_worker_core(int t) {
+    if (bench_reserved_count > 0) return bench_reserved_first + t % bench_reserved_count;
+    return t % get_nprocs();
+}
+
+// The LCG the stream-cipher benchmarks have always used for keys and plaintexts
+static uint32_t bench_lcg_seed = 123456789;
+
+static inline uint32_t bench_lcg_rand(void) {
+    bench_lcg_seed = (1103515245 * bench_lcg_seed + 12345) & 0x7fffffff;
+    return bench_lcg_seed;
+}
+
+static inline void bench_fill_random(uint8_t *buf, size_t len) {
+    for (size_t i = 0; i < len; ++i) {
+        buf[i] = (uint8_t)(bench_lcg_rand() & 0xff);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Cases, configuration and results
+
+typedef struct {
+    size_t size;        // problem size: bytes for ciphers, elements for sorts, bits for RSA
+    int threads;
+} bench_params_t;
+
+typedef struct {
+    const char *name;       // algorithm
+    const char *backend;    // implementation variant
+    void *(*setup)(const bench_params_t *params, const void *arg); // allocate inputs, returns the context
+    void (*prepare)(void *ctx);                       // untimed, before each run (fresh inputs)
+    void (*run)(void *ctx);                           // the timed region
+    void (*teardown)(void *ctx);
+    size_t bytes_per_run;   // for cycles per byte; 0 = params.size, SIZE_MAX = not a byte stream
+    int num_extra;          // per-run counters reported by extra(), e.g. comparisons
+    const char *extra_names[BENCH_MAX_EXTRA];
+    void (*extra)(void *ctx, double *values);
+    int max_threads;        // 0 = the case ignores the thread sweep (runs once, at threads = 1)
+    const void *arg;        // passed to setup, so one set of callbacks can serve several cases
+} bench_case_t;
+
+typedef struct {
+    int runs, warmup;
+    double outlier_k;
+    size_t sizes[BENCH_MAX_SWEEP];
+    int num_sizes;
+    int threads[BENCH_MAX_SWEEP];
+    int num_threads;
+    const char *filter;
+    const char *csv_path, *json_path;
+    int quiet;
+    int no_pmu;             // skip the hardware counters
+} bench_config_t;
+
+typedef struct {
+    double min, max, mean, median;
+} bench_summary_t;
+
+typedef struct {
+    const bench_case_t *bc;
+    bench_params_t params;
+    int runs, rejected;
+    double min, max, median, mean, p99, stddev;  // cycles per run, overhead removed, outliers dropped
+    double mean_ns, cpb;
+    bench_summary_t extra[BENCH_MAX_EXTRA];
+    double pmu[BENCH_PMU_COUNT];    // mean counts per run, NAN where unavailable
+    double ipc;                     // instructions per core cycle
+    double l1d_mpki, llc_mpki, br_mpki;  // misses per 1000 instructions
+    double upi;                     // uops per instruction
+} bench_result_t;
+
+static inline void bench_config_init(bench_config_t *cfg, int runs, int warmup) {
+    memset(cfg, 0, sizeof(*cfg));
+    cfg->runs = runs;
+    cfg->warmup = warmup;
+    cfg->outlier_k = 5.0;
+}
+
+static inline int bench_parse_list(const char *s, size_t *sizes, int *ints, int max) {
+    int n = 0;
+    while (*s && n < max) {
+        char *end;
+        unsigned long long v = strtoull(s, &end, 10);
+        if (end == s) break;
+        if (*end == 'k' || *end == 'K') v <<= 10, end++;
+        else if (*end == 'm' || *end == 'M') v <<= 20, end++;
+        if (sizes) sizes[n] = (size_t)v;
+        if (ints) ints[n] = (int)v;
+        n++;
+        s = *end == ',' ? end + 1 : end;
+    }
+    return n;
+}
+
+// Apply command-line flags on top of the program's defaults; returns -1 on an unknown flag
+static inline int bench_parse_args(bench_config_t *cfg, int argc, char **argv) {
+    for (int i = 0; i < argc; i++) {
+        const char *a = argv[i], *v = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(a, "--quiet") == 0) {
+            cfg->quiet = 1;
+            continue;
+        }
+        if (strcmp(a, "--no-pmu") == 0) {
+            cfg->no_pmu = 1;
+            continue;
+        }
+        if (!v) {
+            fprintf(stderr, "bench: %s needs a value\n", a);
+            return -1;
+        }
+        if (strcmp(a, "--runs") == 0) cfg->runs = atoi(v);
+        else if (strcmp(a, "--warmup") == 0) cfg->warmup = atoi(v);
+        else if (strcmp(a, "--outlier-k") == 0) cfg->outlier_k = atof(v);
+        else if (strcmp(a, "--sizes") == 0) cfg->num_sizes = bench_parse_list(v, cfg->sizes, NULL, BENCH_MAX_SWEEP);
+        else if (strcmp(a, "--threads") == 0) cfg->num_threads = bench_parse_list(v, NULL, cfg->threads, BENCH_MAX_SWEEP);
+        else if (strcmp(a, "--filter") == 0) cfg->filter = v;
+        else if (strcmp(a, "--csv") == 0) cfg->csv_path = v;
+        else if (strcmp(a, "--json") == 0) cfg->json_path = v;
+        else {
+            fprintf(stderr, "bench: unknown option %s\n", a);
+            return -1;
+        }
+        i++;
+    }
+    return 0;
+}
+
+// Median by selection, reordering xs: for even n the lower middle is the largest element left
+// of the upper one
+static inline double bench_median(double *xs, int n) {
+    sort_double_nth_element(xs, (size_t)n, (size_t)(n / 2));
+    double upper = xs[n / 2];
+    if (n % 2) return upper;
+    double lower = xs[0];
+    for (int i = 1; i < n / 2; i++) lower = xs[i] > lower ? xs[i] : lower;
+    return (lower + upper) / 2.0;
+}
+
+// Summary statistics; xs is reordered
+static inline bench_summary_t bench_summarize(double *xs, int n) {
+    bench_summary_t s = {0, 0, 0, 0};
+    if (n == 0) return s;
+    double sum = 0;
+    s.min = s.max = xs[0];
+    for (int i = 0; i < n; i++) {
+        sum += xs[i];
+        s.min = xs[i] < s.min ? xs[i] : s.min;
+        s.max = xs[i] > s.max ? xs[i] : s.max;
+    }
+    s.mean = sum / n;
+    s.median = bench_median(xs, n);
+    return s;
+}
+
+// a / b scaled, NAN when either side was not counted
+static inline double bench_pmu_ratio(double a, double b, double scale) {
+    return isnan(a) || isnan(b) || b == 0 ? NAN : a * scale / b;
+}
+
+// Measure one case at one parameter point; pmu may be NULL to skip the counters
+static inline void bench_run_case(const bench_case_t *bc, const bench_params_t *params, const bench_config_t *cfg,
+                                  bench_pmu_t *pmu, bench_result_t *res) {
+    uint64_t overhead = bench_overhead();
+    double pmu_sum[BENCH_PMU_COUNT] = {0};
+    int runs = cfg->runs > 0 ? cfg->runs : 1;
+    double *samples = malloc((size_t)runs * sizeof(double));
+    double *extra = bc->num_extra ? malloc((size_t)runs * bc->num_extra * sizeof(double)) : NULL;
+
+    void *ctx = bc->setup ? bc->setup(params, bc->arg) : NULL;
+    for (int i = 0; i < cfg->warmup; i++) {
+        if (bc->prepare) bc->prepare(ctx);
+        bc->run(ctx);
+    }
+    for (int i = 0; i < runs; i++) {
+        if (bc->prepare) bc->prepare(ctx);
+        if (pmu) bench_pmu_start(pmu);
+        uint64_t t0 = bench_start();
+        bc->run(ctx);
+        uint64_t t1 = bench_stop();
+        if (pmu) {
+            double counts[BENCH_PMU_COUNT];
+            bench_pmu_stop(pmu, counts);
+            for (int e = 0; e < BENCH_PMU_COUNT; e++) pmu_sum[e] += counts[e];
+        }
+        uint64_t c = t1 - t0;
+        samples[i] = (double)(c > overhead ? c - overhead : 0);
+        if (bc->num_extra) {
+            double values[BENCH_MAX_EXTRA];
+            bc->extra(ctx, values);
+            for (int k = 0; k < bc->num_extra; k++) extra[(size_t)k * runs + i] = values[k];
+        }
+    }
+    if (bc->teardown) bc->teardown(ctx);
+
+    // Outliers: farther than k scaled MADs from the median
+    memset(res, 0, sizeof(*res));
+    res->bc = bc;
+    res->params = *params;
+    double median = bench_median(samples, runs);
+    double *dev = malloc((size_t)runs * sizeof(double));
+    for (int i = 0; i < runs; i++) dev[i] = fabs(samples[i] - median);
+    double mad = 1.4826 * bench_median(dev, runs);
+    free(dev);
+    // Move the kept samples to the front; only the p99 needs any order among them
+    int kept = runs;
+    if (mad > 0 && cfg->outlier_k > 0) {
+        kept = 0;
+        for (int i = 0; i < runs; i++) {
+            if (fabs(samples[i] - median) <= cfg->outlier_k * mad) samples[kept++] = samples[i];
+        }
+    }
+    double sum = 0, sq = 0, min = samples[0], max = samples[0];
+    for (int i = 0; i < kept; i++) {
+        sum += samples[i];
+        min = samples[i] < min ? samples[i] : min;
+        max = samples[i] > max ? samples[i] : max;
+    }
+    double mean = sum / kept;
+    for (int i = 0; i < kept; i++) sq += (samples[i] - mean) * (samples[i] - mean);
+
+    res->runs = runs;
+    res->rejected = runs - kept;
+    res->min = min;
+    res->max = max;
+    res->median = median;
+    res->mean = mean;
+    int p99 = (int)ceil(0.99 * kept) - 1;
+    if (p99 < 0) p99 = 0;
+    sort_double_nth_element(samples, (size_t)kept, (size_t)p99);
+    res->p99 = samples[p99];
+    res->stddev = kept > 1 ? sqrt(sq / (kept - 1)) : 0.0;
+    res->mean_ns = bench_cycles_to_ns(mean);
+    size_t bytes = bc->bytes_per_run ? bc->bytes_per_run : params->size;
+    res->cpb = bytes == SIZE_MAX || bytes == 0 ? 0.0 : mean / (double)bytes;
+    for (int k = 0; k < bc->num_extra; k++) res->extra[k] = bench_summarize(extra + (size_t)k * runs, runs);
+    // Counters are averaged over every timed run, outliers included
+    for (int e = 0; e < BENCH_PMU_COUNT; e++) res->pmu[e] = pmu ? pmu_sum[e] / runs : NAN;
+    res->ipc = bench_pmu_ratio(res->pmu[BENCH_PMU_INSTRUCTIONS], res->pmu[BENCH_PMU_CYCLES], 1.0);
+    res->l1d_mpki = bench_pmu_ratio(res->pmu[BENCH_PMU_L1D_MISSES], res->pmu[BENCH_PMU_INSTRUCTIONS], 1000.0);
+    res->llc_mpki = bench_pmu_ratio(res->pmu[BENCH_PMU_LLC_MISSES], res->pmu[BENCH_PMU_INSTRUCTIONS], 1000.0);
+    res->br_mpki = bench_pmu_ratio(res->pmu[BENCH_PMU_BRANCH_MISSES], res->pmu[BENCH_PMU_INSTRUCTIONS], 1000.0);
+    res->upi = bench_pmu_ratio(res->pmu[BENCH_PMU_UOPS], res->pmu[BENCH_PMU_INSTRUCTIONS], 1.0);
+
+    free(samples);
+    free(extra);
+}
+
+static inline void bench_print_header(int pmu) {
+    printf("%-16s %-12s %10s %4s %8s %5s %14s %14s %14s %14s %10s", "name", "backend", "size", "thr", "runs", "rej",
+           "min_cyc", "median_cyc", "mean_cyc", "p99_cyc", "cpb");
+    if (pmu) printf(" %6s %9s %9s %9s %6s", "ipc", "l1d_mpki", "llc_mpki", "br_mpki", "upi");
+    printf("\n");
+}
+
+// Fixed-width value, or "-" when the counter was not available
+static inline void bench_print_metric(double v, int width, int prec) {
+    if (isnan(v)) printf(" %*s", width, "-");
+    else printf(" %*.*f", width, prec, v);
+}
+
+static inline void bench_print_result(const bench_result_t *r, int pmu) {
+    printf("%-16s %-12s %10zu %4d %8d %5d %14.0f %14.0f %14.1f %14.0f %10.3f", r->bc->name, r->bc->backend,
+           r->params.size, r->params.threads, r->runs, r->rejected, r->min, r->median, r->mean, r->p99, r->cpb);
+    if (pmu) {
+        bench_print_metric(r->ipc, 6, 2);
+        bench_print_metric(r->l1d_mpki, 9, 3);
+        bench_print_metric(r->llc_mpki, 9, 3);
+        bench_print_metric(r->br_mpki, 9, 3);
+        bench_print_metric(r->upi, 6, 2);
+    }
+    printf("\n");
+    for (int k = 0; k < r->bc->num_extra; k++) {
+        printf("    %-12s min %.0f  median %.1f  mean %.2f  max %.0f\n", r->bc->extra_names[k], r->extra[k].min,
+               r->extra[k].median, r->extra[k].mean, r->extra[k].max);
+    }
+}
+
+static inline void bench_write_csv(FILE *fp, const bench_result_t *results, int n) {
+    fprintf(fp, "name,backend,size,threads,runs,rejected,min_cycles,median_cycles,mean_cycles,p99_cycles,"
+                "stddev_cycles,mean_ns,cpb,tsc_hz,overhead_cycles,ipc,l1d_mpki,llc_mpki,br_mpki,upi");
+    for (int e = 0; e < BENCH_PMU_COUNT; e++) fprintf(fp, ",%s", bench_pmu_names[e]);
+    int max_extra = 0;
+    for (int i = 0; i < n; i++) if (results[i].bc->num_extra > max_extra) max_extra = results[i].bc->num_extra;
+    for (int k = 0; k < max_extra; k++) fprintf(fp, ",extra%d_name,extra%d_mean,extra%d_median", k, k, k);
+    fprintf(fp, "\n");
+    for (int i = 0; i < n; i++) {
+        const bench_result_t *r = &results[i];
+        fprintf(fp, "%s,%s,%zu,%d,%d,%d,%.0f,%.1f,%.2f,%.0f,%.2f,%.2f,%.4f,%.0f,%llu", r->bc->name, r->bc->backend,
+                r->params.size, r->params.threads, r->runs, r->rejected, r->min, r->median, r->mean, r->p99,
+                r->stddev, r->mean_ns, r->cpb, bench_tsc_hz(), (unsigned long long)bench_overhead());
+        // Unavailable counters are empty fields
+        const double derived[] = {r->ipc, r->l1d_mpki, r->llc_mpki, r->br_mpki, r->upi};
+        for (int m = 0; m < 5; m++) {
+            if (isnan(derived[m])) fprintf(fp, ",");
+            else fprintf(fp, ",%.4f", derived[m]);
+        }
+        for (int e = 0; e < BENCH_PMU_COUNT; e++) {
+            if (isnan(r->pmu[e])) fprintf(fp, ",");
+            else fprintf(fp, ",%.0f", r->pmu[e]);
+        }
+        for (int k = 0; k < max_extra; k++) {
+            if (k < r->bc->num_extra) {
+                fprintf(fp, ",%s,%.4f,%.1f", r->bc->extra_names[k], r->extra[k].mean, r->extra[k].median);
+            } else {
+                fprintf(fp, ",,,");
+            }
+        }
+        fprintf(fp, "\n");
+    }
+}
+
+static inline void bench_write_json(FILE *fp, const bench_result_t *results, int n) {
+    fprintf(fp, "{\n  \"tsc_hz\": %.0f,\n  \"overhead_cycles\": %llu,\n  \"results\": [\n", bench_tsc_hz(),
+            (unsigned long long)bench_overhead());
+    for (int i = 0; i < n; i++) {
+        const bench_result_t *r = &results[i];
+        fprintf(fp, "    {\"name\": \"%s\", \"backend\": \"%s\", \"size\": %zu, \"threads\": %d, \"runs\": %d, "
+                    "\"rejected\": %d, \"min_cycles\": %.0f, \"median_cycles\": %.1f, \"mean_cycles\": %.2f, "
+                    "\"p99_cycles\": %.0f, \"stddev_cycles\": %.2f, \"mean_ns\": %.2f, \"cpb\": %.4f",
+                r->bc->name, r->bc->backend, r->params.size, r->params.threads, r->runs, r->rejected, r->min,
+                r->median, r->mean, r->p99, r->stddev, r->mean_ns, r->cpb);
+        const char *derived_names[] = {"ipc", "l1d_mpki", "llc_mpki", "br_mpki", "upi"};
+        const double derived[] = {r->ipc, r->l1d_mpki, r->llc_mpki, r->br_mpki, r->upi};
+        for (int m = 0; m < 5; m++) {
+            if (isnan(derived[m])) fprintf(fp, ", \"%s\": null", derived_names[m]);
+            else fprintf(fp, ", \"%s\": %.4f", derived_names[m], derived[m]);
+        }
+        fprintf(fp, ", \"counters\": {");
+        for (int e = 0; e < BENCH_PMU_COUNT; e++) {
+            if (isnan(r->pmu[e])) fprintf(fp, "%s\"%s\": null", e ? ", " : "", bench_pmu_names[e]);
+            else fprintf(fp, "%s\"%s\": %.0f", e ? ", " : "", bench_pmu_names[e], r->pmu[e]);
+        }
+        fprintf(fp, "}");
+        if (r->bc->num_extra) {
+            fprintf(fp, ", \"extra\": {");
+            for (int k = 0; k < r->bc->num_extra; k++) {
+                fprintf(fp, "%s\"%s\": {\"min\": %.0f, \"max\": %.0f, \"mean\": %.4f, \"median\": %.1f}", k ? ", " : "",
+                        r->bc->extra_names[k], r->extra[k].min, r->extra[k].max, r->extra[k].mean, r->extra[k].median);
+            }
+            fprintf(fp, "}");
+        }
+        fprintf(fp, "}%s\n", i + 1 < n ? "," : "");
+    }
+    fprintf(fp, "  ]\n}\n");
+}
+
+// Run every case matching cfg->filter over the size x thread sweep. Returns the results
+// (count in *count, caller frees) after printing them and writing the CSV/JSON files.
+static inline bench_result_t *bench_run_suite(const bench_case_t *cases, int num_cases, const bench_config_t *cfg,
+                                              int *count) {
+    int num_sizes = cfg->num_sizes ? cfg->num_sizes : 1;
+    int num_threads = cfg->num_threads ? cfg->num_threads : 1;
+    bench_result_t *results = malloc((size_t)num_cases * num_sizes * num_threads * sizeof(bench_result_t));
+    int n = 0;
+
+    bench_pmu_t pmu;
+    int have_pmu = !cfg->no_pmu && bench_pmu_open(&pmu) > 0;
+    if (!cfg->quiet) {
+        printf("TSC %.3f GHz, timer overhead %llu cycles subtracted\n", bench_tsc_hz() / 1e9,
+               (unsigned long long)bench_overhead());
+        if (have_pmu) {
+            printf("Hardware counters:");
+            for (int e = 0; e < BENCH_PMU_COUNT; e++) {
+                if (pmu.fd[e] >= 0) printf(" %s", bench_pmu_names[e]);
+            }
+            printf("\n");
+        } else if (!cfg->no_pmu) {
+            bench_pmu_explain(&pmu);
+        }
+        bench_print_header(have_pmu);
+    }
+    for (int c = 0; c < num_cases; c++) {
+        const bench_case_t *bc = &cases[c];
+        if (cfg->filter && !strstr(bc->name, cfg->filter) && !strstr(bc->backend, cfg->filter)) continue;
+        for (int s = 0; s < num_sizes; s++) {
+            for (int t = 0; t < num_threads; t++) {
+                int threads = cfg->num_threads ? cfg->threads[t] : 1;
+                if (bc->max_threads == 0 && t > 0) break;
+                if (bc->max_threads == 0) threads = 1;
+                if (bc->max_threads > 0 && threads > bc->max_threads) continue;
+                bench_params_t params = {cfg->num_sizes ? cfg->sizes[s] : 0, threads};
+                bench_run_case(bc, &params, cfg, have_pmu ? &pmu : NULL, &results[n]);
+                if (!cfg->quiet) bench_print_result(&results[n], have_pmu);
+                n++;
+            }
+        }
+    }
+
+    if (have_pmu) bench_pmu_close(&pmu);
+
+    if (cfg->csv_path) {
+        FILE *fp = fopen(cfg->csv_path, "w");
+        if (fp) {
+            bench_write_csv(fp, results, n);
+            fclose(fp);
+        } else {
+            printf("Error: Could not write to %s\n", cfg->csv_path);
+        }
+    }
+    if (cfg->json_path) {
+        FILE *fp = fopen(cfg->json_path, "w");
+        if (fp) {
+            bench_write_json(fp, results, n);
+            fclose(fp);
+        } else {
+            printf("Error: Could not write to %s\n", cfg->json_path);
+        }
+    }
+    *count = n;
+    return results;
+}
+
+// Parse flags over the defaults in cfg and run the suite; returns a process exit status
+static inline int bench_main(const bench_case_t *cases, int num_cases, bench_config_t *cfg, int argc, char **argv) {
+    if (bench_parse_args(cfg, argc, argv) != 0) return 1;
+    int n;
+    bench_result_t *results = bench_run_suite(cases, num_cases, cfg, &n);
+    free(results);
+    return 0;
+}
+
+#endif
@@ -2,14 +2,13 @@
 #include <stdint.h>
 #include <stddef.h>
 #include <sched.h>
-#include <sys/mman.h>
-#include <unistd.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 #include <sys/sysinfo.h>
 #include <x86intrin.h>
 #include <pthread.h>
+#include "bench.h"
 
 // Macro for rotation
 #define ROTL(a, b) (((a) << (b)) | ((a) >> (32 - (b))))
@@ -107,42 +106,12 @@ void chacha20_crypt(chacha20_state_t *state, uint8_t *data, size_t len) {
     }
 }
 
-void setup_no_interruptions() {
-    int num_cores = get_nprocs();
-    if (num_cores < 2) {
-        fprintf(stderr, "System has only 1 core; cannot assign multiple cores.\n");
-        exit(1);
-    }
-
-    cpu_set_t cpu_mask;
-    CPU_ZERO(&cpu_mask);
-    CPU_SET(0, &cpu_mask);
-    CPU_SET(1, &cpu_mask);
-    if (sched_setaffinity(0, sizeof(cpu_mask), &cpu_mask) == -1) {
-        perror("Failed to set CPU affinity");
-        exit(1);
-    }
-
-    struct sched_param sched_params;
-    sched_params.sched_priority = sched_get_priority_max(SCHED_FIFO);
-    if (sched_setscheduler(0, SCHED_FIFO, &sched_params) == -1) {
-        perror("Failed to set real-time scheduling");
-        exit(1);
-    }
-
-    if (mlockall(MCL_CURRENT | MCL_FUTURE) == -1) {
-        perror("Failed to lock memory");
-        exit(1);
-    }
-}
-
 typedef struct {
     chacha20_state_t state;
     uint8_t *data;
     size_t len;
     uint32_t counter_start;
     int core_id;
-    uint64_t cycles;
 } thread_data_t;
 
 void *encrypt_chunk(void *arg) {
@@ -157,103 +126,105 @@ void *encrypt_chunk(void *arg) {
     }
 
     td->state.input[12] = td->counter_start;
-    uint64_t start = __rdtsc();
     chacha20_crypt(&td->state, td->data, td->len);
-    uint64_t end = __rdtsc();
-    td->cycles = end - start;
 
     return NULL;
 }
 
-static uint32_t lcg_seed = 123456789;
-uint32_t lcg_rand() {
-    lcg_seed = (1103515245 * lcg_seed + 12345) & 0x7fffffff;
-    return lcg_seed;
-}
-
-void generate_random(uint8_t *buf, size_t len) {
-    for (size_t i = 0; i < len; ++i) {
-        buf[i] = (uint8_t)(lcg_rand() & 0xff);
-    }
-}
-
-int main() {
-    setup_no_interruptions();
-
-    size_t data_len = 1024 * 1024;  // 1 MB
-    size_t chunk_len = data_len / 2;  // 512 KB per thread
-    uint8_t *data = malloc(data_len);
+typedef struct {
+    uint8_t *data;
+    size_t len;
+    int threads;
     uint8_t key[32];
     uint8_t nonce[12];
-    if (!data) {
+    thread_data_t *thread_data;
+    pthread_t *thread_ids;
+} chacha20_bench_t;
+
+static void *chacha20_bench_setup(const bench_params_t *params, const void *arg) {
+    (void)arg;
+    chacha20_bench_t *b = malloc(sizeof(chacha20_bench_t));
+    b->len = params->size;
+    b->threads = params->threads;
+    b->data = malloc(b->len);
+    b->thread_data = malloc(b->threads * sizeof(thread_data_t));
+    b->thread_ids = malloc(b->threads * sizeof(pthread_t));
+    if (!b->data || !b->thread_data || !b->thread_ids) {
         perror("Failed to allocate memory");
         exit(1);
     }
+    return b;
+}
 
-    const int runs = 1000000;
-    uint64_t total_cycles = 0;
-
-    // Warm-up run
-    generate_random(data, data_len);
-    generate_random(key, sizeof(key));
-    generate_random(nonce, sizeof(nonce));
-    chacha20_state_t state;
-    chacha20_init(&state, key, nonce);
-    chacha20_crypt(&state, data, data_len);
-
-    // Run iterations
-    for (int i = 0; i < runs; ++i) {
-        generate_random(data, data_len);
-        generate_random(key, sizeof(key));
-        generate_random(nonce, sizeof(nonce));
+// New plaintext, key and nonce for every run; per-thread states are set up outside the timing
+static void chacha20_bench_prepare(void *ctx) {
+    chacha20_bench_t *b = ctx;
+    bench_fill_random(b->data, b->len);
+    bench_fill_random(b->key, sizeof(b->key));
+    bench_fill_random(b->nonce, sizeof(b->nonce));
+    size_t chunk_len = b->len / b->threads / 64 * 64;  // whole blocks per thread, the last takes the rest
+    for (int t = 0; t < b->threads; t++) {
+        thread_data_t *td = &b->thread_data[t];
+        chacha20_init(&td->state, b->key, b->nonce);
+        td->data = b->data + t * chunk_len;
+        td->len = (t == b->threads - 1) ? b->len - t * chunk_len : chunk_len;
+        td->counter_start = (uint32_t)(t * (chunk_len / 64));
+        td->core_id = bench_worker_core(t);
+    }
+}
 
-        thread_data_t thread_data[2];
-        pthread_t threads[2];
-        for (int t = 0; t < 2; t++) {
-            chacha20_init(&thread_data[t].state, key, nonce);
-            thread_data[t].data = data + (t * chunk_len);
-            thread_data[t].len = chunk_len;
-            thread_data[t].counter_start = t * (chunk_len / 64);
-            thread_data[t].core_id = t;  // Cores 0 and 1
-            thread_data[t].cycles = 0;
-        }
+// Whole buffer on the calling thread
+static void chacha20_bench_run_single(void *ctx) {
+    chacha20_bench_t *b = ctx;
+    chacha20_crypt(&b->thread_data[0].state, b->data, b->len);
+}
 
-        uint64_t start = __rdtsc();
-        for (int t = 0; t < 2; t++) {
-            if (pthread_create(&threads[t], NULL, encrypt_chunk, &thread_data[t]) != 0) {
-                perror("Failed to create thread");
-                exit(1);
-            }
-        }
-        for (int t = 0; t < 2; t++) {
-            if (pthread_join(threads[t], NULL) != 0) {
-                perror("Failed to join thread");
-                exit(1);
-            }
+// Thread creation and join are inside the timed region, as a caller would pay for them
+static void chacha20_bench_run_threads(void *ctx) {
+    chacha20_bench_t *b = ctx;
+    for (int t = 0; t < b->threads; t++) {
+        if (pthread_create(&b->thread_ids[t], NULL, encrypt_chunk, &b->thread_data[t]) != 0) {
+            perror("Failed to create thread");
+            exit(1);
         }
-        uint64_t end = __rdtsc();
-        uint64_t max_thread_cycles = thread_data[0].cycles > thread_data[1].cycles ? thread_data[0].cycles : thread_data[1].cycles;
-        total_cycles += (end - start) + max_thread_cycles;
-
-        if ((i + 1) % 100000 == 0) {
-            printf("Completed %d runs\n", i + 1);
-            fflush(stdout);
+    }
+    for (int t = 0; t < b->threads; t++) {
+        if (pthread_join(b->thread_ids[t], NULL) != 0) {
+            perror("Failed to join thread");
+            exit(1);
         }
     }
+}
 
-    double avg_cycles = (double)total_cycles / runs;
-
+static void chacha20_bench_teardown(void *ctx) {
+    chacha20_bench_t *b = ctx;
     printf("Last encrypted data sample (first 16 bytes, hex): ");
-    for (size_t i = 0; i < 16; ++i) {
-        printf("%02x ", data[i]);
+    for (size_t i = 0; i < 16 && i < b->len; ++i) {
+        printf("%02x ", b->data[i]);
     }
     printf("\n");
+    free(b->data);
+    free(b->thread_data);
+    free(b->thread_ids);
+    free(b);
+}
 
-    printf("Data size: %zu bytes\n", data_len);
-    printf("Total runs: %d\n", runs);
-    printf("Average cycles (rdtsc, total including thread overhead): %.2f\n", avg_cycles);
-    printf("Average cycles per byte: %.2f\n", avg_cycles / data_len);
-
-    free(data);
-    return 0;
-}
\ No newline at end of file
+static const bench_case_t chacha20_cases[] = {
+    {.name = "chacha20", .backend = "single", .setup = chacha20_bench_setup, .prepare = chacha20_bench_prepare,
+     .run = chacha20_bench_run_single, .teardown = chacha20_bench_teardown},
+    {.name = "chacha20", .backend = "pthreads", .setup = chacha20_bench_setup, .prepare = chacha20_bench_prepare,
+     .run = chacha20_bench_run_threads, .teardown = chacha20_bench_teardown, .max_threads = 256},
+};
+
+// Usage: ./chacha20 [bench.h flags]; defaults are 1,000,000 runs over 1 MB on 2 threads
+int main(int argc, char **argv) {
+    bench_setup_no_interruptions(2);
+
+    bench_config_t cfg;
+    bench_config_init(&cfg, 1000000, 1);
+    cfg.sizes[0] = 1024 * 1024;  // 1 MB
+    cfg.num_sizes = 1;
+    cfg.threads[0] = 2;
+    cfg.num_threads = 1;
+    return bench_main(chacha20_cases, sizeof(chacha20_cases) / sizeof(chacha20_cases[0]), &cfg, argc - 1, argv + 1);
+}
@@ -0,0 +1,56 @@
+// Build: gcc -O2 hist_reader.c -o hist_reader
+// Usage: ./hist_reader [-b] [results/prime_gen_hist.bin]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "latency_hist.h"
+
+// Print a summary of every record in a latency_hist.h checkpoint file, or with -b also the
+// nonzero buckets as CSV (bucket upper bound, count, cumulative fraction)
+int main(int argc, char **argv) {
+    const char *path = "results/prime_gen_hist.bin";
+    int buckets = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-b") == 0) {
+            buckets = 1;
+        } else {
+            path = argv[i];
+        }
+    }
+
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        printf("Error: Could not open %s for reading.\n", path);
+        return 1;
+    }
+
+    latency_hist_t *h = aligned_alloc(64, sizeof(latency_hist_t));
+    int32_t label;
+    double timestamp;
+    int status;
+    printf("%-8s %10s %12s %14s %14s %14s %14s %14s %14s %16s\n", "label", "time(s)", "count", "min", "p50", "p90",
+           "p99", "p99.9", "max", "mean");
+    while ((status = lh_read(fp, h, &label, &timestamp)) == 1) {
+        printf("%-8d %10.1f %12llu %14llu %14llu %14llu %14llu %14llu %14llu %16.2f\n", label, timestamp,
+               (unsigned long long)atomic_load(&h->total), (unsigned long long)atomic_load(&h->min),
+               (unsigned long long)lh_percentile(h, 50.0), (unsigned long long)lh_percentile(h, 90.0),
+               (unsigned long long)lh_percentile(h, 99.0), (unsigned long long)lh_percentile(h, 99.9),
+               (unsigned long long)atomic_load(&h->max), lh_mean(h));
+        if (buckets) {
+            uint64_t total = atomic_load(&h->total), seen = 0;
+            printf("bucket_max,count,cumulative\n");
+            for (int i = 0; i < LH_BUCKETS; i++) {
+                uint64_t c = atomic_load(&h->counts[i]);
+                if (!c) continue;
+                seen += c;
+                printf("%llu,%llu,%.6f\n", (unsigned long long)lh_value_at(i), (unsigned long long)c,
+                       (double)seen / (double)total);
+            }
+        }
+    }
+    if (status < 0) printf("Error: Corrupt record in %s\n", path);
+
+    free(h);
+    fclose(fp);
+    return status < 0 ? 1 : 0;
+}
@@ -0,0 +1,160 @@
+// Log-bucketed latency histogram in the style of HdrHistogram. Values below 128 get exact buckets;
+// above that each power of two is split into 64 linear sub-buckets, so any recorded value is
+// reported within 1/64 (about 1.6%) of its true size across the full 64-bit range, in a 30 KB table.
+//
+// A histogram has one writer. Counters are atomics updated with relaxed load/store pairs (plain
+// moves on x86), so another thread can snapshot or merge a live histogram without locks.
+//
+// Checkpoint files hold a sequence of records, each a lh_file_header_t followed by nonzero
+// (uint32 index, uint64 count) pairs, all little-endian.
+#ifndef LATENCY_HIST_H
+#define LATENCY_HIST_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define LH_SUB_BITS 7
+#define LH_HALF (1 << (LH_SUB_BITS - 1))
+#define LH_BUCKETS ((64 - LH_SUB_BITS + 1) * LH_HALF + LH_HALF)
+#define LH_MAGIC "LHIST01"
+
+// Cache-line aligned, so per-thread histograms in one array never share a line
+typedef struct {
+    _Alignas(64) _Atomic uint64_t counts[LH_BUCKETS];
+    _Atomic uint64_t total;
+    _Atomic uint64_t sum;
+    _Atomic uint64_t min;
+    _Atomic uint64_t max;
+} latency_hist_t;
+
+typedef struct {
+    char magic[8];
+    int32_t label;      // caller's tag, e.g. the bit size
+    uint32_t sub_bits;
+    double timestamp;   // seconds, caller's clock
+    uint64_t total, sum, min, max;
+    uint32_t nonzero;   // (index, count) pairs that follow
+    uint32_t reserved;
+} lh_file_header_t;
+
+static inline int lh_index(uint64_t v) {
+    if (v < 2 * LH_HALF) return (int)v;
+    int e = 63 - __builtin_clzll(v) - (LH_SUB_BITS - 1);
+    return e * LH_HALF + (int)(v >> e);
+}
+
+// Largest value that maps to bucket i
+static inline uint64_t lh_value_at(int i) {
+    if (i < 2 * LH_HALF) return (uint64_t)i;
+    int e = i / LH_HALF - 1;
+    uint64_t m = (uint64_t)(i - e * LH_HALF);
+    return ((m + 1) << e) - 1;
+}
+
+static inline void lh_init(latency_hist_t *h) {
+    memset(h, 0, sizeof(*h));
+    atomic_store_explicit(&h->min, UINT64_MAX, memory_order_relaxed);
+}
+
+static inline void lh_bump(_Atomic uint64_t *x, uint64_t v) {
+    atomic_store_explicit(x, atomic_load_explicit(x, memory_order_relaxed) + v, memory_order_relaxed);
+}
+
+// Single-writer record
+static inline void lh_record(latency_hist_t *h, uint64_t v) {
+    lh_bump(&h->counts[lh_index(v)], 1);
+    lh_bump(&h->total, 1);
+    lh_bump(&h->sum, v);
+    if (v < atomic_load_explicit(&h->min, memory_order_relaxed)) atomic_store_explicit(&h->min, v, memory_order_relaxed);
+    if (v > atomic_load_explicit(&h->max, memory_order_relaxed)) atomic_store_explicit(&h->max, v, memory_order_relaxed);
+}
+
+// dst += src; dst must not be shared with a writer, src may be live
+static inline void lh_merge(latency_hist_t *dst, latency_hist_t *src) {
+    uint64_t total = 0;
+    for (int i = 0; i < LH_BUCKETS; i++) {
+        uint64_t c = atomic_load_explicit(&src->counts[i], memory_order_relaxed);
+        if (c) {
+            lh_bump(&dst->counts[i], c);
+            total += c;
+        }
+    }
+    // Derive total from the buckets read so percentiles of a live snapshot stay consistent
+    lh_bump(&dst->total, total);
+    lh_bump(&dst->sum, atomic_load_explicit(&src->sum, memory_order_relaxed));
+    uint64_t mn = atomic_load_explicit(&src->min, memory_order_relaxed);
+    uint64_t mx = atomic_load_explicit(&src->max, memory_order_relaxed);
+    if (mn < atomic_load_explicit(&dst->min, memory_order_relaxed)) atomic_store_explicit(&dst->min, mn, memory_order_relaxed);
+    if (mx > atomic_load_explicit(&dst->max, memory_order_relaxed)) atomic_store_explicit(&dst->max, mx, memory_order_relaxed);
+}
+
+// Value at percentile pct (0-100), reported as the top of its bucket and clamped to the recorded max
+static inline uint64_t lh_percentile(latency_hist_t *h, double pct) {
+    uint64_t total = atomic_load_explicit(&h->total, memory_order_relaxed);
+    if (total == 0) return 0;
+    uint64_t rank = (uint64_t)(pct / 100.0 * (double)total + 0.5);
+    if (rank < 1) rank = 1;
+    if (rank > total) rank = total;
+    uint64_t seen = 0;
+    uint64_t max = atomic_load_explicit(&h->max, memory_order_relaxed);
+    for (int i = 0; i < LH_BUCKETS; i++) {
+        seen += atomic_load_explicit(&h->counts[i], memory_order_relaxed);
+        if (seen >= rank) {
+            uint64_t v = lh_value_at(i);
+            return v < max ? v : max;
+        }
+    }
+    return max;
+}
+
+static inline double lh_mean(latency_hist_t *h) {
+    uint64_t total = atomic_load_explicit(&h->total, memory_order_relaxed);
+    return total ? (double)atomic_load_explicit(&h->sum, memory_order_relaxed) / (double)total : 0.0;
+}
+
+// Append one record to fp; returns 0 on success
+static inline int lh_write(FILE *fp, latency_hist_t *h, int32_t label, double timestamp) {
+    lh_file_header_t hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, LH_MAGIC, sizeof(hdr.magic));
+    hdr.label = label;
+    hdr.sub_bits = LH_SUB_BITS;
+    hdr.timestamp = timestamp;
+    hdr.total = atomic_load_explicit(&h->total, memory_order_relaxed);
+    hdr.sum = atomic_load_explicit(&h->sum, memory_order_relaxed);
+    hdr.min = atomic_load_explicit(&h->min, memory_order_relaxed);
+    hdr.max = atomic_load_explicit(&h->max, memory_order_relaxed);
+    for (int i = 0; i < LH_BUCKETS; i++) hdr.nonzero += atomic_load_explicit(&h->counts[i], memory_order_relaxed) != 0;
+    if (fwrite(&hdr, sizeof(hdr), 1, fp) != 1) return -1;
+    for (uint32_t i = 0; i < LH_BUCKETS; i++) {
+        uint64_t c = atomic_load_explicit(&h->counts[i], memory_order_relaxed);
+        if (!c) continue;
+        if (fwrite(&i, sizeof(i), 1, fp) != 1 || fwrite(&c, sizeof(c), 1, fp) != 1) return -1;
+    }
+    return 0;
+}
+
+// Read the next record into h (initialized here); returns 1 on success, 0 at end of file, -1 on a bad record
+static inline int lh_read(FILE *fp, latency_hist_t *h, int32_t *label, double *timestamp) {
+    lh_file_header_t hdr;
+    if (fread(&hdr, sizeof(hdr), 1, fp) != 1) return 0;
+    if (memcmp(hdr.magic, LH_MAGIC, sizeof(hdr.magic)) != 0 || hdr.sub_bits != LH_SUB_BITS) return -1;
+    lh_init(h);
+    for (uint32_t k = 0; k < hdr.nonzero; k++) {
+        uint32_t i;
+        uint64_t c;
+        if (fread(&i, sizeof(i), 1, fp) != 1 || fread(&c, sizeof(c), 1, fp) != 1 || i >= LH_BUCKETS) return -1;
+        atomic_store_explicit(&h->counts[i], c, memory_order_relaxed);
+    }
+    atomic_store_explicit(&h->total, hdr.total, memory_order_relaxed);
+    atomic_store_explicit(&h->sum, hdr.sum, memory_order_relaxed);
+    atomic_store_explicit(&h->min, hdr.min, memory_order_relaxed);
+    atomic_store_explicit(&h->max, hdr.max, memory_order_relaxed);
+    *label = hdr.label;
+    *timestamp = hdr.timestamp;
+    return 1;
+}
+
+#endif
@@ -1,10 +1,341 @@
+#define _GNU_SOURCE
 #include <gmp.h>
 #include <stdlib.h>
 #include <time.h>
 #include <stdio.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <string.h>
+#include <math.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sched.h>
+#include <omp.h>
+#include "bench.h"
+
+// ---------------------------------------------------------------------------
+// Asynchronous log sink. Producers copy raw limbs into a slot of a lock-free
+// ring and return; a background writer thread turns records into text, CSV or
+// binary and writes them in large batches, so decimal conversion and I/O stay
+// off the measured path.
+// ---------------------------------------------------------------------------
+
+#define LOG_RING_SIZE 8192          // slots, power of two
+#define LOG_MAX_LIMBS 16            // numbers up to 1024 bits are captured as raw limbs
+#define LOG_TEXT_LEN 192
+#define LOG_FLUSH_BYTES (256 * 1024) // writer flushes its batch buffer past this size
+
+typedef enum { LOG_FORMAT_TEXT, LOG_FORMAT_CSV, LOG_FORMAT_BINARY } log_format_t;
+
+typedef enum {
+    LOG_TEXT,           // preformatted message
+    LOG_VALUE,          // "<text>: <num[0]>"
+    LOG_BASE,           // base a = num[0], s = u0, d = num[1], x = num[2]
+    LOG_PASS_X,         // x = 1 (u0 == 1) or x = n-1 (u0 == 0) right after a^d
+    LOG_STEP,           // squaring step r = u0 gave x = num[0]
+    LOG_PASS_STEP,      // x = n-1 at r = u0
+    LOG_FAIL,           // no pass condition met
+    LOG_FALSE_POSITIVE, // trial u0 passed with base a = num[0]
+} log_kind_t;
+
+static const char *log_kind_names[] = {"text", "value", "base", "pass_x", "step", "pass_step", "fail", "false_positive"};
+
+typedef struct {
+    int size;                         // limb count, or -1 when str holds an eager decimal string
+    mp_limb_t limbs[LOG_MAX_LIMBS];
+    char *str;
+} log_num_t;
+
+typedef struct {
+    atomic_size_t seq;  // == position when free for a producer, position + 1 when ready for the writer
+    log_kind_t kind;
+    unsigned long u0;
+    int nnums;
+    log_num_t num[3];
+    char text[LOG_TEXT_LEN];
+} log_record_t;
+
+typedef struct {
+    log_record_t *ring;
+    atomic_size_t head;           // next position a producer claims
+    size_t tail;                  // next position the writer consumes (writer thread only)
+    atomic_int stop;
+    atomic_ulong stalls;          // times a producer found the ring full
+    pthread_t writer;
+    FILE *fp;
+    log_format_t format;
+    int echo_stdout;
+    unsigned long records;
+} log_sink_t;
+
+// Binary format: "MRLOG1\n\0" header, then per record
+//   uint32 kind, uint32 nnums, uint64 u0, uint32 text_len, text bytes,
+//   per number: int32 size (limbs, or -digits for a decimal string), limbs or digits
+static const char log_binary_magic[8] = {'M', 'R', 'L', 'O', 'G', '1', '\n', '\0'};
+
+typedef struct {
+    char *data;
+    size_t len, cap;
+} log_buf_t;
+
+static void log_buf_reserve(log_buf_t *b, size_t extra) {
+    if (b->len + extra <= b->cap) return;
+    while (b->len + extra > b->cap) b->cap = b->cap ? 2 * b->cap : LOG_FLUSH_BYTES * 2;
+    b->data = realloc(b->data, b->cap);
+}
+
+static void log_buf_put(log_buf_t *b, const void *src, size_t len) {
+    log_buf_reserve(b, len);
+    memcpy(b->data + b->len, src, len);
+    b->len += len;
+}
+
+#define log_buf_literal(b, s) log_buf_put(b, s, sizeof(s) - 1)
+
+static void log_buf_printf(log_buf_t *b, const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    int need = vsnprintf(NULL, 0, fmt, ap);
+    va_end(ap);
+    log_buf_reserve(b, need + 1);
+    va_start(ap, fmt);
+    vsnprintf(b->data + b->len, need + 1, fmt, ap);
+    va_end(ap);
+    b->len += need;
+}
+
+// Decimal conversion happens here, on the writer thread
+static void log_buf_num(log_buf_t *b, const log_num_t *num) {
+    if (num->size < 0) {
+        log_buf_put(b, num->str, strlen(num->str));
+        return;
+    }
+    mpz_t view;
+    mpz_roinit_n(view, num->limbs, num->size);
+    size_t digits = mpz_sizeinbase(view, 10) + 2;
+    log_buf_reserve(b, digits);
+    mpz_get_str(b->data + b->len, 10, view);
+    b->len += strlen(b->data + b->len);
+}
+
+static void log_format_text(log_buf_t *b, const log_record_t *rec) {
+    switch (rec->kind) {
+    case LOG_TEXT:
+        log_buf_put(b, rec->text, strlen(rec->text));
+        break;
+    case LOG_VALUE:
+        log_buf_printf(b, "%s: ", rec->text);
+        log_buf_num(b, &rec->num[0]);
+        log_buf_literal(b, "\n");
+        break;
+    case LOG_BASE:
+        log_buf_literal(b, "  Base a = ");
+        log_buf_num(b, &rec->num[0]);
+        log_buf_printf(b, ", s = %lu, d = ", rec->u0);
+        log_buf_num(b, &rec->num[1]);
+        log_buf_literal(b, ", x = ");
+        log_buf_num(b, &rec->num[2]);
+        log_buf_literal(b, "\n");
+        break;
+    case LOG_PASS_X:
+        log_buf_printf(b, "  Passes: x = %s\n", rec->u0 ? "1" : "n-1");
+        break;
+    case LOG_STEP:
+        log_buf_printf(b, "  r = %lu, x = ", rec->u0);
+        log_buf_num(b, &rec->num[0]);
+        log_buf_literal(b, "\n");
+        break;
+    case LOG_PASS_STEP:
+        log_buf_printf(b, "  Passes: x = n-1 at r = %lu\n", rec->u0);
+        break;
+    case LOG_FAIL:
+        log_buf_literal(b, "  Fails: no pass condition met\n");
+        break;
+    case LOG_FALSE_POSITIVE:
+        log_buf_printf(b, "False positive at trial %lu with a = ", rec->u0);
+        log_buf_num(b, &rec->num[0]);
+        log_buf_literal(b, "\n");
+        break;
+    }
+}
+
+// CSV columns: seq,kind,u0,num0,num1,num2,text
+static void log_format_csv(log_buf_t *b, const log_record_t *rec, unsigned long seq) {
+    log_buf_printf(b, "%lu,%s,%lu", seq, log_kind_names[rec->kind], rec->u0);
+    for (int i = 0; i < 3; i++) {
+        log_buf_literal(b, ",");
+        if (i < rec->nnums) log_buf_num(b, &rec->num[i]);
+    }
+    log_buf_literal(b, ",\"");
+    for (const char *c = rec->text; *c; c++) {
+        if (*c == '\n') continue;
+        if (*c == '"') log_buf_literal(b, "\"");
+        log_buf_put(b, c, 1);
+    }
+    log_buf_literal(b, "\"\n");
+}
+
+static void log_format_binary(log_buf_t *b, const log_record_t *rec) {
+    uint32_t hdr[2] = {(uint32_t)rec->kind, (uint32_t)rec->nnums};
+    uint64_t u0 = rec->u0;
+    uint32_t text_len = (uint32_t)strlen(rec->text);
+    log_buf_put(b, hdr, sizeof(hdr));
+    log_buf_put(b, &u0, sizeof(u0));
+    log_buf_put(b, &text_len, sizeof(text_len));
+    log_buf_put(b, rec->text, text_len);
+    for (int i = 0; i < rec->nnums; i++) {
+        const log_num_t *num = &rec->num[i];
+        int32_t size = (num->size < 0) ? -(int32_t)strlen(num->str) : num->size;
+        log_buf_put(b, &size, sizeof(size));
+        if (num->size < 0) {
+            log_buf_put(b, num->str, -size);
+        } else {
+            log_buf_put(b, num->limbs, num->size * sizeof(mp_limb_t));
+        }
+    }
+}
+
+static void log_flush(log_sink_t *log, log_buf_t *file_buf, log_buf_t *out_buf) {
+    if (file_buf->len) fwrite(file_buf->data, 1, file_buf->len, log->fp);
+    if (out_buf->len) fwrite(out_buf->data, 1, out_buf->len, stdout);
+    file_buf->len = 0;
+    out_buf->len = 0;
+}
+
+static void *log_writer_main(void *arg) {
+    log_sink_t *log = arg;
+    log_buf_t file_buf = {0}, out_buf = {0};
+    if (log->format == LOG_FORMAT_BINARY) {
+        log_buf_put(&file_buf, log_binary_magic, sizeof(log_binary_magic));
+    } else if (log->format == LOG_FORMAT_CSV) {
+        log_buf_printf(&file_buf, "seq,kind,u0,num0,num1,num2,text\n");
+    }
+    for (;;) {
+        log_record_t *rec = &log->ring[log->tail & (LOG_RING_SIZE - 1)];
+        if (atomic_load_explicit(&rec->seq, memory_order_acquire) != log->tail + 1) {
+            // Nothing ready: write out the batch, then exit if asked and fully drained
+            log_flush(log, &file_buf, &out_buf);
+            if (atomic_load_explicit(&log->stop, memory_order_acquire) &&
+                atomic_load_explicit(&log->head, memory_order_acquire) == log->tail) {
+                break;
+            }
+            struct timespec nap = {0, 200000};
+            nanosleep(&nap, NULL);
+            continue;
+        }
+        switch (log->format) {
+        case LOG_FORMAT_TEXT: log_format_text(&file_buf, rec); break;
+        case LOG_FORMAT_CSV: log_format_csv(&file_buf, rec, log->records); break;
+        case LOG_FORMAT_BINARY: log_format_binary(&file_buf, rec); break;
+        }
+        if (log->echo_stdout) log_format_text(&out_buf, rec);
+        for (int i = 0; i < rec->nnums; i++) {
+            if (rec->num[i].size < 0) free(rec->num[i].str);
+        }
+        log->records++;
+        atomic_store_explicit(&rec->seq, log->tail + LOG_RING_SIZE, memory_order_release);
+        log->tail++;
+        if (file_buf.len + out_buf.len >= LOG_FLUSH_BYTES) log_flush(log, &file_buf, &out_buf);
+    }
+    free(file_buf.data);
+    free(out_buf.data);
+    return NULL;
+}
+
+int log_open(log_sink_t *log, FILE *fp, log_format_t format, int echo_stdout) {
+    log->ring = malloc(LOG_RING_SIZE * sizeof(log_record_t));
+    if (log->ring == NULL) return -1;
+    for (size_t i = 0; i < LOG_RING_SIZE; i++) atomic_init(&log->ring[i].seq, i);
+    atomic_init(&log->head, 0);
+    atomic_init(&log->stop, 0);
+    atomic_init(&log->stalls, 0);
+    log->tail = 0;
+    log->fp = fp;
+    log->format = format;
+    log->echo_stdout = echo_stdout;
+    log->records = 0;
+    if (pthread_create(&log->writer, NULL, log_writer_main, log) != 0) {
+        free(log->ring);
+        return -1;
+    }
+    return 0;
+}
+
+// Drain every pending record, stop the writer and flush the file
+void log_close(log_sink_t *log) {
+    atomic_store_explicit(&log->stop, 1, memory_order_release);
+    pthread_join(log->writer, NULL);
+    fflush(log->fp);
+    fflush(stdout);
+    free(log->ring);
+}
+
+// Claim the next slot; spins only while the ring is full
+static log_record_t *log_claim(log_sink_t *log, size_t *pos) {
+    *pos = atomic_fetch_add_explicit(&log->head, 1, memory_order_relaxed);
+    log_record_t *rec = &log->ring[*pos & (LOG_RING_SIZE - 1)];
+    if (atomic_load_explicit(&rec->seq, memory_order_acquire) != *pos) {
+        atomic_fetch_add_explicit(&log->stalls, 1, memory_order_relaxed);
+        while (atomic_load_explicit(&rec->seq, memory_order_acquire) != *pos) sched_yield();
+    }
+    rec->nnums = 0;
+    rec->u0 = 0;
+    rec->text[0] = '\0';
+    return rec;
+}
+
+static void log_publish(log_record_t *rec, size_t pos) {
+    atomic_store_explicit(&rec->seq, pos + 1, memory_order_release);
+}
+
+static void log_capture(log_record_t *rec, const mpz_t x) {
+    log_num_t *num = &rec->num[rec->nnums++];
+    size_t size = mpz_size(x);
+    if (size <= LOG_MAX_LIMBS) {
+        num->size = (int)size;
+        memcpy(num->limbs, mpz_limbs_read(x), size * sizeof(mp_limb_t));
+    } else {
+        num->size = -1;
+        num->str = mpz_get_str(NULL, 10, x);
+    }
+}
+
+void log_text(log_sink_t *log, const char *fmt, ...) {
+    size_t pos;
+    log_record_t *rec = log_claim(log, &pos);
+    rec->kind = LOG_TEXT;
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(rec->text, LOG_TEXT_LEN, fmt, ap);
+    va_end(ap);
+    log_publish(rec, pos);
+}
+
+// Log "<label>: <x>" with x converted to decimal by the writer
+void log_value(log_sink_t *log, const char *label, const mpz_t x) {
+    size_t pos;
+    log_record_t *rec = log_claim(log, &pos);
+    rec->kind = LOG_VALUE;
+    snprintf(rec->text, LOG_TEXT_LEN, "%s", label);
+    log_capture(rec, x);
+    log_publish(rec, pos);
+}
+
+// Log a record carrying u0 and up to three numbers (NULL entries end the list)
+static void log_event(log_sink_t *log, log_kind_t kind, unsigned long u0,
+                      mpz_srcptr x0, mpz_srcptr x1, mpz_srcptr x2) {
+    size_t pos;
+    log_record_t *rec = log_claim(log, &pos);
+    rec->kind = kind;
+    rec->u0 = u0;
+    if (x0) log_capture(rec, x0);
+    if (x1) log_capture(rec, x1);
+    if (x2) log_capture(rec, x2);
+    log_publish(rec, pos);
+}
 
 // Miller-Rabin test for a single base (returns 1 if probably prime, 0 if composite)
-int miller_rabin_single(const mpz_t n, const mpz_t a, int debug, FILE *fp) {
+int miller_rabin_single(const mpz_t n, const mpz_t a, int debug, log_sink_t *log) {
     mpz_t nm1, d, x;
     mpz_init(nm1);
     mpz_init(d);
@@ -18,19 +349,11 @@ int miller_rabin_single(const mpz_t n, const mpz_t a, int debug, FILE *fp) {
     }
     mpz_powm(x, a, d, n); // x = a^d mod n
     if (debug) {
-        char *a_str = mpz_get_str(NULL, 10, a);
-        char *d_str = mpz_get_str(NULL, 10, d);
-        char *x_str = mpz_get_str(NULL, 10, x);
-        fprintf(fp, "  Base a = %s, s = %lu, d = %s, x = %s\n", a_str, s, d_str, x_str);
-        fprintf(stdout, "  Base a = %s, s = %lu, d = %s, x = %s\n", a_str, s, d_str, x_str);
-        free(a_str);
-        free(d_str);
-        free(x_str);
+        log_event(log, LOG_BASE, s, a, d, x);
     }
     if (mpz_cmp_ui(x, 1) == 0 || mpz_cmp(x, nm1) == 0) {
-        if (debug && (mpz_cmp_ui(x, 1) == 0 || mpz_cmp(x, nm1) == 0)) {
-            fprintf(fp, "  Passes: x = %s\n", mpz_cmp_ui(x, 1) == 0 ? "1" : "n-1");
-            fprintf(stdout, "  Passes: x = %s\n", mpz_cmp_ui(x, 1) == 0 ? "1" : "n-1");
+        if (debug) {
+            log_event(log, LOG_PASS_X, mpz_cmp_ui(x, 1) == 0, NULL, NULL, NULL);
         }
         mpz_clear(nm1);
         mpz_clear(d);
@@ -43,15 +366,11 @@ int miller_rabin_single(const mpz_t n, const mpz_t a, int debug, FILE *fp) {
             mpz_powm_ui(x, x, 2, n); // x = x^2 mod n
         }
         if (debug) {
-            char *x_str = mpz_get_str(NULL, 10, x);
-            fprintf(fp, "  r = %lu, x = %s\n", r, x_str);
-            fprintf(stdout, "  r = %lu, x = %s\n", r, x_str);
-            free(x_str);
+            log_event(log, LOG_STEP, r, x, NULL, NULL);
         }
         if (mpz_cmp(x, nm1) == 0) {
             if (debug) {
-                fprintf(fp, "  Passes: x = n-1 at r = %lu\n", r);
-                fprintf(stdout, "  Passes: x = n-1 at r = %lu\n", r);
+                log_event(log, LOG_PASS_STEP, r, NULL, NULL, NULL);
             }
             mpz_clear(nm1);
             mpz_clear(d);
@@ -60,8 +379,7 @@ int miller_rabin_single(const mpz_t n, const mpz_t a, int debug, FILE *fp) {
         }
     }
     if (debug) {
-        fprintf(fp, "  Fails: no pass condition met\n");
-        fprintf(stdout, "  Fails: no pass condition met\n");
+        log_event(log, LOG_FAIL, 0, NULL, NULL, NULL);
     }
     mpz_clear(nm1);
     mpz_clear(d);
@@ -69,8 +387,566 @@ int miller_rabin_single(const mpz_t n, const mpz_t a, int debug, FILE *fp) {
     return 0;
 }
 
-// Generate a random prime of bitlen bits using Miller-Rabin with k rounds
-void generate_prime(mpz_t p, unsigned int bitlen, gmp_randstate_t state, int k, FILE *fp) {
+// ---------------------------------------------------------------------------
+// Native fast path for word-sized n: Montgomery arithmetic kept in registers,
+// deterministic bases, no GMP allocation.
+// ---------------------------------------------------------------------------
+
+#if GMP_NUMB_BITS != 64
+#error "native fast path assumes 64-bit GMP limbs"
+#endif
+
+typedef unsigned __int128 u128;
+
+static const uint32_t small_primes[] = {3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41, 43, 47, 53, 59, 61, 67, 71};
+#define NUM_SMALL_PRIMES (sizeof(small_primes) / sizeof(small_primes[0]))
+
+// Returns 1 if n is prime, 0 if composite, -1 if n has no factor in small_primes and needs a full test
+static int trial_division_small(u128 n) {
+    if (n < 2) return 0;
+    if (n == 2) return 1;
+    if ((n & 1) == 0) return 0;
+    if (n < 73 * 73) {
+        for (size_t i = 0; i < NUM_SMALL_PRIMES; i++) {
+            if (n == small_primes[i]) return 1;
+            if (n % small_primes[i] == 0) return 0;
+        }
+        return 1;
+    }
+    // Two 128-bit reductions by prime products, then cheap 64-bit remainders
+    uint64_t r1 = (uint64_t)(n % 614889782588491410ULL); // 2 * 3 * 5 * ... * 47
+    uint64_t r2 = (uint64_t)(n % 907383479ULL);          // 53 * 59 * 61 * 67 * 71
+    for (size_t i = 0; i < NUM_SMALL_PRIMES; i++) {
+        uint64_t r = (small_primes[i] <= 47) ? r1 : r2;
+        if (r % small_primes[i] == 0) return 0;
+    }
+    return -1;
+}
+
+// Montgomery context for odd 64-bit n with R = 2^64
+typedef struct {
+    uint64_t n;
+    uint64_t ninv; // n^-1 mod 2^64
+    uint64_t one;  // R mod n
+    uint64_t r2;   // R^2 mod n
+} mont64_t;
+
+static void mont64_init(mont64_t *m, uint64_t n) {
+    uint64_t x = n; // correct to 3 bits for odd n; each Newton step doubles that
+    for (int i = 0; i < 5; i++) x *= 2 - n * x;
+    m->n = n;
+    m->ninv = x;
+    m->one = (0 - n) % n;
+    m->r2 = (uint64_t)(((u128)m->one * m->one) % n);
+}
+
+// (t / R) mod n for t < n * R
+static inline uint64_t mont64_redc(const mont64_t *m, u128 t) {
+    uint64_t q = (uint64_t)t * m->ninv;
+    uint64_t h = (uint64_t)(((u128)q * m->n) >> 64);
+    uint64_t hi = (uint64_t)(t >> 64);
+    return (hi >= h) ? hi - h : hi - h + m->n;
+}
+
+static inline uint64_t mont64_mul(const mont64_t *m, uint64_t a, uint64_t b) {
+    return mont64_redc(m, (u128)a * b);
+}
+
+static inline uint64_t mont64_pow(const mont64_t *m, uint64_t base, uint64_t e) {
+    uint64_t result = m->one;
+    while (e) {
+        if (e & 1) result = mont64_mul(m, result, base);
+        base = mont64_mul(m, base, base);
+        e >>= 1;
+    }
+    return result;
+}
+
+// Strong probable-prime test to base a (a already reduced mod n, nonzero) in Montgomery form
+static int sprp64(const mont64_t *m, uint64_t a, uint64_t d, unsigned s) {
+    uint64_t minus_one = m->n - m->one;
+    uint64_t x = mont64_pow(m, mont64_mul(m, a, m->r2), d);
+    if (x == m->one || x == minus_one) return 1;
+    for (unsigned r = 1; r < s; r++) {
+        x = mont64_mul(m, x, x);
+        if (x == minus_one) return 1;
+        if (x == m->one) return 0;
+    }
+    return 0;
+}
+
+// Deterministic for every n < 2^64 (Jim Sinclair's 7-base set)
+int is_prime_u64(uint64_t n) {
+    static const uint64_t bases[] = {2, 325, 9375, 28178, 450775, 9780504, 1795265022};
+    int small = trial_division_small(n);
+    if (small >= 0) return small;
+    mont64_t m;
+    mont64_init(&m, n);
+    uint64_t d = n - 1;
+    unsigned s = __builtin_ctzll(d);
+    d >>= s;
+    for (size_t i = 0; i < sizeof(bases) / sizeof(bases[0]); i++) {
+        uint64_t a = bases[i] % n;
+        if (a == 0) continue;
+        if (!sprp64(&m, a, d, s)) return 0;
+    }
+    return 1;
+}
+
+// Montgomery context for odd 128-bit n with R = 2^128
+typedef struct {
+    u128 n;
+    u128 ninv; // n^-1 mod 2^128
+    u128 one;  // R mod n
+    u128 r2;   // R^2 mod n
+} mont128_t;
+
+static inline void mul128_full(u128 a, u128 b, u128 *hi, u128 *lo) {
+    uint64_t a0 = (uint64_t)a, a1 = (uint64_t)(a >> 64);
+    uint64_t b0 = (uint64_t)b, b1 = (uint64_t)(b >> 64);
+    u128 p00 = (u128)a0 * b0;
+    u128 p01 = (u128)a0 * b1;
+    u128 p10 = (u128)a1 * b0;
+    u128 p11 = (u128)a1 * b1;
+    u128 mid = (p00 >> 64) + (uint64_t)p01 + (uint64_t)p10;
+    *lo = (mid << 64) | (uint64_t)p00;
+    *hi = p11 + (p01 >> 64) + (p10 >> 64) + (mid >> 64);
+}
+
+static inline u128 mod128_add(u128 a, u128 b, u128 n) {
+    u128 s = a + b;
+    return (s < a || s >= n) ? s - n : s;
+}
+
+static inline u128 mod128_sub(u128 a, u128 b, u128 n) {
+    return (a >= b) ? a - b : a - b + n;
+}
+
+// x / 2 mod n
+static inline u128 mod128_half(u128 x, u128 n) {
+    return (x & 1) ? (x >> 1) + (n >> 1) + 1 : x >> 1;
+}
+
+static void mont128_init(mont128_t *m, u128 n) {
+    u128 x = n;
+    for (int i = 0; i < 6; i++) x *= 2 - n * x;
+    m->n = n;
+    m->ninv = x;
+    m->one = (0 - n) % n;
+    u128 r2 = m->one;
+    for (int i = 0; i < 128; i++) r2 = mod128_add(r2, r2, n);
+    m->r2 = r2;
+}
+
+static inline u128 mont128_mul(const mont128_t *m, u128 a, u128 b) {
+    u128 hi, lo, qh, ql;
+    mul128_full(a, b, &hi, &lo);
+    mul128_full(lo * m->ninv, m->n, &qh, &ql);
+    return (hi >= qh) ? hi - qh : hi - qh + m->n;
+}
+
+static inline u128 mont128_from(const mont128_t *m, u128 x) {
+    return mont128_mul(m, x % m->n, m->r2);
+}
+
+static u128 mont128_pow(const mont128_t *m, u128 base, u128 e) {
+    u128 result = m->one;
+    while (e) {
+        if (e & 1) result = mont128_mul(m, result, base);
+        base = mont128_mul(m, base, base);
+        e >>= 1;
+    }
+    return result;
+}
+
+// Jacobi symbol (a/n) for odd n
+static int jacobi128(u128 a, u128 n) {
+    int t = 1;
+    a %= n;
+    while (a != 0) {
+        while ((a & 1) == 0) {
+            a >>= 1;
+            unsigned r = (unsigned)(n & 7);
+            if (r == 3 || r == 5) t = -t;
+        }
+        u128 tmp = a; a = n; n = tmp;
+        if ((a & 3) == 3 && (n & 3) == 3) t = -t;
+        a %= n;
+    }
+    return (n == 1) ? t : 0;
+}
+
+static int is_square128(u128 n) {
+    // isqrt(n) < 2^64; clamp the estimate and compare by division so nothing overflows near 2^128
+    long double s = sqrtl((long double)n);
+    uint64_t r = (s >= 0x1p64L) ? UINT64_MAX : (uint64_t)s;
+    while (r > 0 && r > n / r) r--;
+    while (r < UINT64_MAX && (u128)r + 1 <= n / ((u128)r + 1)) r++;
+    return (u128)r * r == n;
+}
+
+// Strong Lucas probable-prime test with Selfridge parameters (P = 1, Q = (1 - D) / 4)
+static int strong_lucas128(const mont128_t *m) {
+    u128 n = m->n;
+    long D = 5;
+    int tries = 0;
+    for (;;) {
+        u128 Dmod = (D > 0) ? (u128)D % n : n - ((u128)(-D) % n);
+        int j = jacobi128(Dmod, n);
+        if (j == -1) break;
+        if (j == 0 && (u128)(D > 0 ? D : -D) != n) return 0;
+        if (++tries == 16 && is_square128(n)) return 0;
+        D = (D > 0) ? -(D + 2) : -(D - 2);
+    }
+    long Q = (1 - D) / 4;
+    u128 Dm = mont128_from(m, (D > 0) ? (u128)D : n - ((u128)(-D) % n));
+    u128 Qm = mont128_from(m, (Q > 0) ? (u128)Q : n - ((u128)(-Q) % n));
+
+    u128 d = n + 1;
+    unsigned s = 0;
+    while ((d & 1) == 0) { d >>= 1; s++; }
+
+    // Walk the bits of d from the top: (U, V, Q^k) at k, then k -> 2k (+1)
+    u128 U = m->one, V = m->one, Qk = Qm;
+    int bit = (d >> 64) ? 127 - __builtin_clzll((uint64_t)(d >> 64)) : 63 - __builtin_clzll((uint64_t)d);
+    for (bit--; bit >= 0; bit--) {
+        U = mont128_mul(m, U, V);
+        V = mod128_sub(mont128_mul(m, V, V), mod128_add(Qk, Qk, n), n);
+        Qk = mont128_mul(m, Qk, Qk);
+        if ((d >> bit) & 1) {
+            u128 U2 = mod128_half(mod128_add(U, V, n), n);
+            V = mod128_half(mod128_add(mont128_mul(m, Dm, U), V, n), n);
+            U = U2;
+            Qk = mont128_mul(m, Qk, Qm);
+        }
+    }
+    if (U == 0 || V == 0) return 1;
+    for (unsigned r = 1; r < s; r++) {
+        V = mod128_sub(mont128_mul(m, V, V), mod128_add(Qk, Qk, n), n);
+        if (V == 0) return 1;
+        Qk = mont128_mul(m, Qk, Qk);
+    }
+    return 0;
+}
+
+// Baillie-PSW: strong base-2 test plus strong Lucas test (no known counterexample below 2^128)
+int is_prime_u128(u128 n) {
+    if ((n >> 64) == 0) return is_prime_u64((uint64_t)n);
+    int small = trial_division_small(n);
+    if (small >= 0) return small;
+    mont128_t m;
+    mont128_init(&m, n);
+    u128 d = n - 1;
+    unsigned s = 0;
+    while ((d & 1) == 0) { d >>= 1; s++; }
+    u128 minus_one = n - m.one;
+    u128 x = mont128_pow(&m, mod128_add(m.one, m.one, n), d);
+    if (x != m.one && x != minus_one) {
+        unsigned r;
+        for (r = 1; r < s; r++) {
+            x = mont128_mul(&m, x, x);
+            if (x == minus_one) break;
+        }
+        if (r == s) return 0;
+    }
+    return strong_lucas128(&m);
+}
+
+// Primality with automatic routing: n < 2^128 takes the deterministic native path,
+// larger n falls back to k random-base GMP Miller-Rabin rounds.
+int is_probable_prime(const mpz_t n, int k, gmp_randstate_t state, log_sink_t *log) {
+    if (mpz_sgn(n) <= 0) return 0;
+    size_t bits = mpz_sizeinbase(n, 2);
+    if (bits <= 64) {
+        return is_prime_u64(mpz_getlimbn(n, 0));
+    }
+    if (bits <= 128) {
+        return is_prime_u128(((u128)mpz_getlimbn(n, 1) << 64) | mpz_getlimbn(n, 0));
+    }
+    if (mpz_even_p(n)) return 0;
+    mpz_t a;
+    mpz_init(a);
+    int is_prime = 1;
+    for (int i = 0; i < k; i++) {
+        mpz_urandomm(a, state, n);
+        if (mpz_cmp_ui(a, 2) < 0) mpz_set_ui(a, 2);
+        if (!miller_rabin_single(n, a, 0, log)) {
+            is_prime = 0;
+            break;
+        }
+    }
+    mpz_clear(a);
+    return is_prime;
+}
+
+// Pool of worker threads for parallel witness testing, each with its own GMP random state
+typedef struct {
+    int nthreads;
+    gmp_randstate_t *states; // states[t] is only ever touched by OpenMP thread t
+} mr_pool_t;
+
+void mr_pool_init(mr_pool_t *pool, int nthreads, unsigned long seed) {
+    pool->nthreads = nthreads;
+    pool->states = malloc(nthreads * sizeof(gmp_randstate_t));
+    for (int t = 0; t < nthreads; t++) {
+        gmp_randinit_mt(pool->states[t]);
+        gmp_randseed_ui(pool->states[t], seed ^ ((unsigned long)t * 0x9E3779B97F4A7C15UL));
+    }
+}
+
+void mr_pool_clear(mr_pool_t *pool) {
+    for (int t = 0; t < pool->nthreads; t++) {
+        gmp_randclear(pool->states[t]);
+    }
+    free(pool->states);
+    pool->states = NULL;
+    pool->nthreads = 0;
+}
+
+// Miller-Rabin with k random bases spread across the pool (returns 1 if probably prime, 0 if composite).
+// The first witness found sets a shared flag so the other workers abandon their remaining bases.
+int miller_rabin_parallel(const mpz_t n, int k, mr_pool_t *pool) {
+    atomic_int composite = 0;
+    #pragma omp parallel num_threads(pool->nthreads)
+    {
+        gmp_randstate_t *local_state = &pool->states[omp_get_thread_num()];
+        mpz_t a;
+        mpz_init(a);
+        #pragma omp for schedule(dynamic, 1)
+        for (int i = 0; i < k; i++) {
+            if (atomic_load_explicit(&composite, memory_order_relaxed)) continue;
+            mpz_urandomm(a, *local_state, n);
+            if (mpz_cmp_ui(a, 2) < 0) mpz_set_ui(a, 2);
+            if (!miller_rabin_single(n, a, 0, NULL)) {
+                atomic_store_explicit(&composite, 1, memory_order_relaxed);
+            }
+        }
+        mpz_clear(a);
+    }
+    return !atomic_load_explicit(&composite, memory_order_relaxed);
+}
+
+// Run `trials` single-base tests on n across the pool and return how many bases lied.
+// Each thread counts privately and publishes once, so aggregation is a single atomic add per thread.
+unsigned long count_false_positives_parallel(const mpz_t n, unsigned long first_trial, unsigned long trials,
+                                             mr_pool_t *pool, log_sink_t *log) {
+    atomic_ulong false_positives = 0;
+    #pragma omp parallel num_threads(pool->nthreads)
+    {
+        gmp_randstate_t *local_state = &pool->states[omp_get_thread_num()];
+        unsigned long local_false_positives = 0;
+        mpz_t a;
+        mpz_init(a);
+        #pragma omp for schedule(static)
+        for (unsigned long i = first_trial; i < first_trial + trials; i++) {
+            mpz_urandomm(a, *local_state, n); // Random a in [0, n-1]
+            if (mpz_cmp_ui(a, 2) < 0) {
+                mpz_set_ui(a, 2); // Ensure a >= 2
+            }
+            if (miller_rabin_single(n, a, 0, log)) {
+                local_false_positives++;
+                log_event(log, LOG_FALSE_POSITIVE, i + 1, a, NULL, NULL);
+            }
+        }
+        mpz_clear(a);
+        atomic_fetch_add_explicit(&false_positives, local_false_positives, memory_order_relaxed);
+    }
+    return atomic_load_explicit(&false_positives, memory_order_relaxed);
+}
+
+// ---------------------------------------------------------------------------
+// Batch primality: one sieve pass over the whole batch, then the survivors
+// are spread over the worker pool for strong-probable-prime rounds.
+// ---------------------------------------------------------------------------
+
+#define SIEVE_LIMIT 4096   // trial-divide by every odd prime below this
+#define SIEVE_CHUNK 512    // candidates per filter work item
+
+// Odd primes below SIEVE_LIMIT with what the vectorized remainder needs per prime:
+// 2^24 and 2^32 mod p for folding, and p^-1 mod 2^32 with (2^32 - 1) / p, since
+// r is divisible by p iff r * p^-1 mod 2^32 <= (2^32 - 1) / p.
+typedef struct {
+    int num_primes;
+    uint32_t primes[SIEVE_LIMIT / 2];
+    uint32_t pow24[SIEVE_LIMIT / 2];
+    uint32_t pow32[SIEVE_LIMIT / 2];
+    uint32_t pinv[SIEVE_LIMIT / 2];
+    uint32_t plim[SIEVE_LIMIT / 2];
+} sieve_table_t;
+
+static void sieve_table_init(sieve_table_t *t) {
+    static unsigned char composite[SIEVE_LIMIT];
+    t->num_primes = 0;
+    for (uint32_t i = 3; i < SIEVE_LIMIT; i += 2) {
+        if (composite[i]) continue;
+        for (uint32_t j = i * i; j < SIEVE_LIMIT; j += 2 * i) composite[j] = 1;
+        uint32_t inv = i;
+        for (int k = 0; k < 4; k++) inv *= 2 - i * inv;
+        t->primes[t->num_primes] = i;
+        t->pow24[t->num_primes] = (1u << 24) % i;
+        t->pow32[t->num_primes] = (uint32_t)((1ULL << 32) % i);
+        t->pinv[t->num_primes] = inv;
+        t->plim[t->num_primes] = UINT32_MAX / i;
+        t->num_primes++;
+    }
+}
+
+// Mark hit[i] for every candidate divisible by a table prime. Candidates arrive transposed as
+// 32-bit digits (digits[j * len + i] is digit j of candidate i), so every step below is a
+// 32x32->64 multiply-add across the batch and vectorizes.
+static void sieve_filter(const sieve_table_t *t, const uint32_t *digits, size_t ndigits, size_t len,
+                         uint32_t *hit, uint64_t *acc, uint32_t *weight) {
+    for (int k = 0; k < t->num_primes; k++) {
+        uint32_t p = t->primes[k], pow24 = t->pow24[k], pow32 = t->pow32[k];
+        uint32_t pinv = t->pinv[k], plim = t->plim[k];
+        // weight[j] = 2^(32 j) mod p, so n mod p == sum(digit[j] * weight[j]) mod p
+        weight[0] = 1;
+        for (size_t j = 1; j < ndigits; j++) weight[j] = (uint32_t)(((uint64_t)weight[j - 1] * pow32) % p);
+        for (size_t i = 0; i < len; i++) acc[i] = digits[i];
+        for (size_t j = 1; j < ndigits; j++) {
+            const uint32_t *dj = digits + j * len;
+            uint64_t w = weight[j];
+            #pragma omp simd
+            for (size_t i = 0; i < len; i++) acc[i] += dj[i] * w;
+        }
+        // acc < 2^56: fold to below 2^37, then below 2^26, then the multiply-compare divisibility test
+        #pragma omp simd
+        for (size_t i = 0; i < len; i++) {
+            uint64_t x = (acc[i] >> 32) * pow32 + (uint32_t)acc[i];
+            x = (x >> 24) * pow24 + (x & 0xffffff);
+            hit[i] |= ((uint32_t)x * pinv <= plim);
+        }
+    }
+}
+
+// Per-stage counters for primality_batch
+typedef struct {
+    size_t candidates;
+    size_t native;      // n < 2^128, decided by the deterministic native path
+    size_t sieved_out;  // rejected by trial division
+    size_t survivors;   // handed to the worker pool
+    size_t primes;
+    double native_seconds;
+    double filter_seconds;
+    double sprp_seconds;
+} batch_stats_t;
+
+// Test count candidates; bit i of bitmap (ceil(count / 64) words) is set iff cands[i] is probably prime.
+// Returns the number of probable primes.
+size_t primality_batch(const mpz_t *cands, size_t count, int k, mr_pool_t *pool,
+                       uint64_t *bitmap, batch_stats_t *stats) {
+    static sieve_table_t table;
+    static int table_ready = 0;
+    #pragma omp critical(sieve_table)
+    if (!table_ready) {
+        sieve_table_init(&table);
+        table_ready = 1;
+    }
+
+    batch_stats_t st = {0};
+    st.candidates = count;
+    unsigned char *result = calloc(count, 1);
+    size_t *large = malloc(count * sizeof(size_t));
+    size_t num_large = 0;
+
+    // Stage 1: word-sized inputs never touch GMP arithmetic
+    double t0 = omp_get_wtime();
+    for (size_t i = 0; i < count; i++) {
+        if (mpz_sizeinbase(cands[i], 2) > 128 && mpz_sgn(cands[i]) > 0) {
+            large[num_large++] = i;
+        }
+    }
+    st.native = count - num_large;
+    #pragma omp parallel for schedule(static) num_threads(pool->nthreads)
+    for (size_t i = 0; i < count; i++) {
+        if (mpz_sizeinbase(cands[i], 2) <= 128 || mpz_sgn(cands[i]) <= 0) {
+            result[i] = (unsigned char)is_probable_prime(cands[i], 0, NULL, NULL);
+        }
+    }
+
+    // Stage 2: trial division of every large candidate by all odd primes below SIEVE_LIMIT
+    double t1 = omp_get_wtime();
+    uint32_t *hit = calloc(num_large, sizeof(uint32_t));
+    size_t ndigits = 1;
+    for (size_t i = 0; i < num_large; i++) {
+        size_t nd = (mpz_sizeinbase(cands[large[i]], 2) + 31) / 32;
+        if (nd > ndigits) ndigits = nd;
+    }
+    #pragma omp parallel num_threads(pool->nthreads)
+    {
+        uint32_t *digits = malloc(ndigits * SIEVE_CHUNK * sizeof(uint32_t));
+        uint64_t *acc = malloc(SIEVE_CHUNK * sizeof(uint64_t));
+        uint32_t *weight = malloc(ndigits * sizeof(uint32_t));
+        #pragma omp for schedule(dynamic)
+        for (size_t base = 0; base < num_large; base += SIEVE_CHUNK) {
+            size_t len = (num_large - base < SIEVE_CHUNK) ? num_large - base : SIEVE_CHUNK;
+            for (size_t i = 0; i < len; i++) {
+                const mpz_srcptr n = cands[large[base + i]];
+                size_t limbs = mpz_size(n);
+                for (size_t j = 0; j < ndigits; j++) {
+                    mp_limb_t limb = (j / 2 < limbs) ? mpz_getlimbn(n, j / 2) : 0;
+                    digits[j * len + i] = (uint32_t)(limb >> (32 * (j % 2)));
+                }
+                hit[base + i] = mpz_even_p(n);
+            }
+            sieve_filter(&table, digits, ndigits, len, hit + base, acc, weight);
+        }
+        free(digits);
+        free(acc);
+        free(weight);
+    }
+    size_t *survivors = malloc((num_large + 1) * sizeof(size_t));
+    size_t num_survivors = 0;
+    for (size_t i = 0; i < num_large; i++) {
+        if (!hit[i]) survivors[num_survivors++] = large[i];
+    }
+    st.sieved_out = num_large - num_survivors;
+    st.survivors = num_survivors;
+
+    // Stage 3: k random-base rounds per survivor on the worker pool
+    double t2 = omp_get_wtime();
+    #pragma omp parallel num_threads(pool->nthreads)
+    {
+        gmp_randstate_t *local_state = &pool->states[omp_get_thread_num()];
+        mpz_t a;
+        mpz_init(a);
+        #pragma omp for schedule(dynamic, 1)
+        for (size_t s = 0; s < num_survivors; s++) {
+            const mpz_srcptr n = cands[survivors[s]];
+            int is_prime = 1;
+            for (int i = 0; i < k && is_prime; i++) {
+                mpz_urandomm(a, *local_state, n);
+                if (mpz_cmp_ui(a, 2) < 0) mpz_set_ui(a, 2);
+                is_prime = miller_rabin_single(n, a, 0, NULL);
+            }
+            result[survivors[s]] = (unsigned char)is_prime;
+        }
+        mpz_clear(a);
+    }
+    double t3 = omp_get_wtime();
+
+    for (size_t w = 0; w < (count + 63) / 64; w++) bitmap[w] = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (result[i]) {
+            bitmap[i / 64] |= 1ULL << (i % 64);
+            st.primes++;
+        }
+    }
+    st.native_seconds = t1 - t0;
+    st.filter_seconds = t2 - t1;
+    st.sprp_seconds = t3 - t2;
+    if (stats) *stats = st;
+
+    free(result);
+    free(large);
+    free(hit);
+    free(survivors);
+    return st.primes;
+}
+
+// Generate a random prime of bitlen bits using Miller-Rabin with k rounds.
+// With a pool, only candidates that survive the first base pay for spreading the other k-1 bases.
+void generate_prime(mpz_t p, unsigned int bitlen, gmp_randstate_t state, int k, mr_pool_t *pool, log_sink_t *log) {
     mpz_t a;
     mpz_init(a);
     while (1) {
@@ -79,13 +955,12 @@ void generate_prime(mpz_t p, unsigned int bitlen, gmp_randstate_t state, int k,
         mpz_setbit(p, 0); // Make odd
         if (mpz_cmp_ui(p, 3) <= 0) continue; // Skip small numbers
         int is_prime = 1;
-        for (int i = 0; i < k; i++) {
+        if (pool != NULL && pool->nthreads > 1 && bitlen > 128) {
             mpz_urandomm(a, state, p);
             if (mpz_cmp_ui(a, 2) < 0) mpz_set_ui(a, 2);
-            if (!miller_rabin_single(p, a, 0, fp)) {
-                is_prime = 0;
-                break;
-            }
+            is_prime = miller_rabin_single(p, a, 0, log) && miller_rabin_parallel(p, k - 1, pool);
+        } else {
+            is_prime = is_probable_prime(p, k, state, log);
         }
         if (is_prime) break;
     }
@@ -93,7 +968,7 @@ void generate_prime(mpz_t p, unsigned int bitlen, gmp_randstate_t state, int k,
 }
 
 // Test Miller-Rabin on a known semiprime (221 = 13 * 17)
-void test_known_composite(FILE *fp) {
+void test_known_composite(log_sink_t *log) {
     mpz_t n, a;
     mpz_init_set_ui(n, 221);
     mpz_init(a);
@@ -104,21 +979,210 @@ void test_known_composite(FILE *fp) {
     for (int i = 0; i < 100; i++) {
         mpz_urandomm(a, state, n);
         if (mpz_cmp_ui(a, 2) < 0) mpz_set_ui(a, 2);
-        if (miller_rabin_single(n, a, 1, fp)) {
+        if (miller_rabin_single(n, a, 1, log)) {
             false_positives++;
         }
     }
-    fprintf(fp, "Test on n=221 (13 * 17): %d false positives out of 100 trials\n", false_positives);
-    fprintf(stdout, "Test on n=221 (13 * 17): %d false positives out of 100 trials\n", false_positives);
+    log_text(log, "Test on n=221 (13 * 17): %d false positives out of 100 trials\n", false_positives);
     mpz_clear(n);
     mpz_clear(a);
     gmp_randclear(state);
 }
 
-int main() {
-    FILE *fp = fopen("results_miller.txt", "w");
+// Cross-check the native path against GMP on known hard cases and random word-sized inputs
+void test_fast_path(gmp_randstate_t state, log_sink_t *log) {
+    const char *known[] = {
+        "221", "561", "3215031751", "3825123056546413051", "18446744073709551557", // composites, then a prime
+        "2305843009213693951", "618970019642690137449562111", "170141183460469231731687303715884105727",
+        "340282366920938463463374607431768211297", "340282366920938463463374607431768211455",
+    };
+    mpz_t n;
+    mpz_init(n);
+    int mismatches = 0;
+    for (size_t i = 0; i < sizeof(known) / sizeof(known[0]); i++) {
+        mpz_set_str(n, known[i], 10);
+        int fast = is_probable_prime(n, 0, state, log);
+        int ref = mpz_probab_prime_p(n, 50) != 0;
+        if (fast != ref) mismatches++;
+        log_text(log, "  %s: %s\n", known[i], fast ? "prime" : "composite");
+    }
+
+    const int samples = 200000;
+    for (int bits = 64; bits <= 128; bits += 64) {
+        mpz_t *cands = malloc(samples * sizeof(mpz_t));
+        for (int i = 0; i < samples; i++) {
+            mpz_init(cands[i]);
+            mpz_urandomb(cands[i], state, bits);
+            mpz_setbit(cands[i], 0);
+        }
+        int *fast = malloc(samples * sizeof(int));
+        double t0 = omp_get_wtime();
+        for (int i = 0; i < samples; i++) fast[i] = is_probable_prime(cands[i], 0, state, log);
+        double t1 = omp_get_wtime();
+        for (int i = 0; i < samples; i++) {
+            if (fast[i] != (mpz_probab_prime_p(cands[i], 25) != 0)) mismatches++;
+        }
+        double t2 = omp_get_wtime();
+        log_text(log, "  %d-bit odd inputs: native %.1f ns/query, GMP %.1f ns/query\n",
+                bits, (t1 - t0) * 1e9 / samples, (t2 - t1) * 1e9 / samples);
+        for (int i = 0; i < samples; i++) mpz_clear(cands[i]);
+        free(cands);
+        free(fast);
+    }
+    log_text(log, "Native fast path vs GMP: %d mismatches\n", mismatches);
+    mpz_clear(n);
+}
+
+// Run the batch API over random 256-bit odd candidates plus a word-sized tail and compare with one-at-a-time testing
+void test_batch(gmp_randstate_t state, mr_pool_t *pool, log_sink_t *log) {
+    const size_t count = 20000, small = 2000;
+    mpz_t *cands = malloc(count * sizeof(mpz_t));
+    for (size_t i = 0; i < count; i++) {
+        mpz_init(cands[i]);
+        mpz_urandomb(cands[i], state, (i < count - small) ? 256 : 64);
+        mpz_setbit(cands[i], 0);
+    }
+    uint64_t *bitmap = malloc(((count + 63) / 64) * sizeof(uint64_t));
+    batch_stats_t st;
+    size_t primes = primality_batch(cands, count, 25, pool, bitmap, &st);
+
+    size_t mismatches = 0;
+    for (size_t i = 0; i < count; i++) {
+        int expected = mpz_probab_prime_p(cands[i], 25) != 0;
+        if (expected != (int)((bitmap[i / 64] >> (i % 64)) & 1)) mismatches++;
+    }
+    log_text(log, "  %zu candidates: %zu native, %zu sieved out, %zu survivors, %zu probable primes\n",
+             st.candidates, st.native, st.sieved_out, st.survivors, primes);
+    log_text(log, "  Stage times: native %.3f ms, filter %.3f ms, SPRP %.3f ms\n",
+             st.native_seconds * 1e3, st.filter_seconds * 1e3, st.sprp_seconds * 1e3);
+    log_text(log, "Batch vs mpz_probab_prime_p: %zu mismatches\n", mismatches);
+
+    for (size_t i = 0; i < count; i++) mpz_clear(cands[i]);
+    free(cands);
+    free(bitmap);
+}
+
+// ---------------------------------------------------------------------------
+// bench.h cases for the timed kernels: size is the bit length of the number
+// under test (of p for prime generation, of n = p * q for single rounds).
+// ---------------------------------------------------------------------------
+
+typedef enum {
+    MR_BENCH_ROUND,     // one miller_rabin_single base on a semiprime
+    MR_BENCH_ROUNDS,    // miller_rabin_parallel with MR_BENCH_ROUNDS_K bases on a prime, so none exit early
+    MR_BENCH_PRIME,     // generate_prime with 41 rounds
+} mr_bench_kind_t;
+
+#define MR_BENCH_ROUNDS_K 40
+
+typedef struct {
+    mr_bench_kind_t kind;
+    unsigned int bits;
+    gmp_randstate_t state;
+    mr_pool_t pool;
+    mpz_t n, a, p;
+} mr_bench_t;
+
+static const mr_bench_kind_t mr_bench_kinds[] = {MR_BENCH_ROUND, MR_BENCH_ROUNDS, MR_BENCH_PRIME};
+
+static void *mr_bench_setup(const bench_params_t *params, const void *arg) {
+    mr_bench_t *b = malloc(sizeof(mr_bench_t));
+    b->kind = *(const mr_bench_kind_t *)arg;
+    b->bits = (unsigned int)params->size;
+    gmp_randinit_mt(b->state);
+    gmp_randseed_ui(b->state, 12345);
+    mr_pool_init(&b->pool, params->threads, 54321);
+    mpz_init(b->n);
+    mpz_init(b->a);
+    mpz_init(b->p);
+    if (b->kind == MR_BENCH_ROUND) {
+        mpz_t q;
+        mpz_init(q);
+        generate_prime(b->p, b->bits / 2, b->state, 41, NULL, NULL);
+        generate_prime(q, b->bits - b->bits / 2, b->state, 41, NULL, NULL);
+        mpz_mul(b->n, b->p, q);
+        mpz_clear(q);
+    } else if (b->kind == MR_BENCH_ROUNDS) {
+        generate_prime(b->n, b->bits, b->state, 41, NULL, NULL);
+    }
+    return b;
+}
+
+// Fresh base in [2, n-1] for every single round, as the false-positive loop in main draws them
+static void mr_bench_prepare(void *ctx) {
+    mr_bench_t *b = ctx;
+    if (b->kind != MR_BENCH_ROUND) return;
+    mpz_urandomm(b->a, b->state, b->n);
+    if (mpz_cmp_ui(b->a, 2) < 0) mpz_set_ui(b->a, 2);
+}
+
+static void mr_bench_run(void *ctx) {
+    mr_bench_t *b = ctx;
+    switch (b->kind) {
+    case MR_BENCH_ROUND: miller_rabin_single(b->n, b->a, 0, NULL); break;
+    case MR_BENCH_ROUNDS: miller_rabin_parallel(b->n, MR_BENCH_ROUNDS_K, &b->pool); break;
+    case MR_BENCH_PRIME: generate_prime(b->p, b->bits, b->state, 41, &b->pool, NULL); break;
+    }
+}
+
+static void mr_bench_teardown(void *ctx) {
+    mr_bench_t *b = ctx;
+    mpz_clear(b->n);
+    mpz_clear(b->a);
+    mpz_clear(b->p);
+    mr_pool_clear(&b->pool);
+    gmp_randclear(b->state);
+    free(b);
+}
+
+static const bench_case_t mr_cases[] = {
+    {.name = "mr_round", .backend = "gmp", .setup = mr_bench_setup, .prepare = mr_bench_prepare,
+     .run = mr_bench_run, .teardown = mr_bench_teardown, .bytes_per_run = SIZE_MAX, .arg = &mr_bench_kinds[0]},
+    {.name = "mr_rounds", .backend = "pool", .setup = mr_bench_setup, .prepare = mr_bench_prepare,
+     .run = mr_bench_run, .teardown = mr_bench_teardown, .bytes_per_run = SIZE_MAX, .max_threads = 256,
+     .arg = &mr_bench_kinds[1]},
+    {.name = "prime_gen", .backend = "pool", .setup = mr_bench_setup, .prepare = mr_bench_prepare,
+     .run = mr_bench_run, .teardown = mr_bench_teardown, .bytes_per_run = SIZE_MAX, .max_threads = 256,
+     .arg = &mr_bench_kinds[2]},
+};
+
+// Usage: ./miller_rabin [threads] [text|csv|bin]
+//   threads: default (or 0) all cores; 1 runs the original serial loop
+//   format:  results_miller.txt (default), results_miller.csv or results_miller.bin; stdout always gets text
+//        ./miller_rabin bench [bench.h flags]
+//   single rounds, pooled rounds and prime generation as bench.h cases, 1 thread and every core
+int main(int argc, char **argv) {
+    if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+        bench_config_t cfg;
+        bench_config_init(&cfg, 200, 5);
+        size_t sizes[] = {256, 512, 1024};
+        for (int i = 0; i < 3; i++) cfg.sizes[cfg.num_sizes++] = sizes[i];
+        cfg.threads[cfg.num_threads++] = 1;
+        if (omp_get_num_procs() > 1) cfg.threads[cfg.num_threads++] = omp_get_num_procs();
+        return bench_main(mr_cases, sizeof(mr_cases) / sizeof(mr_cases[0]), &cfg, argc - 2, argv + 2);
+    }
+
+    int nthreads = (argc > 1) ? atoi(argv[1]) : omp_get_num_procs();
+    if (nthreads < 1) nthreads = omp_get_num_procs();
+    log_format_t format = LOG_FORMAT_TEXT;
+    const char *results_file = "results_miller.txt";
+    if (argc > 2 && strcmp(argv[2], "csv") == 0) {
+        format = LOG_FORMAT_CSV;
+        results_file = "results_miller.csv";
+    } else if (argc > 2 && strcmp(argv[2], "bin") == 0) {
+        format = LOG_FORMAT_BINARY;
+        results_file = "results_miller.bin";
+    }
+
+    FILE *fp = fopen(results_file, (format == LOG_FORMAT_BINARY) ? "wb" : "w");
     if (fp == NULL) {
-        printf("Error opening results_miller.txt\n");
+        printf("Error opening %s\n", results_file);
+        return 1;
+    }
+    log_sink_t sink;
+    log_sink_t *log = &sink;
+    if (log_open(log, fp, format, 1) != 0) {
+        printf("Error starting the log writer\n");
         return 1;
     }
 
@@ -126,10 +1190,20 @@ int main() {
     gmp_randinit_mt(state);
     gmp_randseed_ui(state, time(NULL) ^ clock()); // Robust seed
 
+    mr_pool_t pool;
+    mr_pool_init(&pool, nthreads, gmp_urandomb_ui(state, 32));
+    fprintf(stdout, "Using %d thread(s), writing %s\n", nthreads, results_file);
+
     // Test Miller-Rabin on a known semiprime to verify
-    fprintf(fp, "Verifying Miller-Rabin on n = 221 (13 * 17)...\n");
-    fprintf(stdout, "Verifying Miller-Rabin on n = 221 (13 * 17)...\n");
-    test_known_composite(fp);
+    log_text(log, "Verifying Miller-Rabin on n = 221 (13 * 17)...\n");
+    test_known_composite(log);
+
+    // Deterministic native path for word-sized inputs
+    log_text(log, "\nChecking the native 64/128-bit fast path...\n");
+    test_fast_path(state, log);
+
+    log_text(log, "\nRunning the batch primality API...\n");
+    test_batch(state, &pool, log);
 
     // Part (a): Generate two 256-bit primes and compute n
     mpz_t p, q, n, a;
@@ -138,57 +1212,48 @@ int main() {
     mpz_init(n);
     mpz_init(a);
 
-    fprintf(fp, "\nGenerating two 256-bit primes...\n");
-    fprintf(stdout, "\nGenerating two 256-bit primes...\n");
-    generate_prime(p, 256, state, 41, fp);
-    generate_prime(q, 256, state, 41, fp);
+    log_text(log, "\nGenerating two 256-bit primes...\n");
+    generate_prime(p, 256, state, 41, &pool, log);
+    generate_prime(q, 256, state, 41, &pool, log);
     mpz_mul(n, p, q);
 
-    char *p_str = mpz_get_str(NULL, 10, p);
-    char *q_str = mpz_get_str(NULL, 10, q);
-    char *n_str = mpz_get_str(NULL, 10, n);
-    fprintf(fp, "p: %s\n", p_str);
-    fprintf(fp, "q: %s\n", q_str);
-    fprintf(fp, "n: %s\n", n_str);
-    fprintf(stdout, "p: %s\n", p_str);
-    fprintf(stdout, "q: %s\n", q_str);
-    fprintf(stdout, "n: %s\n", n_str);
-    free(p_str);
-    free(q_str);
-    free(n_str);
+    log_value(log, "p", p);
+    log_value(log, "q", q);
+    log_value(log, "n", n);
 
     // Part (b): Run Miller-Rabin 1,000,000 times on n
-    fprintf(fp, "\nRunning Miller-Rabin 1,000,000 times on n...\n");
-    fprintf(stdout, "\nRunning Miller-Rabin 1,000,000 times on n...\n");
+    log_text(log, "\nRunning Miller-Rabin 1,000,000 times on n...\n");
     unsigned long trials = 1000000;
     unsigned long false_positives = 0;
 
-    for (unsigned long i = 0; i < trials; i++) {
+    // The first 10 trials print their full trace, so they always run serially
+    unsigned long serial_trials = (nthreads > 1) ? 10 : trials;
+    for (unsigned long i = 0; i < serial_trials; i++) {
         mpz_urandomm(a, state, n); // Random a in [0, n-1]
         if (mpz_cmp_ui(a, 2) < 0) {
             mpz_set_ui(a, 2); // Ensure a >= 2
         }
-        if (miller_rabin_single(n, a, (i < 10) ? 1 : 0, fp)) {
+        if (miller_rabin_single(n, a, (i < 10) ? 1 : 0, log)) {
             false_positives++;
-            char *a_str = mpz_get_str(NULL, 10, a);
-            fprintf(fp, "False positive at trial %lu with a = %s\n", i + 1, a_str);
-            fprintf(stdout, "False positive at trial %lu with a = %s\n", i + 1, a_str);
-            free(a_str);
+            log_event(log, LOG_FALSE_POSITIVE, i + 1, a, NULL, NULL);
         }
     }
+    if (serial_trials < trials) {
+        false_positives += count_false_positives_parallel(n, serial_trials, trials - serial_trials, &pool, log);
+    }
 
-    fprintf(fp, "Number of false positives: %lu out of %lu\n", false_positives, trials);
-    fprintf(stdout, "Number of false positives: %lu out of %lu\n", false_positives, trials);
+    log_text(log, "Number of false positives: %lu out of %lu\n", false_positives, trials);
     double error_rate = (double)false_positives / trials;
-    fprintf(fp, "Experimental error rate: %.6f\n", error_rate);
-    fprintf(stdout, "Experimental error rate: %.6f\n", error_rate);
+    log_text(log, "Experimental error rate: %.6f\n", error_rate);
 
     // Cleanup
     mpz_clear(p);
     mpz_clear(q);
     mpz_clear(n);
     mpz_clear(a);
+    mr_pool_clear(&pool);
     gmp_randclear(state);
+    log_close(log);
     fclose(fp);
     return 0;
 }
\ No newline at end of file
@@ -1,14 +1,11 @@
 #define _GNU_SOURCE
 #include <stdint.h>
 #include <stddef.h>
-#include <sched.h>
-#include <sys/mman.h>
-#include <unistd.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
-#include <sys/sysinfo.h>
 #include <x86intrin.h>
+#include "bench.h"
 
 // Macro for one PRGA step
 #define RC4_STEP(i, j, S, data, idx) do { \
@@ -76,100 +73,62 @@ void rc4_crypt(rc4_state_t *state, uint8_t *data, size_t len) {
     state->j = j;
 }
 
-void setup_no_interruptions() {
-    int num_cores = get_nprocs();
-    if (num_cores < 2) {
-        fprintf(stderr, "System has only 1 core; cannot assign a separate core.\n");
-        exit(1);
-    }
-
-    cpu_set_t cpu_mask;
-    CPU_ZERO(&cpu_mask);
-    CPU_SET(num_cores - 1, &cpu_mask);  // Pin to last core
-    if (sched_setaffinity(0, sizeof(cpu_mask), &cpu_mask) == -1) {
-        perror("Failed to set CPU affinity");
-        exit(1);
-    }
-
-    struct sched_param sched_params;
-    sched_params.sched_priority = sched_get_priority_max(SCHED_FIFO);
-    if (sched_setscheduler(0, SCHED_FIFO, &sched_params) == -1) {
-        perror("Failed to set real-time scheduling");
-        exit(1);
-    }
-
-    if (mlockall(MCL_CURRENT | MCL_FUTURE) == -1) {
-        perror("Failed to lock memory");
-        exit(1);
-    }
-}
-
-// Simple LCG for generating unique keys and plaintexts
-static uint32_t lcg_seed = 123456789;
-uint32_t lcg_rand() {
-    lcg_seed = (1103515245 * lcg_seed + 12345) & 0x7fffffff;
-    return lcg_seed;
-}
-
-void generate_random(uint8_t *buf, size_t len) {
-    for (size_t i = 0; i < len; ++i) {
-        buf[i] = (uint8_t)(lcg_rand() & 0xff);
-    }
-}
-
-int main() {
-    setup_no_interruptions();
-
+typedef struct {
     rc4_state_t state;
-    size_t data_len = 1024 * 1024;  // 1 MB
-    uint8_t *data = malloc(data_len);
+    uint8_t *data;
+    size_t len;
     uint8_t key[16];  // 16-byte key
-    if (!data) {
+} rc4_bench_t;
+
+static void *rc4_bench_setup(const bench_params_t *params, const void *arg) {
+    (void)arg;
+    rc4_bench_t *b = malloc(sizeof(rc4_bench_t));
+    b->len = params->size;
+    b->data = malloc(b->len);
+    if (!b->data) {
         perror("Failed to allocate memory");
         exit(1);
     }
+    return b;
+}
 
-    const int runs = 1000000;
-    uint64_t total_cycles = 0;
-
-    // Warm-up run to cache data/instructions
-    generate_random(data, data_len);
-    generate_random(key, sizeof(key));
-    rc4_init(&state, key, sizeof(key));
-    rc4_crypt(&state, data, data_len);
-
-    // Run 1,000,000 iterations with unique plaintext and key
-    for (int i = 0; i < runs; ++i) {
-        generate_random(data, data_len);  // New plaintext
-        generate_random(key, sizeof(key));  // New key
-        rc4_init(&state, key, sizeof(key));  // KSA (excluded from timing)
-
-        uint64_t start = __rdtsc();
-        rc4_crypt(&state, data, data_len);  // Measure PRGA burst
-        uint64_t end = __rdtsc();
-        total_cycles += (end - start);
-
-        if ((i + 1) % 100000 == 0) {
-            printf("Completed %d runs\n", i + 1);
-            fflush(stdout);
-        }
-    }
+// Unique plaintext and key for every run; the KSA is excluded from timing
+static void rc4_bench_prepare(void *ctx) {
+    rc4_bench_t *b = ctx;
+    bench_fill_random(b->data, b->len);
+    bench_fill_random(b->key, sizeof(b->key));
+    rc4_init(&b->state, b->key, sizeof(b->key));
+}
 
-    double avg_cycles = (double)total_cycles / runs;
+// Measure the PRGA burst only
+static void rc4_bench_run(void *ctx) {
+    rc4_bench_t *b = ctx;
+    rc4_crypt(&b->state, b->data, b->len);
+}
 
-    // Print sample of last encrypted data (first 16 bytes)
+static void rc4_bench_teardown(void *ctx) {
+    rc4_bench_t *b = ctx;
     printf("Last encrypted data sample (first 16 bytes, hex): ");
-    for (size_t i = 0; i < 16; ++i) {
-        printf("%02x ", data[i]);
+    for (size_t i = 0; i < 16 && i < b->len; ++i) {
+        printf("%02x ", b->data[i]);
     }
     printf("\n");
+    free(b->data);
+    free(b);
+}
+
+static const bench_case_t rc4_cases[] = {
+    {.name = "rc4", .backend = "unrolled16", .setup = rc4_bench_setup, .prepare = rc4_bench_prepare,
+     .run = rc4_bench_run, .teardown = rc4_bench_teardown},
+};
 
-    // Print results
-    printf("Data size: %zu bytes\n", data_len);
-    printf("Total runs: %d\n", runs);
-    printf("Average cycles (rdtsc, PRGA burst only): %.2f\n", avg_cycles);
-    printf("Average cycles per byte: %.2f\n", avg_cycles / data_len);
+// Usage: ./rc4 [bench.h flags]; defaults are 1,000,000 runs over 1 MB
+int main(int argc, char **argv) {
+    bench_setup_no_interruptions(1);
 
-    free(data);
-    return 0;
-}
\ No newline at end of file
+    bench_config_t cfg;
+    bench_config_init(&cfg, 1000000, 1);
+    cfg.sizes[0] = 1024 * 1024;  // 1 MB
+    cfg.num_sizes = 1;
+    return bench_main(rc4_cases, sizeof(rc4_cases) / sizeof(rc4_cases[0]), &cfg, argc - 1, argv + 1);
+}
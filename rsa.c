@@ -1,18 +1,1669 @@
+#define _GNU_SOURCE
 #include <gmp.h>
 #include <stdio.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <time.h>
+#include <string.h>
 #include <omp.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <immintrin.h>
+#include <fcntl.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include "work_steal.h"
+#include "latency_hist.h"
+#include "bench.h"
 
-// Function to get clock cycles using RDTSC on x86_64
-unsigned long long get_cycles() {
-    unsigned long long low, high;
-    __asm__ volatile("rdtsc" : "=a"(low), "=d"(high));
-    return (high << 32) | low;
+// Serialized TSC read (bench.h) so timed regions cannot drift across the timestamps
+static inline unsigned long long get_cycles(void) {
+    return bench_start();
 }
 
-// Function to benchmark prime generation for all bit sizes in batches
+// RSA private key with the CRT parameters precomputed once per key
+typedef struct {
+    mpz_t N, e, d;
+    mpz_t p, q;
+    mpz_t dP;   // d mod (p - 1)
+    mpz_t dQ;   // d mod (q - 1)
+    mpz_t qInv; // q^-1 mod p
+} rsa_private_key_t;
+
+#define RSA_KEY_FIELDS 8
+
+// Derive N, d, dP, dQ and qInv from p, q and e; returns 0 on success, -1 if e is not invertible
+int rsa_private_key_init(rsa_private_key_t *key, const mpz_t p, const mpz_t q, const mpz_t e) {
+    mpz_init_set(key->p, p);
+    mpz_init_set(key->q, q);
+    mpz_init_set(key->e, e);
+    mpz_init(key->N);
+    mpz_init(key->d);
+    mpz_init(key->dP);
+    mpz_init(key->dQ);
+    mpz_init(key->qInv);
+    mpz_mul(key->N, p, q);
+
+    mpz_t p_minus_1, q_minus_1, phi;
+    mpz_init(p_minus_1);
+    mpz_init(q_minus_1);
+    mpz_init(phi);
+    mpz_sub_ui(p_minus_1, p, 1);
+    mpz_sub_ui(q_minus_1, q, 1);
+    mpz_mul(phi, p_minus_1, q_minus_1);
+    int ok = mpz_invert(key->d, e, phi) && mpz_invert(key->qInv, q, p);
+    if (ok) {
+        mpz_mod(key->dP, key->d, p_minus_1);
+        mpz_mod(key->dQ, key->d, q_minus_1);
+    }
+    mpz_clear(p_minus_1);
+    mpz_clear(q_minus_1);
+    mpz_clear(phi);
+    return ok ? 0 : -1;
+}
+
+void rsa_private_key_clear(rsa_private_key_t *key) {
+    mpz_clear(key->N);
+    mpz_clear(key->e);
+    mpz_clear(key->d);
+    mpz_clear(key->p);
+    mpz_clear(key->q);
+    mpz_clear(key->dP);
+    mpz_clear(key->dQ);
+    mpz_clear(key->qInv);
+}
+
+// Garner recombination: m = m2 + q * (qInv * (m1 - m2) mod p), with m1 = m mod p and m2 = m mod q
+static void rsa_crt_combine(mpz_t m, const mpz_t m1, const mpz_t m2, const rsa_private_key_t *key) {
+    mpz_t h;
+    mpz_init(h);
+    mpz_sub(h, m1, m2);
+    mpz_mul(h, h, key->qInv);
+    mpz_mod(h, h, key->p);
+    mpz_mul(h, h, key->q);
+    mpz_add(m, m2, h);
+    mpz_clear(h);
+}
+
+// Private-key operation m = c^d mod N (decryption, or signing with c as the encoded message)
+// via two half-size exponentiations and Garner recombination. With parallel set, the two
+// halves run on separate OpenMP threads. dP and dQ are the key's exponents or blinded
+// equivalents dP + k (p - 1), dQ + k (q - 1).
+static void rsa_private_crt_exp(mpz_t m, const mpz_t c, const rsa_private_key_t *key, const mpz_t dP,
+                                const mpz_t dQ, int parallel) {
+    mpz_t m1, m2;
+    mpz_init(m1);
+    mpz_init(m2);
+    #pragma omp parallel sections num_threads(2) if (parallel)
+    {
+        #pragma omp section
+        {
+            mpz_t cp;
+            mpz_init(cp);
+            mpz_mod(cp, c, key->p);
+            mpz_powm_sec(m1, cp, dP, key->p); // m1 = c^dP mod p
+            mpz_clear(cp);
+        }
+        #pragma omp section
+        {
+            mpz_t cq;
+            mpz_init(cq);
+            mpz_mod(cq, c, key->q);
+            mpz_powm_sec(m2, cq, dQ, key->q); // m2 = c^dQ mod q
+            mpz_clear(cq);
+        }
+    }
+    rsa_crt_combine(m, m1, m2, key);
+    mpz_clear(m1);
+    mpz_clear(m2);
+}
+
+void rsa_private_crt(mpz_t m, const mpz_t c, const rsa_private_key_t *key, int parallel) {
+    rsa_private_crt_exp(m, c, key, key->dP, key->dQ, parallel);
+}
+
+#define RSA_BLIND_REFRESH 32    // squarings before a slot draws a fresh r (and pays one inversion)
+#define RSA_EXP_BLIND_BITS 64   // size of k in the blinded exponents dP + k (p - 1), dQ + k (q - 1)
+
+// One blinding pair vi = r^e, vf = r^-1 mod N. Each operation squares both, so the pair changes
+// on every call for two extra modular multiplications instead of a fresh inversion.
+typedef struct {
+    _Alignas(64) pthread_mutex_t lock;
+    mpz_t vi, vf;
+    mpz_t dP, dQ, t;          // blinded exponents and scratch
+    gmp_randstate_t rand_state;
+    int uses;
+} rsa_blind_slot_t;
+
+// Per-key blinding state. Threads map onto slots by a thread-local index, so up to num_slots
+// threads never share a pair; with more threads the slot lock keeps shared pairs consistent.
+typedef struct {
+    const rsa_private_key_t *key;
+    int num_slots;
+    int exp_blind;            // also randomize dP and dQ on every call
+    rsa_blind_slot_t *slots;
+} rsa_blinding_t;
+
+static atomic_uint rsa_blind_threads;
+static _Thread_local int rsa_blind_thread = -1;
+
+static void rsa_blind_slot_refresh(rsa_blind_slot_t *slot, const rsa_private_key_t *key) {
+    do {
+        mpz_urandomm(slot->vi, slot->rand_state, key->N); // r
+    } while (mpz_cmp_ui(slot->vi, 1) <= 0 || !mpz_invert(slot->vf, slot->vi, key->N));
+    mpz_powm(slot->vi, slot->vi, key->e, key->N);
+    slot->uses = 0;
+}
+
+void rsa_blinding_init(rsa_blinding_t *blind, const rsa_private_key_t *key, int num_slots, int exp_blind,
+                       unsigned long seed) {
+    blind->key = key;
+    blind->num_slots = num_slots > 0 ? num_slots : 1;
+    blind->exp_blind = exp_blind;
+    blind->slots = aligned_alloc(64, blind->num_slots * sizeof(rsa_blind_slot_t));
+    for (int i = 0; i < blind->num_slots; i++) {
+        rsa_blind_slot_t *slot = &blind->slots[i];
+        pthread_mutex_init(&slot->lock, NULL);
+        mpz_init(slot->vi);
+        mpz_init(slot->vf);
+        mpz_init(slot->dP);
+        mpz_init(slot->dQ);
+        mpz_init(slot->t);
+        gmp_randinit_mt(slot->rand_state);
+        gmp_randseed_ui(slot->rand_state, seed + (unsigned long)i * 0x9E3779B97F4A7C15ULL);
+        rsa_blind_slot_refresh(slot, key);
+    }
+}
+
+void rsa_blinding_clear(rsa_blinding_t *blind) {
+    for (int i = 0; i < blind->num_slots; i++) {
+        rsa_blind_slot_t *slot = &blind->slots[i];
+        pthread_mutex_destroy(&slot->lock);
+        mpz_clear(slot->vi);
+        mpz_clear(slot->vf);
+        mpz_clear(slot->dP);
+        mpz_clear(slot->dQ);
+        mpz_clear(slot->t);
+        gmp_randclear(slot->rand_state);
+    }
+    free(blind->slots);
+}
+
+// Blinded CRT private operation: m = ((c * r^e)^d mod N) * r^-1 = c^d mod N. Safe to call from any
+// number of threads on the same rsa_blinding_t.
+void rsa_private_blinded(mpz_t m, const mpz_t c, rsa_blinding_t *blind) {
+    const rsa_private_key_t *key = blind->key;
+    if (rsa_blind_thread < 0) rsa_blind_thread = (int)atomic_fetch_add(&rsa_blind_threads, 1);
+    rsa_blind_slot_t *slot = &blind->slots[rsa_blind_thread % blind->num_slots];
+
+    mpz_t cb;
+    mpz_init(cb);
+    pthread_mutex_lock(&slot->lock);
+    if (slot->uses >= RSA_BLIND_REFRESH) rsa_blind_slot_refresh(slot, key);
+    mpz_mul(cb, c, slot->vi);
+    mpz_mod(cb, cb, key->N);
+    if (blind->exp_blind) {
+        mpz_urandomb(slot->t, slot->rand_state, RSA_EXP_BLIND_BITS);
+        mpz_sub_ui(slot->dP, key->p, 1);
+        mpz_mul(slot->dP, slot->dP, slot->t);
+        mpz_add(slot->dP, slot->dP, key->dP);
+        mpz_sub_ui(slot->dQ, key->q, 1);
+        mpz_mul(slot->dQ, slot->dQ, slot->t);
+        mpz_add(slot->dQ, slot->dQ, key->dQ);
+        rsa_private_crt_exp(m, cb, key, slot->dP, slot->dQ, 0);
+    } else {
+        rsa_private_crt_exp(m, cb, key, key->dP, key->dQ, 0);
+    }
+    mpz_mul(m, m, slot->vf);
+    mpz_mod(m, m, key->N);
+
+    // Next pair: (r^2)^e = (r^e)^2 and (r^2)^-1 = (r^-1)^2
+    mpz_mul(slot->vi, slot->vi, slot->vi);
+    mpz_mod(slot->vi, slot->vi, key->N);
+    mpz_mul(slot->vf, slot->vf, slot->vf);
+    mpz_mod(slot->vf, slot->vf, key->N);
+    slot->uses++;
+    pthread_mutex_unlock(&slot->lock);
+    mpz_clear(cb);
+}
+
+// ---------------------------------------------------------------------------
+// Key serialization: PKCS#1 DER for interchange, and a native keystore of
+// aligned limb arrays that is mmapped and read through mpz_roinit_n views.
+
+static mpz_ptr rsa_key_field(rsa_private_key_t *key, int f) {
+    mpz_ptr fields[RSA_KEY_FIELDS] = {key->N, key->e, key->d, key->p, key->q, key->dP, key->dQ, key->qInv};
+    return fields[f];
+}
+
+static size_t der_len_size(size_t len) {
+    size_t n = 1;
+    if (len >= 0x80) {
+        for (size_t l = len; l; l >>= 8) n++;
+    }
+    return n;
+}
+
+static uint8_t *der_put_len(uint8_t *out, size_t len) {
+    if (len < 0x80) {
+        *out++ = (uint8_t)len;
+        return out;
+    }
+    int bytes = 0;
+    for (size_t l = len; l; l >>= 8) bytes++;
+    *out++ = (uint8_t)(0x80 | bytes);
+    for (int i = bytes - 1; i >= 0; i--) *out++ = (uint8_t)(len >> (8 * i));
+    return out;
+}
+
+// Content length of a non-negative INTEGER: big-endian magnitude plus a 0x00 if the top bit is set
+static size_t der_int_content(const mpz_t x) {
+    if (mpz_sgn(x) == 0) return 1;
+    size_t bits = mpz_sizeinbase(x, 2);
+    return bits / 8 + 1;
+}
+
+static uint8_t *der_put_int(uint8_t *out, const mpz_t x) {
+    size_t len = der_int_content(x);
+    *out++ = 0x02;
+    out = der_put_len(out, len);
+    memset(out, 0, len);
+    if (mpz_sgn(x) != 0) {
+        size_t count;
+        size_t bytes = (mpz_sizeinbase(x, 2) + 7) / 8;
+        mpz_export(out + (len - bytes), &count, 1, 1, 1, 0, x);
+    }
+    return out + len;
+}
+
+// Read a tag/length header and leave *p at the contents; returns the content length or -1
+static long der_get_tlv(const uint8_t **p, const uint8_t *end, uint8_t tag) {
+    const uint8_t *q = *p;
+    if (end - q < 2 || *q++ != tag) return -1;
+    size_t len = *q++;
+    if (len & 0x80) {
+        int bytes = (int)(len & 0x7f);
+        if (bytes == 0 || bytes > 4 || end - q < bytes || *q == 0) return -1;
+        len = 0;
+        for (int i = 0; i < bytes; i++) len = (len << 8) | *q++;
+        if (len < 0x80) return -1;  // DER wants the short form here
+    }
+    if ((size_t)(end - q) < len) return -1;
+    *p = q;
+    return (long)len;
+}
+
+static int der_get_int(mpz_t x, const uint8_t **p, const uint8_t *end) {
+    long len = der_get_tlv(p, end, 0x02);
+    if (len <= 0) return -1;
+    const uint8_t *c = *p;
+    if (c[0] & 0x80) return -1;                    // negative: never valid in an RSA key
+    if (len > 1 && c[0] == 0 && !(c[1] & 0x80)) return -1; // non-minimal encoding
+    mpz_import(x, (size_t)len, 1, 1, 1, 0, c);
+    *p += len;
+    return 0;
+}
+
+// PKCS#1 RSAPrivateKey (two-prime, version 0). Returns a malloc'd buffer and its length in *len.
+uint8_t *rsa_private_key_to_der(rsa_private_key_t *key, size_t *len) {
+    size_t body = 3; // version INTEGER 0
+    for (int f = 0; f < RSA_KEY_FIELDS; f++) {
+        size_t c = der_int_content(rsa_key_field(key, f));
+        body += 1 + der_len_size(c) + c;
+    }
+    *len = 1 + der_len_size(body) + body;
+    uint8_t *buf = malloc(*len), *out = buf;
+    *out++ = 0x30;
+    out = der_put_len(out, body);
+    *out++ = 0x02;
+    *out++ = 0x01;
+    *out++ = 0x00;
+    for (int f = 0; f < RSA_KEY_FIELDS; f++) out = der_put_int(out, rsa_key_field(key, f));
+    return buf;
+}
+
+// Parse a PKCS#1 RSAPrivateKey into key; returns 0 on success (key initialized), -1 otherwise
+int rsa_private_key_from_der(rsa_private_key_t *key, const uint8_t *der, size_t len) {
+    const uint8_t *p = der, *end = der + len;
+    long body = der_get_tlv(&p, end, 0x30);
+    if (body < 0 || p + body != end) return -1;
+    for (int f = 0; f < RSA_KEY_FIELDS; f++) mpz_init(rsa_key_field(key, f));
+    mpz_t version;
+    mpz_init(version);
+    int ok = der_get_int(version, &p, end) == 0 && mpz_cmp_ui(version, 0) == 0;
+    for (int f = 0; ok && f < RSA_KEY_FIELDS; f++) ok = der_get_int(rsa_key_field(key, f), &p, end) == 0;
+    ok = ok && p == end;
+    if (ok) {
+        mpz_mul(version, key->p, key->q);
+        ok = mpz_cmp(version, key->N) == 0;
+    }
+    mpz_clear(version);
+    if (!ok) rsa_private_key_clear(key);
+    return ok ? 0 : -1;
+}
+
+// PKCS#1 RSAPublicKey
+uint8_t *rsa_public_key_to_der(const mpz_t N, const mpz_t e, size_t *len) {
+    size_t cn = der_int_content(N), ce = der_int_content(e);
+    size_t body = 1 + der_len_size(cn) + cn + 1 + der_len_size(ce) + ce;
+    *len = 1 + der_len_size(body) + body;
+    uint8_t *buf = malloc(*len), *out = buf;
+    *out++ = 0x30;
+    out = der_put_len(out, body);
+    out = der_put_int(out, N);
+    der_put_int(out, e);
+    return buf;
+}
+
+// N and e must be initialized; returns 0 on success, -1 on malformed input
+int rsa_public_key_from_der(mpz_t N, mpz_t e, const uint8_t *der, size_t len) {
+    const uint8_t *p = der, *end = der + len;
+    long body = der_get_tlv(&p, end, 0x30);
+    if (body < 0 || p + body != end) return -1;
+    if (der_get_int(N, &p, end) != 0 || der_get_int(e, &p, end) != 0 || p != end) return -1;
+    return 0;
+}
+
+// Keystore file: header, then an index of count entries, then 64-byte aligned limb data.
+// Each entry gives the key's first limb (counted from data_offset) and the limb count of
+// each field in rsa_key_field order; the fields are stored back to back.
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t limb_bytes;
+    uint64_t count;
+    uint64_t index_offset;
+    uint64_t data_offset;
+    uint64_t data_limbs;
+    uint8_t reserved[16];
+} rsa_keystore_header_t;
+
+typedef struct {
+    uint64_t offset;
+    uint32_t size[RSA_KEY_FIELDS];
+} rsa_keystore_entry_t;
+
+typedef struct {
+    void *map;
+    size_t map_len;
+    uint64_t count;
+    const rsa_keystore_entry_t *index;
+    const mp_limb_t *data;
+} rsa_keystore_t;
+
+#define RSA_KEYSTORE_MAGIC "RSAKS01"
+#define RSA_KEYSTORE_ALIGN_LIMBS 8 // each key starts on a cache line
+
+int rsa_keystore_write(const char *path, rsa_private_key_t *keys, size_t count) {
+    rsa_keystore_entry_t *index = calloc(count ? count : 1, sizeof(rsa_keystore_entry_t));
+    uint64_t limbs = 0;
+    for (size_t i = 0; i < count; i++) {
+        index[i].offset = limbs;
+        for (int f = 0; f < RSA_KEY_FIELDS; f++) {
+            index[i].size[f] = (uint32_t)mpz_size(rsa_key_field(&keys[i], f));
+            limbs += index[i].size[f];
+        }
+        limbs = (limbs + RSA_KEYSTORE_ALIGN_LIMBS - 1) / RSA_KEYSTORE_ALIGN_LIMBS * RSA_KEYSTORE_ALIGN_LIMBS;
+    }
+
+    rsa_keystore_header_t hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, RSA_KEYSTORE_MAGIC, sizeof(hdr.magic));
+    hdr.version = 1;
+    hdr.limb_bytes = sizeof(mp_limb_t);
+    hdr.count = count;
+    hdr.index_offset = sizeof(hdr);
+    hdr.data_offset = (sizeof(hdr) + count * sizeof(rsa_keystore_entry_t) + 63) / 64 * 64;
+    hdr.data_limbs = limbs;
+
+    FILE *fp = fopen(path, "wb");
+    if (!fp) {
+        free(index);
+        return -1;
+    }
+    static const mp_limb_t zeros[RSA_KEYSTORE_ALIGN_LIMBS];
+    size_t pad = hdr.data_offset - sizeof(hdr) - count * sizeof(rsa_keystore_entry_t);
+    int ok = fwrite(&hdr, sizeof(hdr), 1, fp) == 1 && fwrite(index, sizeof(rsa_keystore_entry_t), count, fp) == count &&
+             fwrite(zeros, 1, pad, fp) == pad;
+    uint64_t written = 0;
+    for (size_t i = 0; ok && i < count; i++) {
+        for (int f = 0; ok && f < RSA_KEY_FIELDS; f++) {
+            mpz_ptr x = rsa_key_field(&keys[i], f);
+            ok = fwrite(mpz_limbs_read(x), sizeof(mp_limb_t), index[i].size[f], fp) == index[i].size[f];
+            written += index[i].size[f];
+        }
+        uint64_t next = i + 1 < count ? index[i + 1].offset : limbs;
+        ok = ok && fwrite(zeros, sizeof(mp_limb_t), next - written, fp) == next - written;
+        written = next;
+    }
+    ok &= fclose(fp) == 0;
+    free(index);
+    return ok ? 0 : -1;
+}
+
+// Map a keystore read-only and check that every entry lies inside the data section
+int rsa_keystore_open(rsa_keystore_t *ks, const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -1;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(rsa_keystore_header_t)) {
+        close(fd);
+        return -1;
+    }
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return -1;
+
+    const rsa_keystore_header_t *hdr = map;
+    size_t size = (size_t)st.st_size;
+    int ok = memcmp(hdr->magic, RSA_KEYSTORE_MAGIC, sizeof(hdr->magic)) == 0 && hdr->version == 1 &&
+             hdr->limb_bytes == sizeof(mp_limb_t) && hdr->index_offset == sizeof(*hdr) && hdr->data_offset % 64 == 0 &&
+             hdr->count <= (size - sizeof(*hdr)) / sizeof(rsa_keystore_entry_t) &&
+             hdr->data_offset >= sizeof(*hdr) + hdr->count * sizeof(rsa_keystore_entry_t) && hdr->data_offset <= size &&
+             hdr->data_limbs <= (size - hdr->data_offset) / sizeof(mp_limb_t);
+    const rsa_keystore_entry_t *index = (const rsa_keystore_entry_t *)((const char *)map + hdr->index_offset);
+    for (uint64_t i = 0; ok && i < hdr->count; i++) {
+        uint64_t end = index[i].offset;
+        for (int f = 0; f < RSA_KEY_FIELDS; f++) end += index[i].size[f];
+        ok = index[i].offset <= hdr->data_limbs && end <= hdr->data_limbs;
+    }
+    if (!ok) {
+        munmap(map, size);
+        return -1;
+    }
+    madvise(map, size, MADV_WILLNEED);
+    ks->map = map;
+    ks->map_len = size;
+    ks->count = hdr->count;
+    ks->index = index;
+    ks->data = (const mp_limb_t *)((const char *)map + hdr->data_offset);
+    return 0;
+}
+
+// Fill key with read-only views into the mapping. The views need no clearing and stay valid
+// until rsa_keystore_close; never pass them to rsa_private_key_clear or any mpz write.
+void rsa_keystore_key(const rsa_keystore_t *ks, size_t i, rsa_private_key_t *key) {
+    const rsa_keystore_entry_t *entry = &ks->index[i];
+    const mp_limb_t *limbs = ks->data + entry->offset;
+    for (int f = 0; f < RSA_KEY_FIELDS; f++) {
+        mpz_roinit_n(rsa_key_field(key, f), limbs, (mp_size_t)entry->size[f]);
+        limbs += entry->size[f];
+    }
+}
+
+void rsa_keystore_close(rsa_keystore_t *ks) {
+    munmap(ks->map, ks->map_len);
+}
+
+#define SIEVE_PRIME_LIMIT 17864 // sieve candidates against the odd primes below this (the first 2048 primes)
+
+static unsigned int sieve_primes[2048];
+static int num_sieve_primes = 0;
+static pthread_once_t sieve_primes_once = PTHREAD_ONCE_INIT;
+
+static void init_sieve_primes(void) {
+    static unsigned char composite[SIEVE_PRIME_LIMIT];
+    for (unsigned int i = 3; i < SIEVE_PRIME_LIMIT; i += 2) {
+        if (composite[i]) continue;
+        sieve_primes[num_sieve_primes++] = i;
+        for (unsigned int j = i * i; j < SIEVE_PRIME_LIMIT; j += 2 * i) composite[j] = 1;
+    }
+}
+
+// Generate a bit_size-bit probable prime by incremental search: one random odd start, then the
+// odd numbers start, start + 2, ... are sieved a window at a time against small primes and only
+// the survivors are tested with mpz_probab_prime_p, in order. A fresh random start is drawn
+// only if the search runs past the top of the bit range.
+void generate_prime_incremental(mpz_t p, int bit_size, gmp_randstate_t rand_state, int reps) {
+    pthread_once(&sieve_primes_once, init_sieve_primes);
+    const int window = 2 * bit_size; // odd candidates per window, several expected prime gaps
+    unsigned char *composite = malloc(window);
+    mpz_t candidate;
+    mpz_init(candidate);
+    for (;;) {
+        mpz_urandomb(p, rand_state, bit_size);
+        mpz_setbit(p, bit_size - 1);
+        mpz_setbit(p, 0);
+        while (mpz_sizeinbase(p, 2) == (size_t)bit_size) {
+            // composite[i] marks p + 2i divisible by a sieve prime q: 2i = -p (mod q)
+            memset(composite, 0, window);
+            for (int k = 0; k < num_sieve_primes; k++) {
+                unsigned long q = sieve_primes[k];
+                unsigned long r = mpz_fdiv_ui(p, q);
+                unsigned long i = ((q - r) % q) * ((q + 1) / 2) % q;
+                for (; i < (unsigned long)window; i += q) composite[i] = 1;
+            }
+            for (int i = 0; i < window; i++) {
+                if (composite[i]) continue;
+                mpz_add_ui(candidate, p, 2 * (unsigned long)i);
+                if (mpz_sizeinbase(candidate, 2) != (size_t)bit_size) break;
+                if (mpz_probab_prime_p(candidate, reps)) {
+                    mpz_set(p, candidate);
+                    mpz_clear(candidate);
+                    free(composite);
+                    return;
+                }
+            }
+            mpz_add_ui(p, p, 2 * (unsigned long)window);
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Prime pool: background workers keep a bounded lock-free queue of validated
+// primes per bit size, so keygen only pays for steps 2-3.
+// ---------------------------------------------------------------------------
+
+#define PRIME_POOL_SIZES 5
+static const int prime_pool_bits[PRIME_POOL_SIZES] = {512, 768, 1024, 1536, 2048};
+
+typedef struct {
+    atomic_size_t seq;
+    mpz_t prime;
+} prime_slot_t;
+
+// Bounded multi-producer/multi-consumer queue (per-slot sequence numbers, no locks)
+typedef struct {
+    int bit_size;
+    size_t mask;                 // capacity - 1, capacity is a power of two
+    prime_slot_t *slots;
+    atomic_size_t enqueue_pos;
+    atomic_size_t dequeue_pos;
+    atomic_size_t in_flight;     // primes being generated for this queue right now
+    atomic_ulong hits;
+    atomic_ulong misses;
+    atomic_ulong generated;
+} prime_queue_t;
+
+typedef struct {
+    int num_workers;
+    int capacity;  // primes kept per bit size, rounded up to a power of two
+    int reps;      // mpz_probab_prime_p repetitions
+    int first_cpu; // workers are pinned to cpus first_cpu .. first_cpu + num_cpus - 1; -1 disables pinning
+    int num_cpus;
+} prime_pool_config_t;
+
+typedef struct {
+    prime_queue_t queues[PRIME_POOL_SIZES];
+    prime_pool_config_t config;
+    pthread_t *workers;
+    atomic_int stop;
+    double start_time;
+} prime_pool_t;
+
+typedef struct {
+    int bit_size;
+    size_t depth;
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long generated;
+    double refill_rate; // primes per second since the pool started
+} prime_pool_stats_t;
+
+typedef struct {
+    prime_pool_t *pool;
+    int index;
+} prime_worker_arg_t;
+
+static int prime_queue_push(prime_queue_t *queue, mpz_t p) {
+    size_t pos = atomic_load_explicit(&queue->enqueue_pos, memory_order_relaxed);
+    for (;;) {
+        prime_slot_t *slot = &queue->slots[pos & queue->mask];
+        size_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        long diff = (long)seq - (long)pos;
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&queue->enqueue_pos, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                mpz_swap(slot->prime, p);
+                atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+                return 1;
+            }
+        } else if (diff < 0) {
+            return 0; // full
+        } else {
+            pos = atomic_load_explicit(&queue->enqueue_pos, memory_order_relaxed);
+        }
+    }
+}
+
+static int prime_queue_pop(prime_queue_t *queue, mpz_t p) {
+    size_t pos = atomic_load_explicit(&queue->dequeue_pos, memory_order_relaxed);
+    for (;;) {
+        prime_slot_t *slot = &queue->slots[pos & queue->mask];
+        size_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        long diff = (long)seq - (long)(pos + 1);
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&queue->dequeue_pos, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                mpz_swap(p, slot->prime);
+                atomic_store_explicit(&slot->seq, pos + queue->mask + 1, memory_order_release);
+                return 1;
+            }
+        } else if (diff < 0) {
+            return 0; // empty
+        } else {
+            pos = atomic_load_explicit(&queue->dequeue_pos, memory_order_relaxed);
+        }
+    }
+}
+
+static size_t prime_queue_depth(prime_queue_t *queue) {
+    size_t head = atomic_load_explicit(&queue->dequeue_pos, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&queue->enqueue_pos, memory_order_relaxed);
+    return (tail > head) ? tail - head : 0;
+}
+
+// Only primes with gcd(p - 1, 65537) = 1 enter the pool, so a popped pair always admits e = 65537
+static void generate_pool_prime(mpz_t p, int bit_size, gmp_randstate_t rand_state, int reps) {
+    do {
+        generate_prime_incremental(p, bit_size, rand_state, reps);
+    } while (mpz_fdiv_ui(p, 65537) == 1);
+}
+
+static double wall_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void *prime_pool_worker(void *arg) {
+    prime_worker_arg_t *warg = arg;
+    prime_pool_t *pool = warg->pool;
+    const prime_pool_config_t *cfg = &pool->config;
+
+    // Refill at the lowest priority, on the cpus set aside for it
+    struct sched_param idle = {0};
+    if (pthread_setschedparam(pthread_self(), SCHED_IDLE, &idle) != 0) {
+        setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), 19);
+    }
+    if (cfg->first_cpu >= 0 && cfg->num_cpus > 0) {
+        cpu_set_t cpu_mask;
+        CPU_ZERO(&cpu_mask);
+        CPU_SET(cfg->first_cpu + warg->index % cfg->num_cpus, &cpu_mask);
+        pthread_setaffinity_np(pthread_self(), sizeof(cpu_mask), &cpu_mask);
+    }
+
+    gmp_randstate_t rand_state;
+    gmp_randinit_mt(rand_state);
+    gmp_randseed_ui(rand_state, (unsigned long)time(NULL) ^ ((unsigned long)warg->index << 20) ^ (unsigned long)pthread_self());
+    mpz_t p;
+    mpz_init(p);
+    const struct timespec nap = {0, 1000000};
+    int held = -1; // queue p was generated for; it stays counted in in_flight until the push lands
+
+    while (!atomic_load_explicit(&pool->stop, memory_order_relaxed)) {
+        if (held < 0) {
+            // Refill the emptiest queue (counting primes already being generated for it)
+            int best = -1;
+            double best_fill = 1.0;
+            for (int b = 0; b < PRIME_POOL_SIZES; b++) {
+                prime_queue_t *queue = &pool->queues[b];
+                double fill = (double)(prime_queue_depth(queue) + atomic_load(&queue->in_flight)) / (queue->mask + 1);
+                if (fill < best_fill) {
+                    best_fill = fill;
+                    best = b;
+                }
+            }
+            if (best < 0) {
+                nanosleep(&nap, NULL);
+                continue;
+            }
+            held = best;
+            atomic_fetch_add(&pool->queues[held].in_flight, 1);
+            generate_pool_prime(p, pool->queues[held].bit_size, rand_state, cfg->reps);
+        }
+        prime_queue_t *queue = &pool->queues[held];
+        if (prime_queue_push(queue, p)) {
+            atomic_fetch_add_explicit(&queue->generated, 1, memory_order_relaxed);
+            atomic_fetch_sub(&queue->in_flight, 1);
+            held = -1;
+        } else {
+            // Another worker filled the queue first: keep p and retry once a consumer pops
+            nanosleep(&nap, NULL);
+        }
+    }
+    if (held >= 0) atomic_fetch_sub(&pool->queues[held].in_flight, 1);
+
+    mpz_clear(p);
+    gmp_randclear(rand_state);
+    free(warg);
+    return NULL;
+}
+
+int prime_pool_start(prime_pool_t *pool, const prime_pool_config_t *config) {
+    pool->config = *config;
+    size_t capacity = 1;
+    while (capacity < (size_t)config->capacity) capacity <<= 1;
+    for (int b = 0; b < PRIME_POOL_SIZES; b++) {
+        prime_queue_t *queue = &pool->queues[b];
+        queue->bit_size = prime_pool_bits[b];
+        queue->mask = capacity - 1;
+        queue->slots = malloc(capacity * sizeof(prime_slot_t));
+        for (size_t i = 0; i < capacity; i++) {
+            atomic_init(&queue->slots[i].seq, i);
+            mpz_init2(queue->slots[i].prime, prime_pool_bits[b]);
+        }
+        atomic_init(&queue->enqueue_pos, 0);
+        atomic_init(&queue->dequeue_pos, 0);
+        atomic_init(&queue->in_flight, 0);
+        atomic_init(&queue->hits, 0);
+        atomic_init(&queue->misses, 0);
+        atomic_init(&queue->generated, 0);
+    }
+    atomic_init(&pool->stop, 0);
+    pool->start_time = wall_seconds();
+    pool->workers = malloc(config->num_workers * sizeof(pthread_t));
+    for (int t = 0; t < config->num_workers; t++) {
+        prime_worker_arg_t *warg = malloc(sizeof(prime_worker_arg_t));
+        warg->pool = pool;
+        warg->index = t;
+        if (pthread_create(&pool->workers[t], NULL, prime_pool_worker, warg) != 0) {
+            printf("Error: Could not start prime pool worker %d\n", t);
+            free(warg);
+            pool->config.num_workers = t;
+            break;
+        }
+    }
+    return pool->config.num_workers > 0 ? 0 : -1;
+}
+
+// Workers finish the prime they are generating before exiting
+void prime_pool_stop(prime_pool_t *pool) {
+    atomic_store(&pool->stop, 1);
+    for (int t = 0; t < pool->config.num_workers; t++) {
+        pthread_join(pool->workers[t], NULL);
+    }
+    free(pool->workers);
+    for (int b = 0; b < PRIME_POOL_SIZES; b++) {
+        prime_queue_t *queue = &pool->queues[b];
+        for (size_t i = 0; i <= queue->mask; i++) mpz_clear(queue->slots[i].prime);
+        free(queue->slots);
+    }
+}
+
+static prime_queue_t *prime_pool_queue(prime_pool_t *pool, int bit_size) {
+    for (int b = 0; b < PRIME_POOL_SIZES; b++) {
+        if (pool->queues[b].bit_size == bit_size) return &pool->queues[b];
+    }
+    return NULL;
+}
+
+// Pop a prime; on a miss (or an unpooled bit size) generate one inline with the caller's state
+void prime_pool_take(prime_pool_t *pool, int bit_size, mpz_t p, gmp_randstate_t rand_state) {
+    prime_queue_t *queue = prime_pool_queue(pool, bit_size);
+    if (queue && prime_queue_pop(queue, p)) {
+        atomic_fetch_add_explicit(&queue->hits, 1, memory_order_relaxed);
+        return;
+    }
+    if (queue) atomic_fetch_add_explicit(&queue->misses, 1, memory_order_relaxed);
+    generate_pool_prime(p, bit_size, rand_state, pool->config.reps);
+}
+
+void prime_pool_get_stats(prime_pool_t *pool, int index, prime_pool_stats_t *stats) {
+    prime_queue_t *queue = &pool->queues[index];
+    double elapsed = wall_seconds() - pool->start_time;
+    stats->bit_size = queue->bit_size;
+    stats->depth = prime_queue_depth(queue);
+    stats->hits = atomic_load(&queue->hits);
+    stats->misses = atomic_load(&queue->misses);
+    stats->generated = atomic_load(&queue->generated);
+    stats->refill_rate = elapsed > 0 ? stats->generated / elapsed : 0.0;
+}
+
+// Keygen from pooled primes: pop p and q, then steps 2-3 (N, phi(N), d and the CRT parameters)
+void rsa_keygen_pooled(rsa_private_key_t *key, prime_pool_t *pool, int bit_size, gmp_randstate_t rand_state) {
+    mpz_t p, q, e;
+    mpz_init(p);
+    mpz_init(q);
+    mpz_init_set_ui(e, 65537);
+    prime_pool_take(pool, bit_size, p, rand_state);
+    do {
+        prime_pool_take(pool, bit_size, q, rand_state);
+    } while (mpz_cmp(p, q) == 0);
+    rsa_private_key_init(key, p, q, e); // cannot fail: pooled primes satisfy gcd(p - 1, e) = 1
+    mpz_clear(p);
+    mpz_clear(q);
+    mpz_clear(e);
+}
+
+// Warm a pool, then time keygen per bit size and report the pool counters
+void benchmark_prime_pool(gmp_randstate_t rand_state, int reps, FILE *fp) {
+    int ncpus = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    prime_pool_config_t config = {
+        .num_workers = (ncpus > 2) ? ncpus / 2 : 1,
+        .capacity = 16,
+        .reps = reps,
+        .first_cpu = (ncpus > 2) ? ncpus - ncpus / 2 : -1, // upper half of the cpus; serving threads use the rest
+        .num_cpus = (ncpus > 2) ? ncpus / 2 : 0,
+    };
+    prime_pool_t pool;
+    if (prime_pool_start(&pool, &config) != 0) {
+        printf("Error: Could not start the prime pool\n");
+        return;
+    }
+
+    // Let the pool fill for a while before serving
+    const double warmup_seconds = 20.0;
+    double start = wall_seconds();
+    while (wall_seconds() - start < warmup_seconds) {
+        struct timespec nap = {0, 100000000};
+        nanosleep(&nap, NULL);
+    }
+
+    const int keys_per_size = 4;
+    printf("\nPrime pool: %d worker(s), capacity %d primes per size, %.0f s warm-up\n",
+           config.num_workers, (int)(pool.queues[0].mask + 1), warmup_seconds);
+    fprintf(fp, "\nPrime pool: %d worker(s), capacity %d primes per size, %.0f s warm-up\n",
+            config.num_workers, (int)(pool.queues[0].mask + 1), warmup_seconds);
+    for (int b = 0; b < PRIME_POOL_SIZES; b++) {
+        int bit_size = prime_pool_bits[b];
+        unsigned long long min_cycles = ~0ULL, max_cycles = 0, total_cycles = 0;
+        for (int k = 0; k < keys_per_size; k++) {
+            rsa_private_key_t key;
+            unsigned long long t0 = get_cycles();
+            rsa_keygen_pooled(&key, &pool, bit_size, rand_state);
+            unsigned long long cycles = get_cycles() - t0;
+            if (cycles < min_cycles) min_cycles = cycles;
+            if (cycles > max_cycles) max_cycles = cycles;
+            total_cycles += cycles;
+            rsa_private_key_clear(&key);
+        }
+        prime_pool_stats_t stats;
+        prime_pool_get_stats(&pool, b, &stats);
+        printf("Pooled keygen for %d-bit primes: min %llu, max %llu, avg %.2f clock cycles\n",
+               bit_size, min_cycles, max_cycles, (double)total_cycles / keys_per_size);
+        printf("  depth %zu, hits %lu, misses %lu, generated %lu (%.2f primes/s)\n",
+               stats.depth, stats.hits, stats.misses, stats.generated, stats.refill_rate);
+        fprintf(fp, "Pooled keygen for %d-bit primes: min %llu, max %llu, avg %.2f clock cycles\n",
+                bit_size, min_cycles, max_cycles, (double)total_cycles / keys_per_size);
+        fprintf(fp, "  depth %zu, hits %lu, misses %lu, generated %lu (%.2f primes/s)\n",
+                stats.depth, stats.hits, stats.misses, stats.generated, stats.refill_rate);
+    }
+    prime_pool_stop(&pool);
+}
+
+// ---------------------------------------------------------------------------
+// Public-key operations: a per-key Montgomery context (R = 2^(64 n)) reused
+// across calls, a fixed 16-squarings-plus-one-multiply chain for e = 65537,
+// and a batch API that spreads messages under one key across threads.
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    mp_size_t n;     // limbs in N
+    mp_limb_t *N;
+    mp_limb_t ninv;  // -N^-1 mod 2^64
+    mp_limb_t *r2;   // R^2 mod N
+    mpz_t e;
+    int e_is_f4;     // e == 65537
+} rsa_public_ctx_t;
+
+void rsa_public_ctx_init(rsa_public_ctx_t *ctx, const mpz_t N, const mpz_t e) {
+    mp_size_t n = mpz_size(N);
+    ctx->n = n;
+    ctx->N = malloc(n * sizeof(mp_limb_t));
+    ctx->r2 = malloc(n * sizeof(mp_limb_t));
+    mpn_copyi(ctx->N, mpz_limbs_read(N), n);
+
+    mp_limb_t inv = ctx->N[0]; // N odd: Newton iteration for N^-1 mod 2^64
+    for (int i = 0; i < 6; i++) inv *= 2 - ctx->N[0] * inv;
+    ctx->ninv = -inv;
+
+    mpz_t r2;
+    mpz_init_set_ui(r2, 1);
+    mpz_mul_2exp(r2, r2, 2 * 64 * n);
+    mpz_mod(r2, r2, N);
+    mpn_zero(ctx->r2, n);
+    mpn_copyi(ctx->r2, mpz_limbs_read(r2), mpz_size(r2));
+    mpz_clear(r2);
+
+    mpz_init_set(ctx->e, e);
+    ctx->e_is_f4 = (mpz_cmp_ui(e, 65537) == 0);
+}
+
+void rsa_public_ctx_clear(rsa_public_ctx_t *ctx) {
+    free(ctx->N);
+    free(ctx->r2);
+    mpz_clear(ctx->e);
+}
+
+// r = t / R mod N for a 2n-limb t < N * R (t is clobbered)
+static void mont_redc(mp_limb_t *r, mp_limb_t *t, const rsa_public_ctx_t *ctx) {
+    mp_size_t n = ctx->n;
+    mp_limb_t cy = 0;
+    for (mp_size_t i = 0; i < n; i++) {
+        mp_limb_t m = t[i] * ctx->ninv;
+        mp_limb_t c = mpn_addmul_1(t + i, ctx->N, n, m);
+        mp_limb_t s = t[i + n] + c;
+        mp_limb_t carry = (s < c);
+        s += cy;
+        carry += (s < cy);
+        t[i + n] = s;
+        cy = carry;
+    }
+    if (cy || mpn_cmp(t + n, ctx->N, n) >= 0) {
+        mpn_sub_n(r, t + n, ctx->N, n);
+    } else {
+        mpn_copyi(r, t + n, n);
+    }
+}
+
+// r = a * b / R mod N, scratch holds 2n limbs
+static void mont_mul(mp_limb_t *r, const mp_limb_t *a, const mp_limb_t *b,
+                     const rsa_public_ctx_t *ctx, mp_limb_t *scratch) {
+    if (a == b) {
+        mpn_sqr(scratch, a, ctx->n);
+    } else {
+        mpn_mul_n(scratch, a, b, ctx->n);
+    }
+    mont_redc(r, scratch, ctx);
+}
+
+// out = in^e mod N for 0 <= in < N, using limb buffers acc/base (n limbs) and scratch (2n limbs)
+static void rsa_public_op_limbs(mp_limb_t *out, const mp_limb_t *in, const rsa_public_ctx_t *ctx,
+                                mp_limb_t *acc, mp_limb_t *base, mp_limb_t *scratch) {
+    mp_size_t n = ctx->n;
+    mont_mul(base, in, ctx->r2, ctx, scratch); // base = in * R mod N
+    if (ctx->e_is_f4) {
+        // x^65537 = (x^(2^16)) * x
+        mont_mul(acc, base, base, ctx, scratch);
+        for (int i = 1; i < 16; i++) mont_mul(acc, acc, acc, ctx, scratch);
+        mont_mul(acc, acc, base, ctx, scratch);
+    } else {
+        // Public exponent: plain left-to-right square-and-multiply, timing is not secret
+        mpn_copyi(acc, base, n);
+        for (long bit = (long)mpz_sizeinbase(ctx->e, 2) - 2; bit >= 0; bit--) {
+            mont_mul(acc, acc, acc, ctx, scratch);
+            if (mpz_tstbit(ctx->e, bit)) mont_mul(acc, acc, base, ctx, scratch);
+        }
+    }
+    // Leave the Montgomery domain: out = acc / R mod N
+    mpn_copyi(scratch, acc, n);
+    mpn_zero(scratch + n, n);
+    mont_redc(out, scratch, ctx);
+}
+
+// out = in^e mod N; returns -1 (out untouched) if in is not in [0, N)
+int rsa_public_op(mpz_t out, const mpz_t in, const rsa_public_ctx_t *ctx, mp_limb_t *work) {
+    mp_size_t n = ctx->n;
+    mp_size_t size = mpz_size(in);
+    if (mpz_sgn(in) < 0 || size > n || (size == n && mpn_cmp(mpz_limbs_read(in), ctx->N, n) >= 0)) {
+        return -1;
+    }
+    mp_limb_t *x = work, *acc = work + n, *base = work + 2 * n, *scratch = work + 3 * n;
+    mpn_zero(x, n);
+    if (size) mpn_copyi(x, mpz_limbs_read(in), size);
+    mp_limb_t *rp = mpz_limbs_write(out, n);
+    rsa_public_op_limbs(rp, x, ctx, acc, base, scratch);
+    mpz_limbs_finish(out, n);
+    return 0;
+}
+
+// Limbs of scratch rsa_public_op needs
+static mp_size_t rsa_public_work_limbs(const rsa_public_ctx_t *ctx) {
+    return 5 * ctx->n;
+}
+
+// Encrypt (or raw-verify) count messages under one key, spread across nthreads.
+// Returns the number of inputs rejected for being out of range (their outputs are set to 0).
+size_t rsa_public_batch(const rsa_public_ctx_t *ctx, mpz_t *out, mpz_t *in, size_t count, int nthreads) {
+    size_t rejected = 0;
+    #pragma omp parallel num_threads(nthreads) reduction(+:rejected)
+    {
+        mp_limb_t *work = malloc(rsa_public_work_limbs(ctx) * sizeof(mp_limb_t));
+        #pragma omp for schedule(static)
+        for (size_t i = 0; i < count; i++) {
+            if (rsa_public_op(out[i], in[i], ctx, work) != 0) {
+                mpz_set_ui(out[i], 0);
+                rejected++;
+            }
+        }
+        free(work);
+    }
+    return rejected;
+}
+
+// Raw RSA signature check sig^e mod N == expected for count signatures; ok[i] gets the verdict.
+// Returns the number of valid signatures.
+size_t rsa_verify_batch(const rsa_public_ctx_t *ctx, mpz_t *sigs, mpz_t *expected, size_t count,
+                        unsigned char *ok, int nthreads) {
+    size_t valid = 0;
+    #pragma omp parallel num_threads(nthreads) reduction(+:valid)
+    {
+        mp_limb_t *work = malloc(rsa_public_work_limbs(ctx) * sizeof(mp_limb_t));
+        mpz_t recovered;
+        mpz_init2(recovered, 64 * ctx->n);
+        #pragma omp for schedule(static)
+        for (size_t i = 0; i < count; i++) {
+            ok[i] = (rsa_public_op(recovered, sigs[i], ctx, work) == 0 && mpz_cmp(recovered, expected[i]) == 0);
+            valid += ok[i];
+        }
+        mpz_clear(recovered);
+        free(work);
+    }
+    return valid;
+}
+
+// Encrypt a batch of messages per bit size with mpz_powm_sec (step 4), mpz_powm and the shared context
+void benchmark_public_batch(int bit_size, gmp_randstate_t rand_state, int reps, FILE *fp) {
+    const size_t count = 10000;
+    int nthreads = omp_get_max_threads();
+    mpz_t p, q, e;
+    mpz_init(p);
+    mpz_init(q);
+    mpz_init_set_ui(e, 65537);
+    rsa_private_key_t key;
+    do {
+        generate_prime_incremental(p, bit_size, rand_state, reps);
+        do {
+            generate_prime_incremental(q, bit_size, rand_state, reps);
+        } while (mpz_cmp(p, q) == 0);
+        if (rsa_private_key_init(&key, p, q, e) == 0) break;
+        rsa_private_key_clear(&key);
+    } while (1);
+
+    mpz_t *msgs = malloc(count * sizeof(mpz_t));
+    mpz_t *ref = malloc(count * sizeof(mpz_t));
+    mpz_t *out = malloc(count * sizeof(mpz_t));
+    for (size_t i = 0; i < count; i++) {
+        mpz_init(msgs[i]);
+        mpz_init(ref[i]);
+        mpz_init(out[i]);
+        mpz_urandomm(msgs[i], rand_state, key.N);
+    }
+
+    unsigned long long t0 = get_cycles();
+    for (size_t i = 0; i < count; i++) mpz_powm_sec(ref[i], msgs[i], e, key.N);
+    unsigned long long t1 = get_cycles();
+    for (size_t i = 0; i < count; i++) mpz_powm(out[i], msgs[i], e, key.N);
+    unsigned long long t2 = get_cycles();
+
+    rsa_public_ctx_t ctx;
+    rsa_public_ctx_init(&ctx, key.N, e);
+    unsigned long long t3 = get_cycles();
+    rsa_public_batch(&ctx, out, msgs, count, 1);
+    unsigned long long t4 = get_cycles();
+    size_t mismatches = 0;
+    for (size_t i = 0; i < count; i++) mismatches += (mpz_cmp(out[i], ref[i]) != 0);
+    unsigned long long t5 = get_cycles();
+    rsa_public_batch(&ctx, out, msgs, count, nthreads);
+    unsigned long long t6 = get_cycles();
+
+    // Verification view of the same data: msgs[i] is a valid raw signature on the encoded message ref[i]
+    unsigned char *ok = malloc(count);
+    size_t valid = rsa_verify_batch(&ctx, msgs, ref, count, ok, nthreads);
+
+    printf("\nStep 4: Batch Encryption for %d-bit primes (%zu messages, e = 65537)\n", bit_size, count);
+    printf("mpz_powm_sec clock cycles per message: %.2f\n", (double)(t1 - t0) / count);
+    printf("mpz_powm clock cycles per message: %.2f\n", (double)(t2 - t1) / count);
+    printf("Montgomery context, 1 thread, clock cycles per message: %.2f\n", (double)(t4 - t3) / count);
+    printf("Montgomery context, %d threads, clock cycles per message: %.2f\n", nthreads, (double)(t6 - t5) / count);
+    printf("Verification: %zu mismatches, %zu/%zu signatures verified\n", mismatches, valid, count);
+    fprintf(fp, "\nStep 4: Batch Encryption for %d-bit primes (%zu messages, e = 65537)\n", bit_size, count);
+    fprintf(fp, "mpz_powm_sec clock cycles per message: %.2f\n", (double)(t1 - t0) / count);
+    fprintf(fp, "mpz_powm clock cycles per message: %.2f\n", (double)(t2 - t1) / count);
+    fprintf(fp, "Montgomery context, 1 thread, clock cycles per message: %.2f\n", (double)(t4 - t3) / count);
+    fprintf(fp, "Montgomery context, %d threads, clock cycles per message: %.2f\n", nthreads, (double)(t6 - t5) / count);
+    fprintf(fp, "Verification: %zu mismatches, %zu/%zu signatures verified\n", mismatches, valid, count);
+
+    for (size_t i = 0; i < count; i++) {
+        mpz_clear(msgs[i]);
+        mpz_clear(ref[i]);
+        mpz_clear(out[i]);
+    }
+    free(msgs);
+    free(ref);
+    free(out);
+    free(ok);
+    rsa_public_ctx_clear(&ctx);
+    rsa_private_key_clear(&key);
+    mpz_clear(p);
+    mpz_clear(q);
+    mpz_clear(e);
+}
+
+// ---------------------------------------------------------------------------
+// Multi-key private operations on AVX-512 IFMA: each of the 8 64-bit lanes of a
+// zmm register runs an independent CRT half-exponentiation in radix 2^52, so one
+// batch handles 4 keys (8 halves) per vector with no data-dependent branches.
+// ---------------------------------------------------------------------------
+
+#define IFMA_LANES 8
+#define RADIX52_MASK ((1ULL << 52) - 1)
+#define IFMA_WINDOW 5                      // fixed exponent window, 32-entry table
+#define IFMA_TABLE (1 << IFMA_WINDOW)
+
+typedef struct {
+    const rsa_private_key_t *key;
+    mpz_srcptr c;  // input, 0 <= c < N
+    mpz_ptr m;     // output c^d mod N, initialized by the caller
+} rsa_private_job_t;
+
+// One CRT half: out = in^exp mod mod
+typedef struct {
+    mpz_srcptr mod;
+    mpz_srcptr exp;
+    mpz_srcptr in;
+    mpz_ptr out;
+    int limbs;     // radix-2^52 limbs with 2^(52 limbs) > 4 mod
+} ifma_half_t;
+
+static void mpz_to_radix52(uint64_t *out, int limbs, const mpz_t x) {
+    for (int j = 0; j < limbs; j++) {
+        size_t bit = 52 * (size_t)j;
+        size_t w = bit / 64, s = bit % 64;
+        uint64_t v = mpz_getlimbn(x, w) >> s;
+        if (s > 12) v |= mpz_getlimbn(x, w + 1) << (64 - s);
+        out[j] = v & RADIX52_MASK;
+    }
+}
+
+static void radix52_to_mpz(mpz_t x, const uint64_t *in, int limbs, int stride) {
+    mp_size_t n = (52 * limbs + 63) / 64;
+    mp_limb_t *rp = mpz_limbs_write(x, n);
+    mpn_zero(rp, n);
+    for (int j = 0; j < limbs; j++) {
+        uint64_t v = in[(size_t)j * stride];
+        size_t bit = 52 * (size_t)j;
+        size_t w = bit / 64, s = bit % 64;
+        rp[w] |= v << s;
+        if (s > 12 && w + 1 < (size_t)n) rp[w + 1] |= v >> (64 - s);
+    }
+    while (n > 0 && rp[n - 1] == 0) n--;
+    mpz_limbs_finish(x, n);
+}
+
+// Almost Montgomery multiplication r = a * b / 2^(52 L) mod m, per lane. Inputs below 2m with
+// normalized 52-bit limbs give an output below 2m with normalized limbs, as long as 2^(52 L) > 4m.
+// Column accumulators take at most 4 L partial products of 52 bits, so they cannot overflow 64 bits.
+__attribute__((target("avx512f,avx512ifma")))
+static void amm52x8(__m512i *r, const __m512i *a, const __m512i *b, const __m512i *m, __m512i k0,
+                    int L, __m512i *acc) {
+    const __m512i zero = _mm512_setzero_si512();
+    for (int j = 0; j <= L; j++) acc[j] = zero;
+    for (int i = 0; i < L; i++) {
+        __m512i bi = b[i];
+        for (int j = 0; j < L; j++) {
+            acc[j] = _mm512_madd52lo_epu64(acc[j], a[j], bi);
+            acc[j + 1] = _mm512_madd52hi_epu64(acc[j + 1], a[j], bi);
+        }
+        __m512i y = _mm512_madd52lo_epu64(zero, acc[0], k0);
+        for (int j = 0; j < L; j++) {
+            acc[j] = _mm512_madd52lo_epu64(acc[j], m[j], y);
+            acc[j + 1] = _mm512_madd52hi_epu64(acc[j + 1], m[j], y);
+        }
+        // The low limb is now 0 mod 2^52: carry it up and shift the accumulator down one limb
+        __m512i carry = _mm512_srli_epi64(acc[0], 52);
+        for (int j = 0; j < L; j++) acc[j] = acc[j + 1];
+        acc[0] = _mm512_add_epi64(acc[0], carry);
+        acc[L] = zero;
+    }
+    const __m512i mask = _mm512_set1_epi64(RADIX52_MASK);
+    __m512i carry = zero;
+    for (int j = 0; j < L; j++) {
+        __m512i t = _mm512_add_epi64(acc[j], carry);
+        carry = _mm512_srli_epi64(t, 52);
+        r[j] = _mm512_and_si512(t, mask);
+    }
+}
+
+// out = base^exp per lane with a fixed 5-bit window. digits[w * 8 + lane] is window w (most significant
+// first) of the lane's exponent, padded to the same count for every lane. Table lookups read every entry
+// and keep the wanted one with a mask, so the access pattern does not depend on the exponent.
+__attribute__((target("avx512f,avx512ifma")))
+static void modexp52x8(__m512i *out, const __m512i *base, const __m512i *one, const __m512i *m, __m512i k0,
+                       int L, const uint64_t *digits, int nwin, __m512i *table, __m512i *acc, __m512i *tmp) {
+    for (int j = 0; j < L; j++) {
+        table[j] = one[j];
+        table[L + j] = base[j];
+    }
+    for (int t = 2; t < IFMA_TABLE; t++) {
+        amm52x8(table + (size_t)t * L, table + (size_t)(t - 1) * L, base, m, k0, L, acc);
+    }
+
+    for (int w = 0; w < nwin; w++) {
+        if (w > 0) {
+            for (int s = 0; s < IFMA_WINDOW; s++) amm52x8(out, out, out, m, k0, L, acc);
+        }
+        __m512i idx = _mm512_loadu_si512((const void *)(digits + (size_t)w * IFMA_LANES));
+        for (int j = 0; j < L; j++) tmp[j] = table[j];
+        for (int t = 1; t < IFMA_TABLE; t++) {
+            __mmask8 hit = _mm512_cmpeq_epi64_mask(idx, _mm512_set1_epi64(t));
+            for (int j = 0; j < L; j++) tmp[j] = _mm512_mask_mov_epi64(tmp[j], hit, table[(size_t)t * L + j]);
+        }
+        if (w == 0) {
+            for (int j = 0; j < L; j++) out[j] = tmp[j];
+        } else {
+            amm52x8(out, out, tmp, m, k0, L, acc);
+        }
+    }
+
+    // Leave the Montgomery domain (multiply by 1) and reduce the result below m without branching
+    for (int j = 0; j < L; j++) tmp[j] = _mm512_setzero_si512();
+    tmp[0] = _mm512_set1_epi64(1);
+    amm52x8(out, out, tmp, m, k0, L, acc);
+    const __m512i mask = _mm512_set1_epi64(RADIX52_MASK);
+    __m512i borrow = _mm512_setzero_si512();
+    for (int j = 0; j < L; j++) {
+        __m512i d = _mm512_sub_epi64(_mm512_sub_epi64(out[j], m[j]), borrow);
+        borrow = _mm512_srli_epi64(d, 63);
+        tmp[j] = _mm512_and_si512(d, mask);
+    }
+    __mmask8 no_borrow = _mm512_cmpeq_epi64_mask(borrow, _mm512_setzero_si512());
+    for (int j = 0; j < L; j++) out[j] = _mm512_mask_mov_epi64(out[j], no_borrow, tmp[j]);
+}
+
+// Run up to 8 halves with the same limb count; unused lanes repeat lane 0
+__attribute__((target("avx512f,avx512ifma")))
+static void ifma_run_group(ifma_half_t **halves, int count) {
+    int L = halves[0]->limbs;
+    size_t nbits = 0;
+    for (int k = 0; k < count; k++) {
+        size_t bits = mpz_sizeinbase(halves[k]->mod, 2);
+        if (bits > nbits) nbits = bits;
+    }
+    int nwin = (int)((nbits + IFMA_WINDOW - 1) / IFMA_WINDOW);
+
+    size_t vecs = (size_t)L * (6 + IFMA_TABLE) + 1; // m, base, one, out, table, acc (L + 1), tmp
+    __m512i *mem = aligned_alloc(64, vecs * sizeof(__m512i));
+    __m512i *m = mem, *base = m + L, *one = base + L, *out = one + L;
+    __m512i *table = out + L, *acc = table + (size_t)L * IFMA_TABLE;
+    __m512i *tmp = acc + (L + 1);
+    uint64_t *lanes = malloc((size_t)L * (IFMA_LANES * 3 + 1) * sizeof(uint64_t));
+    uint64_t *lm = lanes, *lbase = lanes + (size_t)L * IFMA_LANES, *lone = lanes + (size_t)2 * L * IFMA_LANES;
+    uint64_t *limbs52 = lanes + (size_t)3 * L * IFMA_LANES;   // one lane's L limbs before transposing
+    uint64_t *digits = malloc((size_t)nwin * IFMA_LANES * sizeof(uint64_t));
+    uint64_t k0[IFMA_LANES];
+
+    mpz_t r, t;
+    mpz_init(r);
+    mpz_init(t);
+    for (int k = 0; k < IFMA_LANES; k++) {
+        const ifma_half_t *h = halves[k < count ? k : 0];
+        uint64_t m0 = mpz_getlimbn(h->mod, 0), inv = m0;
+        for (int i = 0; i < 6; i++) inv *= 2 - m0 * inv;
+        k0[k] = (0 - inv) & RADIX52_MASK;
+
+        mpz_set_ui(r, 1);
+        mpz_mul_2exp(r, r, 52 * (mp_bitcnt_t)L);
+        mpz_mod(r, r, h->mod);                      // R mod m
+        mpz_mod(t, h->in, h->mod);
+        mpz_mul_2exp(t, t, 52 * (mp_bitcnt_t)L);
+        mpz_mod(t, t, h->mod);                      // in * R mod m
+        mpz_to_radix52(limbs52, L, h->mod);
+        for (int j = 0; j < L; j++) lm[j * IFMA_LANES + k] = limbs52[j];
+        mpz_to_radix52(limbs52, L, t);
+        for (int j = 0; j < L; j++) lbase[j * IFMA_LANES + k] = limbs52[j];
+        mpz_to_radix52(limbs52, L, r);
+        for (int j = 0; j < L; j++) lone[j * IFMA_LANES + k] = limbs52[j];
+        for (int w = 0; w < nwin; w++) {
+            uint64_t digit = 0;
+            for (int b = 0; b < IFMA_WINDOW; b++) {
+                mp_bitcnt_t bit = (mp_bitcnt_t)(nwin - 1 - w) * IFMA_WINDOW + (IFMA_WINDOW - 1 - b);
+                digit = (digit << 1) | (uint64_t)mpz_tstbit(h->exp, bit);
+            }
+            digits[(size_t)w * IFMA_LANES + k] = digit;
+        }
+    }
+    for (int j = 0; j < L; j++) {
+        m[j] = _mm512_loadu_si512((const void *)(lm + (size_t)j * IFMA_LANES));
+        base[j] = _mm512_loadu_si512((const void *)(lbase + (size_t)j * IFMA_LANES));
+        one[j] = _mm512_loadu_si512((const void *)(lone + (size_t)j * IFMA_LANES));
+    }
+
+    modexp52x8(out, base, one, m, _mm512_loadu_si512((const void *)k0), L, digits, nwin, table, acc, tmp);
+
+    for (int j = 0; j < L; j++) _mm512_storeu_si512((void *)(lm + (size_t)j * IFMA_LANES), out[j]);
+    for (int k = 0; k < count; k++) radix52_to_mpz(halves[k]->out, lm + k, L, IFMA_LANES);
+
+    mpz_clear(r);
+    mpz_clear(t);
+    free(digits);
+    free(lanes);
+    free(mem);
+}
+
+static int cmp_half_limbs(const void *a, const void *b) {
+    const ifma_half_t *x = *(ifma_half_t *const *)a, *y = *(ifma_half_t *const *)b;
+    return x->limbs - y->limbs;
+}
+
+// Private-key operations for many (key, ciphertext) pairs, possibly under different keys.
+// With AVX-512 IFMA the CRT halves run 8 to a vector (grouped by size, groups spread over
+// OpenMP threads); otherwise each job goes through rsa_private_crt.
+void rsa_private_batch(rsa_private_job_t *jobs, size_t count) {
+    if (!__builtin_cpu_supports("avx512ifma")) {
+        #pragma omp parallel for schedule(dynamic)
+        for (size_t i = 0; i < count; i++) rsa_private_crt(jobs[i].m, jobs[i].c, jobs[i].key, 0);
+        return;
+    }
+
+    ifma_half_t *halves = malloc(2 * count * sizeof(ifma_half_t));
+    ifma_half_t **order = malloc(2 * count * sizeof(ifma_half_t *));
+    mpz_t *partial = malloc(2 * count * sizeof(mpz_t));
+    for (size_t i = 0; i < count; i++) {
+        const rsa_private_key_t *key = jobs[i].key;
+        mpz_init(partial[2 * i]);
+        mpz_init(partial[2 * i + 1]);
+        halves[2 * i] = (ifma_half_t){key->p, key->dP, jobs[i].c, partial[2 * i],
+                                      (int)((mpz_sizeinbase(key->p, 2) + 2 + 51) / 52)};
+        halves[2 * i + 1] = (ifma_half_t){key->q, key->dQ, jobs[i].c, partial[2 * i + 1],
+                                          (int)((mpz_sizeinbase(key->q, 2) + 2 + 51) / 52)};
+    }
+    for (size_t i = 0; i < 2 * count; i++) order[i] = &halves[i];
+    qsort(order, 2 * count, sizeof(ifma_half_t *), cmp_half_limbs);
+
+    // Cut the sorted halves into groups of at most 8 with equal limb counts
+    size_t *group_start = malloc((2 * count + 1) * sizeof(size_t));
+    size_t num_groups = 0;
+    for (size_t i = 0; i < 2 * count;) {
+        size_t j = i;
+        while (j < 2 * count && j - i < IFMA_LANES && order[j]->limbs == order[i]->limbs) j++;
+        group_start[num_groups++] = i;
+        i = j;
+    }
+    group_start[num_groups] = 2 * count;
+
+    #pragma omp parallel for schedule(dynamic)
+    for (size_t g = 0; g < num_groups; g++) {
+        ifma_run_group(order + group_start[g], (int)(group_start[g + 1] - group_start[g]));
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        rsa_crt_combine(jobs[i].m, partial[2 * i], partial[2 * i + 1], jobs[i].key);
+        mpz_clear(partial[2 * i]);
+        mpz_clear(partial[2 * i + 1]);
+    }
+    free(group_start);
+    free(partial);
+    free(order);
+    free(halves);
+}
+
+// Private operations spread over several keys: one rsa_private_crt per job versus rsa_private_batch
+void benchmark_private_batch(int bit_size, gmp_randstate_t rand_state, int reps, FILE *fp) {
+    const int num_keys = 8;
+    const size_t count = 512;
+    mpz_t p, q, e;
+    mpz_init(p);
+    mpz_init(q);
+    mpz_init_set_ui(e, 65537);
+    rsa_private_key_t *keys = malloc(num_keys * sizeof(rsa_private_key_t));
+    for (int k = 0; k < num_keys; k++) {
+        for (;;) {
+            generate_prime_incremental(p, bit_size, rand_state, reps);
+            do {
+                generate_prime_incremental(q, bit_size, rand_state, reps);
+            } while (mpz_cmp(p, q) == 0);
+            if (rsa_private_key_init(&keys[k], p, q, e) == 0) break;
+            rsa_private_key_clear(&keys[k]);
+        }
+    }
+
+    mpz_t *c = malloc(count * sizeof(mpz_t));
+    mpz_t *ref = malloc(count * sizeof(mpz_t));
+    mpz_t *out = malloc(count * sizeof(mpz_t));
+    rsa_private_job_t *jobs = malloc(count * sizeof(rsa_private_job_t));
+    for (size_t i = 0; i < count; i++) {
+        const rsa_private_key_t *key = &keys[i % num_keys];
+        mpz_init(c[i]);
+        mpz_init(ref[i]);
+        mpz_init(out[i]);
+        mpz_urandomm(c[i], rand_state, key->N);
+        jobs[i] = (rsa_private_job_t){key, c[i], out[i]};
+    }
+
+    unsigned long long t0 = get_cycles();
+    for (size_t i = 0; i < count; i++) rsa_private_crt(ref[i], c[i], jobs[i].key, 0);
+    unsigned long long t1 = get_cycles();
+    rsa_private_batch(jobs, count);
+    unsigned long long t2 = get_cycles();
+    size_t mismatches = 0;
+    for (size_t i = 0; i < count; i++) mismatches += (mpz_cmp(out[i], ref[i]) != 0);
+
+    const char *engine = __builtin_cpu_supports("avx512ifma") ? "AVX-512 IFMA, 8 lanes" : "scalar fallback";
+    printf("\nStep 4: Multi-key Batch Decryption for %d-bit primes (%zu ops over %d keys, %s)\n",
+           bit_size, count, num_keys, engine);
+    printf("CRT mpz_powm_sec clock cycles per op: %.2f\n", (double)(t1 - t0) / count);
+    printf("Batch clock cycles per op: %.2f (%.2fx)\n", (double)(t2 - t1) / count, (double)(t1 - t0) / (t2 - t1));
+    printf("Verification: %zu mismatches\n", mismatches);
+    fprintf(fp, "\nStep 4: Multi-key Batch Decryption for %d-bit primes (%zu ops over %d keys, %s)\n",
+            bit_size, count, num_keys, engine);
+    fprintf(fp, "CRT mpz_powm_sec clock cycles per op: %.2f\n", (double)(t1 - t0) / count);
+    fprintf(fp, "Batch clock cycles per op: %.2f (%.2fx)\n", (double)(t2 - t1) / count, (double)(t1 - t0) / (t2 - t1));
+    fprintf(fp, "Verification: %zu mismatches\n", mismatches);
+
+    for (size_t i = 0; i < count; i++) {
+        mpz_clear(c[i]);
+        mpz_clear(ref[i]);
+        mpz_clear(out[i]);
+    }
+    for (int k = 0; k < num_keys; k++) rsa_private_key_clear(&keys[k]);
+    free(c);
+    free(ref);
+    free(out);
+    free(jobs);
+    free(keys);
+    mpz_clear(p);
+    mpz_clear(q);
+    mpz_clear(e);
+}
+
+// Keystore startup cost for num_keys keys (a few distinct keys repeated) against parsing the same
+// number of DER blobs, plus DER round-trip and keystore-view decryption checks
+void benchmark_keystore(int bit_size, gmp_randstate_t rand_state, int reps, FILE *fp) {
+    const int distinct = 16;
+    const size_t num_keys = 100000;
+    const char *path = "results/keystore.bin";
+    mpz_t p, q, e;
+    mpz_init(p);
+    mpz_init(q);
+    mpz_init_set_ui(e, 65537);
+    rsa_private_key_t base[16];
+    for (int k = 0; k < distinct; k++) {
+        for (;;) {
+            generate_prime_incremental(p, bit_size, rand_state, reps);
+            do {
+                generate_prime_incremental(q, bit_size, rand_state, reps);
+            } while (mpz_cmp(p, q) == 0);
+            if (rsa_private_key_init(&base[k], p, q, e) == 0) break;
+            rsa_private_key_clear(&base[k]);
+        }
+    }
+
+    // DER round trip, and the cost of parsing num_keys blobs at startup
+    uint8_t *der[16];
+    size_t der_len[16];
+    int der_ok = 1;
+    for (int k = 0; k < distinct; k++) der[k] = rsa_private_key_to_der(&base[k], &der_len[k]);
+    double t0 = wall_seconds();
+    for (size_t i = 0; i < num_keys; i++) {
+        rsa_private_key_t key;
+        if (rsa_private_key_from_der(&key, der[i % distinct], der_len[i % distinct]) != 0) {
+            der_ok = 0;
+            continue;
+        }
+        if (i < (size_t)distinct) {
+            for (int f = 0; f < RSA_KEY_FIELDS; f++) {
+                der_ok &= mpz_cmp(rsa_key_field(&key, f), rsa_key_field(&base[i], f)) == 0;
+            }
+        }
+        rsa_private_key_clear(&key);
+    }
+    double der_ms = 1e3 * (wall_seconds() - t0);
+
+    // Shallow copies share the base keys' limbs; they are only read by rsa_keystore_write
+    rsa_private_key_t *keys = malloc(num_keys * sizeof(rsa_private_key_t));
+    for (size_t i = 0; i < num_keys; i++) keys[i] = base[i % distinct];
+    t0 = wall_seconds();
+    int write_ok = rsa_keystore_write(path, keys, num_keys) == 0;
+    double write_ms = 1e3 * (wall_seconds() - t0);
+    free(keys);
+
+    rsa_keystore_t ks;
+    t0 = wall_seconds();
+    int open_ok = write_ok && rsa_keystore_open(&ks, path) == 0;
+    double t1 = wall_seconds();
+    double open_ms = 1e3 * (t1 - t0), view_ms = 0;
+    int view_ok = open_ok && ks.count == num_keys;
+    if (open_ok) {
+        size_t limbs_touched = 0;
+        for (size_t i = 0; i < ks.count; i++) {
+            rsa_private_key_t view;
+            rsa_keystore_key(&ks, i, &view);
+            limbs_touched += mpz_limbs_read(view.N)[0] & 1;
+        }
+        view_ms = 1e3 * (wall_seconds() - t1);
+        view_ok &= limbs_touched == ks.count; // N is odd for every key
+
+        // A view must behave exactly like the key it was written from
+        mpz_t c, m1, m2;
+        mpz_init(c);
+        mpz_init(m1);
+        mpz_init(m2);
+        for (size_t i = num_keys - distinct; i < num_keys; i++) {
+            rsa_private_key_t view;
+            rsa_keystore_key(&ks, i, &view);
+            mpz_urandomm(c, rand_state, view.N);
+            rsa_private_crt(m1, c, &view, 0);
+            rsa_private_crt(m2, c, &base[i % distinct], 0);
+            view_ok &= mpz_cmp(m1, m2) == 0;
+        }
+        mpz_clear(c);
+        mpz_clear(m1);
+        mpz_clear(m2);
+        rsa_keystore_close(&ks);
+    }
+    unlink(path);
+
+    printf("\nKeystore: %zu keys of %d bits (%zu-byte DER each)\n", num_keys, 2 * bit_size, der_len[0]);
+    printf("DER parse of all keys: %.2f ms (round trip %s)\n", der_ms, der_ok ? "successful" : "failed");
+    printf("Keystore write: %.2f ms, mmap open and validate: %.3f ms, views for all keys: %.3f ms\n", write_ms,
+           open_ms, view_ms);
+    printf("Verification: keystore views %s\n", view_ok ? "successful" : "failed");
+    fprintf(fp, "\nKeystore: %zu keys of %d bits (%zu-byte DER each)\n", num_keys, 2 * bit_size, der_len[0]);
+    fprintf(fp, "DER parse of all keys: %.2f ms (round trip %s)\n", der_ms, der_ok ? "successful" : "failed");
+    fprintf(fp, "Keystore write: %.2f ms, mmap open and validate: %.3f ms, views for all keys: %.3f ms\n", write_ms,
+            open_ms, view_ms);
+    fprintf(fp, "Verification: keystore views %s\n", view_ok ? "successful" : "failed");
+
+    for (int k = 0; k < distinct; k++) {
+        free(der[k]);
+        rsa_private_key_clear(&base[k]);
+    }
+    mpz_clear(p);
+    mpz_clear(q);
+    mpz_clear(e);
+}
+
+#define PRIME_GEN_CHUNK 250           // iterations per work-stealing task
+#define PRIME_GEN_CHECKPOINT_SECS 30.0 // interval between histogram checkpoints
+#define PRIME_GEN_HIST_FILE "results/prime_gen_hist.bin"
+
+typedef struct {
+    int num_bit_sizes;
+    const int *bit_sizes;
+    int reps;
+    int chunks_per_size;
+    int total_iterations;
+    gmp_randstate_t *rand_states;       // one per pool worker
+    latency_hist_t *hists;              // [worker * num_bit_sizes + b], written only by that worker
+    int nthreads;
+    atomic_int *count;                  // per bit size, updated as each chunk finishes
+    pthread_mutex_t checkpoint_lock;
+    double start;
+    _Atomic double next_checkpoint;
+} prime_gen_job_t;
+
+// Task for chunks [lo, hi): split off the upper half until one chunk is left, then run it.
+// Chunk i belongs to bit size i % num_bit_sizes, so all sizes are interleaved in one task tree.
+typedef struct {
+    ws_task_t task;
+    int lo, hi;
+    prime_gen_job_t *job;
+} prime_gen_task_t;
+
+// Merge every worker's histogram for bit size index b
+static void prime_gen_merge(prime_gen_job_t *job, int b, latency_hist_t *out) {
+    lh_init(out);
+    for (int w = 0; w < job->nthreads; w++) lh_merge(out, &job->hists[w * job->num_bit_sizes + b]);
+}
+
+// Snapshot all bit sizes into PRIME_GEN_HIST_FILE (written to a temporary file, then renamed)
+static void prime_gen_checkpoint(prime_gen_job_t *job) {
+    const char *tmp_name = PRIME_GEN_HIST_FILE ".tmp";
+    FILE *fp = fopen(tmp_name, "wb");
+    if (!fp) {
+        printf("Error: Could not write to %s\n", tmp_name);
+        return;
+    }
+    latency_hist_t *merged = aligned_alloc(64, sizeof(latency_hist_t));
+    int ok = 1;
+    for (int b = 0; b < job->num_bit_sizes; b++) {
+        prime_gen_merge(job, b, merged);
+        ok &= lh_write(fp, merged, job->bit_sizes[b], wall_seconds() - job->start) == 0;
+    }
+    free(merged);
+    ok &= fclose(fp) == 0;
+    if (ok) rename(tmp_name, PRIME_GEN_HIST_FILE);
+}
+
+static void prime_gen_chunk(prime_gen_job_t *job, int chunk) {
+    int b = chunk % job->num_bit_sizes;
+    int bit_size = job->bit_sizes[b];
+    int first = (chunk / job->num_bit_sizes) * PRIME_GEN_CHUNK;
+    int last = first + PRIME_GEN_CHUNK < job->total_iterations ? first + PRIME_GEN_CHUNK : job->total_iterations;
+    int worker = ws_worker_index();
+    latency_hist_t *hist = &job->hists[worker * job->num_bit_sizes + b];
+
+    mpz_t p, q;
+    mpz_init(p);
+    mpz_init(q);
+    for (int j = first; j < last; j++) {
+        unsigned long long start = get_cycles();
+
+        // Generate primes p and q
+        generate_prime_incremental(p, bit_size, job->rand_states[worker], job->reps);
+        generate_prime_incremental(q, bit_size, job->rand_states[worker], job->reps);
+
+        lh_record(hist, get_cycles() - start);
+    }
+    mpz_clear(p);
+    mpz_clear(q);
+
+    int done = atomic_fetch_add(&job->count[b], last - first) + (last - first);
+    if (done % 100000 == 0 || done == job->total_iterations) {
+        printf("Completed %d/%d iterations for %d-bit primes\n", done, job->total_iterations, bit_size);
+    }
+
+    // Whichever worker finishes a chunk after the deadline writes the checkpoint; the others skip it
+    if (wall_seconds() >= job->next_checkpoint && pthread_mutex_trylock(&job->checkpoint_lock) == 0) {
+        if (wall_seconds() >= job->next_checkpoint) {
+            prime_gen_checkpoint(job);
+            job->next_checkpoint = wall_seconds() + PRIME_GEN_CHECKPOINT_SECS;
+        }
+        pthread_mutex_unlock(&job->checkpoint_lock);
+    }
+}
+
+static void prime_gen_task(ws_task_t *task) {
+    prime_gen_task_t *t = (prime_gen_task_t *)task;
+    prime_gen_task_t *all = t - t->lo; // tasks live in one array indexed by their first chunk
+    int lo = t->lo, hi = t->hi;
+    while (hi - lo > 1) {
+        int mid = lo + (hi - lo) / 2;
+        all[mid].lo = mid;
+        all[mid].hi = hi;
+        ws_spawn(task->group, &all[mid].task);
+        hi = mid;
+    }
+    prime_gen_chunk(t->job, lo);
+}
+
+// Function to benchmark prime generation for all bit sizes on a work-stealing pool
 void benchmark_prime_gen(gmp_randstate_t rand_state, int total_iterations, int reps) {
     // Create results folder
     struct stat st = {0};
@@ -23,108 +1674,90 @@ void benchmark_prime_gen(gmp_randstate_t rand_state, int total_iterations, int r
     int bit_sizes[] = {512, 768, 1024};
     int num_bit_sizes = 3;
 
-    unsigned long long min_cycles[3] = {~0ULL, ~0ULL, ~0ULL};
-    unsigned long long max_cycles[3] = {0, 0, 0};
-    unsigned long long total_cycles[3] = {0, 0, 0};
-    int count[3] = {0, 0, 0};
-
-    const int batch_size = 1000;
-    const int num_batches = total_iterations / batch_size;
-
-    printf("Benchmarking prime generation in batches of %d iterations across bit sizes (%d batches)...\n", batch_size, num_batches);
-
-    for (int batch = 1; batch <= num_batches; batch++) {
-        for (int b = 0; b < num_bit_sizes; b++) {
-            int bit_size = bit_sizes[b];
-
-            unsigned long long batch_min = ~0ULL;
-            unsigned long long batch_max = 0;
-            unsigned long long batch_total = 0;
-
-            #pragma omp parallel num_threads(2) reduction(min:batch_min) reduction(max:batch_max) reduction(+:batch_total)
-            {
-                gmp_randstate_t local_rand_state;
-                gmp_randinit_mt(local_rand_state);
-                unsigned int thread_seed = (unsigned long)time(NULL) ^ omp_get_thread_num();
-                gmp_randseed_ui(local_rand_state, thread_seed);
-
-                mpz_t p, q;
-                mpz_init(p);
-                mpz_init(q);
-
-                #pragma omp for schedule(dynamic)
-                for (int j = 0; j < batch_size; j++) {
-                    unsigned long long start = get_cycles();
-
-                    // Generate prime p
-                    int is_prime_p = 0;
-                    while (!is_prime_p) {
-                        mpz_urandomb(p, local_rand_state, bit_size);
-                        mpz_setbit(p, bit_size - 1);
-                        if (mpz_even_p(p)) {
-                            mpz_add_ui(p, p, 1);
-                        }
-                        is_prime_p = mpz_probab_prime_p(p, reps);
-                    }
-
-                    // Generate prime q
-                    int is_prime_q = 0;
-                    while (!is_prime_q) {
-                        mpz_urandomb(q, local_rand_state, bit_size);
-                        mpz_setbit(q, bit_size - 1);
-                        if (mpz_even_p(q)) {
-                            mpz_add_ui(q, q, 1);
-                        }
-                        is_prime_q = mpz_probab_prime_p(q, reps);
-                    }
-
-                    unsigned long long end = get_cycles();
-                    unsigned long long cycles = end - start;
-
-                    if (cycles < batch_min) batch_min = cycles;
-                    if (cycles > batch_max) batch_max = cycles;
-                    batch_total += cycles;
-                }
+    ws_pool_t pool;
+    ws_pool_init(&pool, 0);
 
-                mpz_clear(p);
-                mpz_clear(q);
-                gmp_randclear(local_rand_state);
-            }
+    atomic_int count[3];
+    for (int b = 0; b < num_bit_sizes; b++) atomic_init(&count[b], 0);
+    latency_hist_t *hists = aligned_alloc(64, (size_t)pool.nthreads * num_bit_sizes * sizeof(latency_hist_t));
+    for (int i = 0; i < pool.nthreads * num_bit_sizes; i++) lh_init(&hists[i]);
+    gmp_randstate_t *rand_states = malloc(pool.nthreads * sizeof(gmp_randstate_t));
+    for (int i = 0; i < pool.nthreads; i++) {
+        gmp_randinit_mt(rand_states[i]);
+        gmp_randseed_ui(rand_states[i], gmp_urandomb_ui(rand_state, 32) ^ (unsigned long)i);
+    }
 
-            // Update global stats
-            count[b] += batch_size;
-            total_cycles[b] += batch_total;
-            if (batch_min < min_cycles[b]) min_cycles[b] = batch_min;
-            if (batch_max > max_cycles[b]) max_cycles[b] = batch_max;
-
-            // Save partial results
-            char filename[100];
-            snprintf(filename, sizeof(filename), "results/result_%d_run_%d.txt", bit_size, count[b]);
-            FILE *fp = fopen(filename, "w");
-            if (fp) {
-                double avg = (double)total_cycles[b] / count[b];
-                fprintf(fp, "Partial results up to %d iterations for %d-bit primes:\n", count[b], bit_size);
-                fprintf(fp, "Minimum clock cycles: %llu\n", min_cycles[b]);
-                fprintf(fp, "Maximum clock cycles: %llu\n", max_cycles[b]);
-                fprintf(fp, "Average clock cycles: %.2f\n", avg);
-                fclose(fp);
-            } else {
-                printf("Error: Could not write to %s\n", filename);
-            }
+    prime_gen_job_t job = {.num_bit_sizes = num_bit_sizes, .bit_sizes = bit_sizes, .reps = reps,
+                           .chunks_per_size = (total_iterations + PRIME_GEN_CHUNK - 1) / PRIME_GEN_CHUNK,
+                           .total_iterations = total_iterations, .rand_states = rand_states, .hists = hists,
+                           .nthreads = pool.nthreads, .count = count};
+    pthread_mutex_init(&job.checkpoint_lock, NULL);
+    job.start = wall_seconds();
+    job.next_checkpoint = job.start + PRIME_GEN_CHECKPOINT_SECS;
+    int num_chunks = job.chunks_per_size * num_bit_sizes;
+    prime_gen_task_t *tasks = malloc((size_t)num_chunks * sizeof(prime_gen_task_t));
+    for (int i = 0; i < num_chunks; i++) tasks[i] = (prime_gen_task_t){{prime_gen_task, NULL}, i, i + 1, &job};
 
-            printf("Completed batch %d/%d for %d-bit primes (%d iterations)\n", batch, num_batches, bit_size, count[b]);
-        }
-    }
+    printf("Benchmarking prime generation: %d iterations per bit size in %d tasks on %d threads (work stealing)...\n",
+           total_iterations, num_chunks, pool.nthreads);
 
-    // Final print for Step 1
+    ws_group_t group;
+    ws_group_init(&group);
+    tasks[0].hi = num_chunks;
+    ws_spawn(&group, &tasks[0].task);
+    ws_wait(&group);
+    double elapsed = wall_seconds() - job.start;
+
+    ws_worker_stats_t totals;
+    double utilization;
+    ws_pool_stop(&pool);
+    ws_pool_totals(&pool, &totals, &utilization);
+    ws_pool_destroy(&pool);
+    prime_gen_checkpoint(&job);
+
+    // Final print for Step 1, one summary file per bit size
+    latency_hist_t *merged = aligned_alloc(64, sizeof(latency_hist_t));
     for (int b = 0; b < num_bit_sizes; b++) {
         int bit_size = bit_sizes[b];
-        double final_avg = (double)total_cycles[b] / count[b];
+        prime_gen_merge(&job, b, merged);
+        unsigned long long min = atomic_load(&merged->min), max = atomic_load(&merged->max);
+        unsigned long long p50 = lh_percentile(merged, 50.0), p90 = lh_percentile(merged, 90.0);
+        unsigned long long p99 = lh_percentile(merged, 99.0), p999 = lh_percentile(merged, 99.9);
+        double avg = lh_mean(merged);
         printf("\nStep 1: Prime Generation for %d-bit primes (final)\n", bit_size);
-        printf("Minimum clock cycles: %llu\n", min_cycles[b]);
-        printf("Maximum clock cycles: %llu\n", max_cycles[b]);
-        printf("Average clock cycles: %.2f\n", final_avg);
+        printf("Minimum clock cycles: %llu\n", min);
+        printf("Maximum clock cycles: %llu\n", max);
+        printf("Average clock cycles: %.2f\n", avg);
+        printf("P50/P90/P99/P99.9 clock cycles: %llu / %llu / %llu / %llu\n", p50, p90, p99, p999);
+
+        char filename[100];
+        snprintf(filename, sizeof(filename), "results/result_%d_run_%d.txt", bit_size, total_iterations);
+        FILE *fp = fopen(filename, "w");
+        if (fp) {
+            fprintf(fp, "Results for %d iterations for %d-bit primes:\n", total_iterations, bit_size);
+            fprintf(fp, "Minimum clock cycles: %llu\n", min);
+            fprintf(fp, "Maximum clock cycles: %llu\n", max);
+            fprintf(fp, "Average clock cycles: %.2f\n", avg);
+            fprintf(fp, "P50 clock cycles: %llu\n", p50);
+            fprintf(fp, "P90 clock cycles: %llu\n", p90);
+            fprintf(fp, "P99 clock cycles: %llu\n", p99);
+            fprintf(fp, "P99.9 clock cycles: %llu\n", p999);
+            fclose(fp);
+        } else {
+            printf("Error: Could not write to %s\n", filename);
+        }
     }
+    printf("Histograms: %s (read with ./hist_reader)\n", PRIME_GEN_HIST_FILE);
+    printf("\nScheduler: %d threads, %.2f s wall, utilization %.1f%%, %llu tasks, %llu steals (%llu attempts)\n",
+           pool.nthreads, elapsed, 100.0 * utilization, (unsigned long long)totals.tasks,
+           (unsigned long long)totals.steals, (unsigned long long)totals.steal_attempts);
+
+    free(merged);
+    pthread_mutex_destroy(&job.checkpoint_lock);
+    for (int i = 0; i < pool.nthreads; i++) gmp_randclear(rand_states[i]);
+    free(rand_states);
+    free(hists);
+    free(tasks);
 }
 
 // Function to perform RSA operations for a given bit size
@@ -133,28 +1766,10 @@ void rsa_operations(int bit_size, gmp_randstate_t rand_state, int reps, FILE *fp
     mpz_init(p);
     mpz_init(q);
 
-    int is_prime_p = 0;
-    while (!is_prime_p) {
-        mpz_urandomb(p, rand_state, bit_size);
-        mpz_setbit(p, bit_size - 1);
-        if (mpz_even_p(p)) {
-            mpz_add_ui(p, p, 1);
-        }
-        is_prime_p = mpz_probab_prime_p(p, reps);
-    }
-
-    int is_prime_q = 0;
-    while (!is_prime_q) {
-        mpz_urandomb(q, rand_state, bit_size);
-        mpz_setbit(q, bit_size - 1);
-        if (mpz_even_p(q)) {
-            mpz_add_ui(q, q, 1);
-        }
-        is_prime_q = mpz_probab_prime_p(q, reps);
-        if (is_prime_q && mpz_cmp(p, q) == 0) {
-            is_prime_q = 0;
-        }
-    }
+    generate_prime_incremental(p, bit_size, rand_state, reps);
+    do {
+        generate_prime_incremental(q, bit_size, rand_state, reps);
+    } while (mpz_cmp(p, q) == 0);
 
     unsigned long long start_step2 = get_cycles();
     mpz_t N, phi;
@@ -242,6 +1857,91 @@ void rsa_operations(int bit_size, gmp_randstate_t rand_state, int reps, FILE *fp
         fprintf(fp, "Verification: Decryption failed for %d-bit primes\n", bit_size);
     }
 
+    // CRT decryption against the full-modulus decryption above, averaged over dec_runs calls
+    rsa_private_key_t key;
+    rsa_private_key_init(&key, p, q, e);
+    const int dec_runs = 1000;
+    mpz_t m_crt;
+    mpz_init(m_crt);
+    unsigned long long total_full = 0, total_crt = 0, total_crt2 = 0;
+    int crt_ok = 1;
+    for (int r = 0; r < dec_runs; r++) {
+        unsigned long long t0 = get_cycles();
+        mpz_powm_sec(m_dec, c, d, N);
+        unsigned long long t1 = get_cycles();
+        rsa_private_crt(m_crt, c, &key, 0);
+        unsigned long long t2 = get_cycles();
+        crt_ok &= (mpz_cmp(m_crt, m) == 0);
+        rsa_private_crt(m_crt, c, &key, 1);
+        unsigned long long t3 = get_cycles();
+        crt_ok &= (mpz_cmp(m_crt, m) == 0);
+        total_full += t1 - t0;
+        total_crt += t2 - t1;
+        total_crt2 += t3 - t2;
+    }
+
+    printf("\nStep 4: CRT Decryption for %d-bit primes (average of %d runs)\n", bit_size, dec_runs);
+    printf("Full-modulus clock cycles: %.2f\n", (double)total_full / dec_runs);
+    printf("CRT clock cycles: %.2f (%.2fx)\n", (double)total_crt / dec_runs, (double)total_full / total_crt);
+    printf("CRT, two threads clock cycles: %.2f (%.2fx)\n", (double)total_crt2 / dec_runs, (double)total_full / total_crt2);
+    printf("Verification: CRT decryption %s for %d-bit primes\n", crt_ok ? "successful" : "failed", bit_size);
+    fprintf(fp, "\nStep 4: CRT Decryption for %d-bit primes (average of %d runs)\n", bit_size, dec_runs);
+    fprintf(fp, "Full-modulus clock cycles: %.2f\n", (double)total_full / dec_runs);
+    fprintf(fp, "CRT clock cycles: %.2f (%.2fx)\n", (double)total_crt / dec_runs, (double)total_full / total_crt);
+    fprintf(fp, "CRT, two threads clock cycles: %.2f (%.2fx)\n", (double)total_crt2 / dec_runs, (double)total_full / total_crt2);
+    fprintf(fp, "Verification: CRT decryption %s for %d-bit primes\n", crt_ok ? "successful" : "failed", bit_size);
+
+    // Blinded CRT decryption against the unblinded CRT path, then all threads sharing one blinding state
+    rsa_blinding_t blind_msg, blind_full;
+    rsa_blinding_init(&blind_msg, &key, omp_get_max_threads(), 0, (unsigned long)time(NULL));
+    rsa_blinding_init(&blind_full, &key, omp_get_max_threads(), 1, (unsigned long)time(NULL) + 1);
+    unsigned long long total_plain = 0, total_msg = 0, total_full_blind = 0;
+    int blind_ok = 1;
+    for (int r = 0; r < dec_runs; r++) {
+        unsigned long long t0 = get_cycles();
+        rsa_private_crt(m_crt, c, &key, 0);
+        unsigned long long t1 = get_cycles();
+        rsa_private_blinded(m_crt, c, &blind_msg);
+        unsigned long long t2 = get_cycles();
+        blind_ok &= (mpz_cmp(m_crt, m) == 0);
+        rsa_private_blinded(m_crt, c, &blind_full);
+        unsigned long long t3 = get_cycles();
+        blind_ok &= (mpz_cmp(m_crt, m) == 0);
+        total_plain += t1 - t0;
+        total_msg += t2 - t1;
+        total_full_blind += t3 - t2;
+    }
+    int shared_ok = 1;
+    #pragma omp parallel for reduction(&& : shared_ok)
+    for (int r = 0; r < dec_runs; r++) {
+        mpz_t mt;
+        mpz_init(mt);
+        rsa_private_blinded(mt, c, &blind_full);
+        shared_ok = shared_ok && (mpz_cmp(mt, m) == 0);
+        mpz_clear(mt);
+    }
+    rsa_blinding_clear(&blind_msg);
+    rsa_blinding_clear(&blind_full);
+
+    printf("\nStep 4: Blinded CRT Decryption for %d-bit primes (average of %d runs)\n", bit_size, dec_runs);
+    printf("Unblinded CRT clock cycles: %.2f\n", (double)total_plain / dec_runs);
+    printf("Message blinding clock cycles: %.2f (%+.1f%%)\n", (double)total_msg / dec_runs,
+           100.0 * ((double)total_msg / total_plain - 1.0));
+    printf("Message and exponent blinding clock cycles: %.2f (%+.1f%%)\n", (double)total_full_blind / dec_runs,
+           100.0 * ((double)total_full_blind / total_plain - 1.0));
+    printf("Verification: blinded decryption %s (%d threads sharing one key: %s)\n",
+           blind_ok ? "successful" : "failed", omp_get_max_threads(), shared_ok ? "successful" : "failed");
+    fprintf(fp, "\nStep 4: Blinded CRT Decryption for %d-bit primes (average of %d runs)\n", bit_size, dec_runs);
+    fprintf(fp, "Unblinded CRT clock cycles: %.2f\n", (double)total_plain / dec_runs);
+    fprintf(fp, "Message blinding clock cycles: %.2f (%+.1f%%)\n", (double)total_msg / dec_runs,
+            100.0 * ((double)total_msg / total_plain - 1.0));
+    fprintf(fp, "Message and exponent blinding clock cycles: %.2f (%+.1f%%)\n", (double)total_full_blind / dec_runs,
+            100.0 * ((double)total_full_blind / total_plain - 1.0));
+    fprintf(fp, "Verification: blinded decryption %s (%d threads sharing one key: %s)\n",
+            blind_ok ? "successful" : "failed", omp_get_max_threads(), shared_ok ? "successful" : "failed");
+    mpz_clear(m_crt);
+    rsa_private_key_clear(&key);
+
     mpz_clear(p);
     mpz_clear(q);
     mpz_clear(N);
@@ -255,7 +1955,126 @@ void rsa_operations(int bit_size, gmp_randstate_t rand_state, int reps, FILE *fp
     mpz_clear(m_dec);
 }
 
-int main() {
+// ---------------------------------------------------------------------------
+// bench.h cases for the timed kernels: size is the prime size in bits, so the
+// modulus has twice as many. Every case works on one key built in setup.
+// ---------------------------------------------------------------------------
+
+typedef enum {
+    RSA_BENCH_PRIME,        // generate_prime_incremental
+    RSA_BENCH_ENC_POWM,     // c = m^e mod N with mpz_powm_sec, as rsa_operations times it
+    RSA_BENCH_ENC_MONT,     // rsa_public_op on the Montgomery context
+    RSA_BENCH_DEC_POWM,     // m = c^d mod N with mpz_powm_sec
+    RSA_BENCH_DEC_CRT,      // rsa_private_crt
+    RSA_BENCH_DEC_BLINDED,  // rsa_private_blinded with message and exponent blinding
+} rsa_bench_kind_t;
+
+typedef struct {
+    rsa_bench_kind_t kind;
+    int bit_size;
+    gmp_randstate_t rand_state;
+    rsa_private_key_t key;
+    rsa_public_ctx_t pub;
+    rsa_blinding_t blind;
+    mp_limb_t *work;
+    mpz_t m, c, out;
+} rsa_bench_t;
+
+static const rsa_bench_kind_t rsa_bench_kinds[] = {RSA_BENCH_PRIME, RSA_BENCH_ENC_POWM, RSA_BENCH_ENC_MONT,
+                                                   RSA_BENCH_DEC_POWM, RSA_BENCH_DEC_CRT, RSA_BENCH_DEC_BLINDED};
+
+static void *rsa_bench_setup(const bench_params_t *params, const void *arg) {
+    rsa_bench_t *b = malloc(sizeof(rsa_bench_t));
+    b->kind = *(const rsa_bench_kind_t *)arg;
+    b->bit_size = (int)params->size;
+    gmp_randinit_mt(b->rand_state);
+    gmp_randseed_ui(b->rand_state, 12345);
+    mpz_init(b->m);
+    mpz_init(b->c);
+    mpz_init(b->out);
+
+    mpz_t p, q, e;
+    mpz_init(p);
+    mpz_init(q);
+    mpz_init_set_ui(e, 65537);
+    for (;;) {
+        generate_prime_incremental(p, b->bit_size, b->rand_state, 5);
+        do {
+            generate_prime_incremental(q, b->bit_size, b->rand_state, 5);
+        } while (mpz_cmp(p, q) == 0);
+        if (rsa_private_key_init(&b->key, p, q, e) == 0) break;
+        rsa_private_key_clear(&b->key);
+    }
+    rsa_public_ctx_init(&b->pub, b->key.N, b->key.e);
+    b->work = malloc(rsa_public_work_limbs(&b->pub) * sizeof(mp_limb_t));
+    rsa_blinding_init(&b->blind, &b->key, 1, 1, 54321);
+    mpz_clear(p);
+    mpz_clear(q);
+    mpz_clear(e);
+    return b;
+}
+
+// Fresh message and its ciphertext for every run
+static void rsa_bench_prepare(void *ctx) {
+    rsa_bench_t *b = ctx;
+    mpz_urandomm(b->m, b->rand_state, b->key.N);
+    mpz_powm(b->c, b->m, b->key.e, b->key.N);
+}
+
+static void rsa_bench_run(void *ctx) {
+    rsa_bench_t *b = ctx;
+    switch (b->kind) {
+    case RSA_BENCH_PRIME: generate_prime_incremental(b->out, b->bit_size, b->rand_state, 5); break;
+    case RSA_BENCH_ENC_POWM: mpz_powm_sec(b->out, b->m, b->key.e, b->key.N); break;
+    case RSA_BENCH_ENC_MONT: rsa_public_op(b->out, b->m, &b->pub, b->work); break;
+    case RSA_BENCH_DEC_POWM: mpz_powm_sec(b->out, b->c, b->key.d, b->key.N); break;
+    case RSA_BENCH_DEC_CRT: rsa_private_crt(b->out, b->c, &b->key, 0); break;
+    case RSA_BENCH_DEC_BLINDED: rsa_private_blinded(b->out, b->c, &b->blind); break;
+    }
+}
+
+static void rsa_bench_teardown(void *ctx) {
+    rsa_bench_t *b = ctx;
+    // The last run's output has to match the message (encryptions are checked against c)
+    int ok = 1;
+    if (b->kind == RSA_BENCH_ENC_POWM || b->kind == RSA_BENCH_ENC_MONT) ok = mpz_cmp(b->out, b->c) == 0;
+    else if (b->kind != RSA_BENCH_PRIME) ok = mpz_cmp(b->out, b->m) == 0;
+    if (!ok) fprintf(stderr, "rsa: wrong result for %d-bit primes (kind %d)\n", b->bit_size, (int)b->kind);
+    free(b->work);
+    rsa_blinding_clear(&b->blind);
+    rsa_public_ctx_clear(&b->pub);
+    rsa_private_key_clear(&b->key);
+    mpz_clear(b->m);
+    mpz_clear(b->c);
+    mpz_clear(b->out);
+    gmp_randclear(b->rand_state);
+    free(b);
+}
+
+#define RSA_BENCH_CASE(n, be, k)                                                                             \
+    {.name = n, .backend = be, .setup = rsa_bench_setup, .prepare = rsa_bench_prepare, .run = rsa_bench_run, \
+     .teardown = rsa_bench_teardown, .bytes_per_run = SIZE_MAX, .arg = &rsa_bench_kinds[k]}
+
+static const bench_case_t rsa_cases[] = {
+    RSA_BENCH_CASE("prime_gen", "incremental", RSA_BENCH_PRIME),
+    RSA_BENCH_CASE("encrypt", "mpz_powm_sec", RSA_BENCH_ENC_POWM),
+    RSA_BENCH_CASE("encrypt", "mont_f4", RSA_BENCH_ENC_MONT),
+    RSA_BENCH_CASE("decrypt", "mpz_powm_sec", RSA_BENCH_DEC_POWM),
+    RSA_BENCH_CASE("decrypt", "crt", RSA_BENCH_DEC_CRT),
+    RSA_BENCH_CASE("decrypt", "crt_blinded", RSA_BENCH_DEC_BLINDED),
+};
+
+// Usage: ./rsa                        every step, writes results/rsa_results.txt
+//        ./rsa bench [bench.h flags]  prime generation, encryption and decryption as bench.h cases
+int main(int argc, char **argv) {
+    if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+        bench_config_t cfg;
+        bench_config_init(&cfg, 200, 5);
+        size_t sizes[] = {512, 768, 1024};
+        for (int i = 0; i < 3; i++) cfg.sizes[cfg.num_sizes++] = sizes[i];
+        return bench_main(rsa_cases, sizeof(rsa_cases) / sizeof(rsa_cases[0]), &cfg, argc - 2, argv + 2);
+    }
+
     gmp_randstate_t rand_state;
     gmp_randinit_mt(rand_state);
     gmp_randseed_ui(rand_state, (unsigned long)time(NULL));
@@ -263,9 +2082,6 @@ int main() {
     const int reps = 5;
     const int iterations = 1000000;
 
-    // Set OpenMP to use 2 threads
-    omp_set_num_threads(2);
-
     // Create results folder
     struct stat st = {0};
     if (stat("results", &st) == -1) {
@@ -289,8 +2105,16 @@ int main() {
         fprintf(fp_results, "\n=== Processing %d-bit primes ===\n", bit_size);
         printf("\n=== Processing %d-bit primes ===\n", bit_size);
         rsa_operations(bit_size, rand_state, reps, fp_results);
+        benchmark_public_batch(bit_size, rand_state, reps, fp_results);
+        benchmark_private_batch(bit_size, rand_state, reps, fp_results);
     }
 
+    // Startup cost of loading a large keystore
+    benchmark_keystore(1024, rand_state, reps, fp_results);
+
+    // On-demand keygen from the background prime pool
+    benchmark_prime_pool(rand_state, reps, fp_results);
+
     fclose(fp_results);
     gmp_randclear(rand_state);
     return 0;
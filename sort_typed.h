@@ -0,0 +1,363 @@
+// Type-generic sorting without function pointers. SORT_DEFINE() stamps out a family of sorts for
+// one element type with the comparison written as a macro, so it is inlined into the loops
+// instead of being called through qsort's comparator pointer for every comparison.
+//
+//   #define REC_LESS(a, b) ((a)->key < (b)->key)     // strict weak order on const T *
+//   SORT_DEFINE(sort_rec, rec_t, REC_LESS)
+//
+//   #define REC_KEY(r) ((r)->key)                    // or project a key compared with <
+//   SORT_DEFINE_KEY(sort_rec, rec_t, REC_KEY)
+//
+// either of which defines
+//
+//   void sort_rec_sort(rec_t *a, size_t n)                     introsort, not stable
+//   int  sort_rec_stable_sort(rec_t *a, size_t n)              merge sort with one n-element buffer
+//   int  sort_rec_sort_index(const rec_t *a, size_t n, size_t *idx)
+//                                                              stable order of a as indices, a untouched
+//   int  sort_rec_sort_indirect(rec_t *a, size_t n)            stable; sorts indices, then moves
+//                                                              every record exactly once
+//   void sort_rec_nth_element(rec_t *a, size_t n, size_t k)    Floyd-Rivest selection of rank k
+//   void sort_rec_partial_sort(rec_t *a, size_t n, size_t k)   the k smallest, sorted, in a[0..k-1]
+//   sort_rec_topk_t with _topk_init(t, buf, k), _topk_push(t, &x), _topk_push_many(t, xs, n) and
+//   _topk_finish(t)                                            the k smallest of a stream, in buf
+//
+// The int-returning sorts allocate and return -1 (leaving a unchanged) if that fails. Elements
+// are moved by assignment, so any struct works; pointer element types need a typedef (see
+// sort_str_t) because T is pasted in front of * and const. The indirect sort moves each record
+// once instead of log n times, but its comparisons chase indices into the records; it is meant
+// for records of several cache lines or sorts that must not disturb a until the order is known.
+// Instantiations for the usual scalar types and C strings follow at the end.
+#ifndef SORT_TYPED_H
+#define SORT_TYPED_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SORT_INSERTION_CUTOFF 16   // introsort ranges this small are insertion sorted
+#define SORT_NINTHER_THRESHOLD 128 // above this the pivot is a median of three medians
+#define SORT_STABLE_RUN 16         // merge sort starts from insertion-sorted runs of this length
+#define SORT_SELECT_SAMPLE_MIN 600 // Floyd-Rivest narrows ranges longer than this through a sample
+#define SORT_PARTIAL_HEAP_RATIO 16 // partial_sort uses a heap for k up to n / this, else selection
+#define SORT_TOPK_BLOCK 16         // elements per top-k threshold test (bits of one mask)
+
+static inline int sort_log2(size_t n) {
+    return 63 - __builtin_clzll((unsigned long long)n);
+}
+
+// Comparison adapters: CMP(ARG, ctx, a, b) with a and b pointers to elements. The direct sorts
+// ignore ctx; the index sorts compare the records ctx[*a] and ctx[*b].
+#define SORT_CMP_LESS(LESS, ctx, a, b) LESS(a, b)
+#define SORT_CMP_LESS_INDEXED(LESS, ctx, a, b) LESS(&(ctx)[*(a)], &(ctx)[*(b)])
+#define SORT_CMP_KEY(KEY, ctx, a, b) (KEY(a) < KEY(b))
+#define SORT_CMP_KEY_INDEXED(KEY, ctx, a, b) (KEY(&(ctx)[*(a)]) < KEY(&(ctx)[*(b)]))
+
+// The algorithms for element type T with a context of type CTX_T
+#define SORT_DEFINE_CORE(name, T, CTX_T, CMP, ARG)                                                         \
+    static inline void name##_swap(T *x, T *y) {                                                           \
+        T t = *x;                                                                                          \
+        *x = *y;                                                                                           \
+        *y = t;                                                                                            \
+    }                                                                                                      \
+                                                                                                           \
+    static inline void name##_insertion_sort(T *a, size_t n, CTX_T ctx) {                                  \
+        (void)ctx;                                                                                         \
+        for (size_t i = 1; i < n; i++) {                                                                   \
+            if (!CMP(ARG, ctx, &a[i], &a[i - 1])) continue;                                                \
+            T x = a[i];                                                                                    \
+            size_t j = i;                                                                                  \
+            do {                                                                                           \
+                a[j] = a[j - 1];                                                                           \
+                j--;                                                                                       \
+            } while (j > 0 && CMP(ARG, ctx, &x, &a[j - 1]));                                               \
+            a[j] = x;                                                                                      \
+        }                                                                                                  \
+    }                                                                                                      \
+                                                                                                           \
+    static inline void name##_sift_down(T *a, size_t n, size_t i, CTX_T ctx) {                             \
+        (void)ctx;                                                                                         \
+        T x = a[i];                                                                                        \
+        size_t c;                                                                                          \
+        while ((c = 2 * i + 1) < n) {                                                                      \
+            if (c + 1 < n && CMP(ARG, ctx, &a[c], &a[c + 1])) c++;                                         \
+            if (!CMP(ARG, ctx, &x, &a[c])) break;                                                          \
+            a[i] = a[c];                                                                                   \
+            i = c;                                                                                         \
+        }                                                                                                  \
+        a[i] = x;                                                                                          \
+    }                                                                                                      \
+                                                                                                           \
+    static inline void name##_heap_sort(T *a, size_t n, CTX_T ctx) {                                       \
+        for (size_t i = n / 2; i-- > 0;) name##_sift_down(a, n, i, ctx);                                   \
+        for (size_t end = n - 1; end > 0; end--) {                                                         \
+            name##_swap(&a[0], &a[end]);                                                                   \
+            name##_sift_down(a, end, 0, ctx);                                                              \
+        }                                                                                                  \
+    }                                                                                                      \
+                                                                                                           \
+    static inline T *name##_median3(T *x, T *y, T *z, CTX_T ctx) {                                         \
+        (void)ctx;                                                                                         \
+        if (CMP(ARG, ctx, x, y)) {                                                                         \
+            if (CMP(ARG, ctx, y, z)) return y;                                                             \
+            return CMP(ARG, ctx, x, z) ? z : x;                                                            \
+        }                                                                                                  \
+        if (CMP(ARG, ctx, x, z)) return x;                                                                 \
+        return CMP(ARG, ctx, y, z) ? z : y;                                                                \
+    }                                                                                                      \
+                                                                                                           \
+    /* Hoare partition around a median-of-three (or ninther) pivot parked in a[0]; recurse on the          \
+       smaller side, heapsort once depth runs out */                                                       \
+    static inline void name##_intro_loop(T *a, size_t n, int depth, CTX_T ctx) {                           \
+        while (n > SORT_INSERTION_CUTOFF) {                                                                \
+            if (depth-- == 0) {                                                                            \
+                name##_heap_sort(a, n, ctx);                                                               \
+                return;                                                                                    \
+            }                                                                                              \
+            size_t mid = n / 2;                                                                            \
+            T *m;                                                                                          \
+            if (n > SORT_NINTHER_THRESHOLD) {                                                              \
+                size_t s = n / 8;                                                                          \
+                m = name##_median3(name##_median3(a, a + s, a + 2 * s, ctx),                               \
+                                   name##_median3(a + mid - s, a + mid, a + mid + s, ctx),                 \
+                                   name##_median3(a + n - 1 - 2 * s, a + n - 1 - s, a + n - 1, ctx), ctx); \
+            } else {                                                                                       \
+                m = name##_median3(a, a + mid, a + n - 1, ctx);                                            \
+            }                                                                                              \
+            name##_swap(a, m);                                                                             \
+            size_t i = 0, j = n;                                                                           \
+            while (1) {                                                                                    \
+                do i++;                                                                                    \
+                while (i < n && CMP(ARG, ctx, &a[i], &a[0]));                                              \
+                do j--;                                                                                    \
+                while (CMP(ARG, ctx, &a[0], &a[j]));                                                       \
+                if (i >= j) break;                                                                         \
+                name##_swap(&a[i], &a[j]);                                                                 \
+            }                                                                                              \
+            name##_swap(&a[0], &a[j]);                                                                     \
+            if (j < n - j - 1) {                                                                           \
+                name##_intro_loop(a, j, depth, ctx);                                                       \
+                a += j + 1;                                                                                \
+                n -= j + 1;                                                                                \
+            } else {                                                                                       \
+                name##_intro_loop(a + j + 1, n - j - 1, depth, ctx);                                       \
+                n = j;                                                                                     \
+            }                                                                                              \
+        }                                                                                                  \
+        name##_insertion_sort(a, n, ctx);                                                                  \
+    }                                                                                                      \
+                                                                                                           \
+    /* Bottom-up merge sort, alternating between a and one scratch buffer */                               \
+    static inline int name##_stable_sort_ctx(T *a, size_t n, CTX_T ctx) {                                  \
+        if (n <= SORT_STABLE_RUN) {                                                                        \
+            name##_insertion_sort(a, n, ctx);                                                              \
+            return 0;                                                                                      \
+        }                                                                                                  \
+        T *tmp = malloc(n * sizeof(T));                                                                    \
+        if (!tmp) return -1;                                                                               \
+        for (size_t i = 0; i < n; i += SORT_STABLE_RUN) {                                                  \
+            name##_insertion_sort(a + i, n - i < SORT_STABLE_RUN ? n - i : SORT_STABLE_RUN, ctx);          \
+        }                                                                                                  \
+        T *src = a;                                                                                        \
+        T *dst = tmp;                                                                                      \
+        for (size_t w = SORT_STABLE_RUN; w < n; w *= 2) {                                                  \
+            for (size_t lo = 0; lo < n; lo += 2 * w) {                                                     \
+                size_t mid = lo + w < n ? lo + w : n, hi = lo + 2 * w < n ? lo + 2 * w : n;                \
+                size_t i = lo, j = mid, k = lo;                                                            \
+                while (i < mid && j < hi) dst[k++] = CMP(ARG, ctx, &src[j], &src[i]) ? src[j++] : src[i++]; \
+                while (i < mid) dst[k++] = src[i++];                                                       \
+                while (j < hi) dst[k++] = src[j++];                                                        \
+            }                                                                                              \
+            T *t = src;                                                                                    \
+            src = dst;                                                                                     \
+            dst = t;                                                                                       \
+        }                                                                                                  \
+        if (src != a) memcpy(a, src, n * sizeof(T));                                                       \
+        free(tmp);                                                                                         \
+        return 0;                                                                                          \
+    }
+
+#define SORT_DEFINE_SELECT(name, T, CMP, ARG)                                                              \
+    /* Floyd-Rivest selection on a[left..right]: on large ranges, first select within a sample             \
+       window around k so the partition that follows is nearly exact and leaves little to do.              \
+       Falls back to heapsorting the range once depth partitions have not closed in on k. */               \
+    static inline void name##_select_loop(T *a, size_t left, size_t right, size_t k, int depth) {          \
+        while (right > left) {                                                                             \
+            if (depth-- == 0) {                                                                            \
+                name##_heap_sort(a + left, right - left + 1, NULL);                                        \
+                return;                                                                                    \
+            }                                                                                              \
+            if (right - left > SORT_SELECT_SAMPLE_MIN) {                                                   \
+                double n = (double)(right - left + 1), i = (double)(k - left + 1);                         \
+                double z = log(n), s = 0.5 * exp(2.0 * z / 3.0);                                           \
+                double sd = 0.5 * sqrt(z * s * (n - s) / n) * (i < n / 2 ? -1.0 : 1.0);                    \
+                double lo = (double)k - i * s / n + sd, hi = (double)k + (n - i) * s / n + sd;             \
+                size_t new_left = lo > (double)left ? (size_t)lo : left;                                   \
+                size_t new_right = hi < (double)right ? (size_t)hi : right;                                \
+                name##_select_loop(a, new_left, new_right, k, depth);                                      \
+            }                                                                                              \
+            /* Partition around t = a[k], with t parked at a[left] or a[right] as a sentinel */            \
+            T t = a[k];                                                                                    \
+            size_t i = left, j = right;                                                                    \
+            name##_swap(&a[left], &a[k]);                                                                  \
+            if (CMP(ARG, NULL, &t, &a[right])) name##_swap(&a[right], &a[left]);                           \
+            while (i < j) {                                                                                \
+                name##_swap(&a[i], &a[j]);                                                                 \
+                i++;                                                                                       \
+                j--;                                                                                       \
+                while (CMP(ARG, NULL, &a[i], &t)) i++;                                                     \
+                while (CMP(ARG, NULL, &t, &a[j])) j--;                                                     \
+            }                                                                                              \
+            if (!CMP(ARG, NULL, &a[left], &t) && !CMP(ARG, NULL, &t, &a[left])) {                          \
+                name##_swap(&a[left], &a[j]);                                                              \
+            } else {                                                                                       \
+                j++;                                                                                       \
+                name##_swap(&a[j], &a[right]);                                                             \
+            }                                                                                              \
+            if (j <= k) left = j + 1;                                                                      \
+            if (k <= j) {                                                                                  \
+                if (j == 0) return;                                                                        \
+                right = j - 1;                                                                             \
+            }                                                                                              \
+        }                                                                                                  \
+    }                                                                                                      \
+                                                                                                           \
+    /* Put the element of rank k at a[k], with nothing larger before it and nothing smaller after */       \
+    static inline void name##_nth_element(T *a, size_t n, size_t k) {                                      \
+        if (k < n) name##_select_loop(a, 0, n - 1, k, 2 * sort_log2(n) + 8);                               \
+    }                                                                                                      \
+                                                                                                           \
+    /* Sort the k smallest elements into a[0..k-1]; the rest end up in a[k..n-1] in no order */            \
+    static inline void name##_partial_sort(T *a, size_t n, size_t k) {                                     \
+        if (k > n) k = n;                                                                                  \
+        if (k == 0) return;                                                                                \
+        if (k > n / SORT_PARTIAL_HEAP_RATIO) {                                                             \
+            if (k < n) name##_nth_element(a, n, k - 1);                                                    \
+            name##_sort(a, k);                                                                             \
+            return;                                                                                        \
+        }                                                                                                  \
+        for (size_t i = k / 2; i-- > 0;) name##_sift_down(a, k, i, NULL);                                  \
+        for (size_t i = k; i < n; i++) {                                                                   \
+            if (CMP(ARG, NULL, &a[i], &a[0])) {                                                            \
+                name##_swap(&a[i], &a[0]);                                                                 \
+                name##_sift_down(a, k, 0, NULL);                                                           \
+            }                                                                                              \
+        }                                                                                                  \
+        for (size_t end = k - 1; end > 0; end--) {                                                         \
+            name##_swap(&a[0], &a[end]);                                                                   \
+            name##_sift_down(a, end, 0, NULL);                                                             \
+        }                                                                                                  \
+    }                                                                                                      \
+                                                                                                           \
+    /* Streaming selection of the k smallest elements seen, in a caller-provided buffer of k */            \
+    typedef struct {                                                                                       \
+        T *heap;                                                                                           \
+        size_t k, len;                                                                                     \
+    } name##_topk_t;                                                                                       \
+                                                                                                           \
+    static inline void name##_topk_init(name##_topk_t *t, T *buf, size_t k) {                              \
+        t->heap = buf;                                                                                     \
+        t->k = k;                                                                                          \
+        t->len = 0;                                                                                        \
+    }                                                                                                      \
+                                                                                                           \
+    static inline void name##_topk_push(name##_topk_t *t, const T *x) {                                    \
+        if (t->len < t->k) {                                                                               \
+            t->heap[t->len++] = *x;                                                                        \
+            if (t->len == t->k) {                                                                          \
+                for (size_t i = t->k / 2; i-- > 0;) name##_sift_down(t->heap, t->k, i, NULL);              \
+            }                                                                                              \
+        } else if (t->k && CMP(ARG, NULL, x, &t->heap[0])) {                                               \
+            t->heap[0] = *x;                                                                               \
+            name##_sift_down(t->heap, t->k, 0, NULL);                                                      \
+        }                                                                                                  \
+    }                                                                                                      \
+                                                                                                           \
+    /* Once the heap is full only elements below its root can enter, and on long streams almost            \
+       none do. Each block of SORT_TOPK_BLOCK is tested against the root into a bitmask without            \
+       branches, which GCC turns into one vector compare to a mask register for scalar keys with           \
+       AVX2 or AVX-512, and only the hits are pushed. */                                                   \
+    static inline uint32_t name##_topk_filter(const T *xs, T thr) {                                        \
+        uint32_t mask = 0;                                                                                 \
+        /* Fully unrolled (as -O3 would) the loop is compiled to scalar compares instead */                \
+        _Pragma("GCC unroll 1")                                                                            \
+        for (int j = 0; j < SORT_TOPK_BLOCK; j++) mask |= (uint32_t)CMP(ARG, NULL, &xs[j], &thr) << j;     \
+        return mask;                                                                                       \
+    }                                                                                                      \
+                                                                                                           \
+    static inline void name##_topk_push_many(name##_topk_t *t, const T *xs, size_t n) {                    \
+        size_t i = 0;                                                                                      \
+        while (i < n && t->len < t->k) name##_topk_push(t, &xs[i++]);                                      \
+        if (t->k == 0) return;                                                                             \
+        for (; i + SORT_TOPK_BLOCK <= n; i += SORT_TOPK_BLOCK) {                                           \
+            uint32_t mask = name##_topk_filter(&xs[i], t->heap[0]);                                        \
+            while (mask) {                                                                                 \
+                name##_topk_push(t, &xs[i + __builtin_ctz(mask)]);                                         \
+                mask &= mask - 1;                                                                          \
+            }                                                                                              \
+        }                                                                                                  \
+        for (; i < n; i++) name##_topk_push(t, &xs[i]);                                                    \
+    }                                                                                                      \
+                                                                                                           \
+    /* Sort what was kept ascending in the buffer and return how many elements that is */                  \
+    static inline size_t name##_topk_finish(name##_topk_t *t) {                                            \
+        if (t->len < t->k) {                                                                               \
+            name##_sort(t->heap, t->len);                                                                  \
+            return t->len;                                                                                 \
+        }                                                                                                  \
+        for (size_t end = t->len; end-- > 1;) {                                                            \
+            name##_swap(&t->heap[0], &t->heap[end]);                                                       \
+            name##_sift_down(t->heap, end, 0, NULL);                                                       \
+        }                                                                                                  \
+        return t->len;                                                                                     \
+    }
+
+#define SORT_DEFINE_WITH(name, T, CMP, CMP_INDEXED, ARG)                                                   \
+    SORT_DEFINE_CORE(name, T, const void *, CMP, ARG)                                                      \
+    SORT_DEFINE_CORE(name##_by_index, size_t, const T *, CMP_INDEXED, ARG)                                 \
+                                                                                                           \
+    static inline void name##_sort(T *a, size_t n) {                                                       \
+        if (n > 1) name##_intro_loop(a, n, 2 * sort_log2(n), NULL);                                        \
+    }                                                                                                      \
+                                                                                                           \
+    SORT_DEFINE_SELECT(name, T, CMP, ARG)                                                                  \
+                                                                                                           \
+    static inline int name##_stable_sort(T *a, size_t n) {                                                 \
+        return name##_stable_sort_ctx(a, n, NULL);                                                         \
+    }                                                                                                      \
+                                                                                                           \
+    static inline int name##_sort_index(const T *a, size_t n, size_t *idx) {                               \
+        for (size_t i = 0; i < n; i++) idx[i] = i;                                                         \
+        return name##_by_index_stable_sort_ctx(idx, n, a);                                                 \
+    }                                                                                                      \
+                                                                                                           \
+    static inline int name##_sort_indirect(T *a, size_t n) {                                               \
+        size_t *idx = malloc(n * sizeof(size_t));                                                          \
+        T *out = malloc(n * sizeof(T));                                                                    \
+        int status = idx && out ? name##_sort_index(a, n, idx) : -1;                                       \
+        if (status == 0) {                                                                                 \
+            for (size_t i = 0; i < n; i++) out[i] = a[idx[i]];                                             \
+            memcpy(a, out, n * sizeof(T));                                                                 \
+        }                                                                                                  \
+        free(idx);                                                                                         \
+        free(out);                                                                                         \
+        return status;                                                                                     \
+    }
+
+#define SORT_DEFINE(name, T, LESS) SORT_DEFINE_WITH(name, T, SORT_CMP_LESS, SORT_CMP_LESS_INDEXED, LESS)
+#define SORT_DEFINE_KEY(name, T, KEY) SORT_DEFINE_WITH(name, T, SORT_CMP_KEY, SORT_CMP_KEY_INDEXED, KEY)
+
+// Ready-made instantiations. Doubles are ordered with <, so they must not contain NaN.
+#define SORT_VALUE(p) (*(p))
+#define SORT_STR_LESS(a, b) (strcmp(*(a), *(b)) < 0)
+
+typedef const char *sort_str_t;
+
+SORT_DEFINE_KEY(sort_int, int, SORT_VALUE)
+SORT_DEFINE_KEY(sort_i64, int64_t, SORT_VALUE)
+SORT_DEFINE_KEY(sort_u64, uint64_t, SORT_VALUE)
+SORT_DEFINE_KEY(sort_double, double, SORT_VALUE)
+SORT_DEFINE(sort_str, sort_str_t, SORT_STR_LESS)
+
+#endif
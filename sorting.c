@@ -1,83 +1,691 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
 #include <math.h>
+#include <limits.h>
 #include <string.h>
-#include <omp.h>
+#include <aio.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include "bench.h"
+#include "work_steal.h"
+#include "sort_typed.h"
 
 #define ITER 10000
 
-int cmp_d(const void *a, const void *b) {
-    double aa = *(double*)a, bb = *(double*)b;
-    return (aa > bb) - (aa < bb);
+// Operation counters. Sorts report comparisons and element moves through comp and swp; the hot
+// loops count into locals and add them to those totals once on the way out, the way the
+// parallel merge sort already sums its task counters, so the counts stay in registers instead
+// of being read and written through a pointer at every step. Build with -DSORT_UNINSTRUMENTED to
+// compile the counting out entirely and time the bare algorithms.
+#ifdef SORT_UNINSTRUMENTED
+#define COUNT(counter, k) ((void)(counter), (void)(k))
+#else
+#define COUNT(counter, k) ((counter) += (k))
+#endif
+
+// Per-thread scratch arena. Sorts take temporary buffers with arena_alloc() and give them back
+// with arena_release(mark), newest first, so the blocks the first run of a benchmark allocates
+// are reused by every later run on that thread instead of going through malloc, free and fresh
+// page faults each time. Blocks double in size and never move, so earlier allocations stay put
+// while the arena grows; arena_free() returns them when the thread is done sorting.
+#define ARENA_MIN_BLOCK (1 << 20)
+#define ARENA_MAX_BLOCKS 40
+
+typedef struct {
+    char *blocks[ARENA_MAX_BLOCKS];
+    size_t sizes[ARENA_MAX_BLOCKS];
+    int num_blocks;
+    int cur;            // block being allocated from
+    size_t used;        // bytes used in blocks[cur]
+} sort_arena_t;
+
+typedef struct {
+    int cur;
+    size_t used;
+} arena_mark_t;
+
+static _Thread_local sort_arena_t sort_arena;
+
+static inline arena_mark_t arena_mark(void) {
+    return (arena_mark_t){sort_arena.cur, sort_arena.used};
+}
+
+static inline void arena_release(arena_mark_t mark) {
+    sort_arena.cur = mark.cur;
+    sort_arena.used = mark.used;
 }
 
-int cmp_ll(const void *a, const void *b) {
-    long long aa = *(long long*)a, bb = *(long long*)b;
-    return (aa > bb) - (aa < bb);
+// 64-byte aligned; NULL only if a new block cannot be allocated
+static void *arena_alloc(size_t bytes) {
+    sort_arena_t *a = &sort_arena;
+    bytes = (bytes + 63) & ~(size_t)63;
+    while (a->cur < a->num_blocks && a->used + bytes > a->sizes[a->cur]) {
+        a->cur++;
+        a->used = 0;
+    }
+    if (a->cur == a->num_blocks) {
+        if (a->num_blocks == ARENA_MAX_BLOCKS) return NULL;
+        size_t size = a->num_blocks ? 2 * a->sizes[a->num_blocks - 1] : ARENA_MIN_BLOCK;
+        if (size < bytes) size = bytes;
+        char *block = aligned_alloc(64, size);
+        if (!block) return NULL;
+        a->blocks[a->num_blocks] = block;
+        a->sizes[a->num_blocks++] = size;
+        a->used = 0;
+    }
+    void *p = a->blocks[a->cur] + a->used;
+    a->used += bytes;
+    return p;
+}
+
+static void arena_free(void) {
+    for (int i = 0; i < sort_arena.num_blocks; i++) free(sort_arena.blocks[i]);
+    memset(&sort_arena, 0, sizeof(sort_arena));
 }
 
 void bubble_sort(int arr[], int n, long long *comp, long long *swp) {
+    long long comps = 0, swaps = 0;
     for (int i = 0; i < n - 1; i++) {
         int swapped = 0;
         for (int j = 0; j < n - i - 1; j++) {
-            (*comp)++;
+            COUNT(comps, 1);
             if (arr[j] > arr[j + 1]) {
                 int temp = arr[j];
                 arr[j] = arr[j + 1];
                 arr[j + 1] = temp;
-                (*swp)++;
+                COUNT(swaps, 1);
                 swapped = 1;
             }
         }
         if (swapped == 0) break;
     }
+    COUNT(*comp, comps);
+    COUNT(*swp, swaps);
 }
 
+#define INSERTION_CUTOFF 16   // ranges this small are finished by insertion sort
+#define NINTHER_THRESHOLD 128 // above this the pivot is a median of three medians
+
+void heap_sort(int arr[], int n, long long *comp, long long *swp);
+
+static inline void swap_int(int arr[], int a, int b, long long *swp) {
+    int temp = arr[a];
+    arr[a] = arr[b];
+    arr[b] = temp;
+    COUNT(*swp, 1);
+}
+
+// Sort arr[low..high] by insertion; every element shifted counts as a swap
+void insertion_sort(int arr[], int low, int high, long long *comp, long long *swp) {
+    long long comps = 0, swaps = 0;
+    for (int i = low + 1; i <= high; i++) {
+        int key = arr[i];
+        int j = i - 1;
+        while (j >= low) {
+            COUNT(comps, 1);
+            if (arr[j] <= key) break;
+            arr[j + 1] = arr[j];
+            COUNT(swaps, 1);
+            j--;
+        }
+        arr[j + 1] = key;
+    }
+    COUNT(*comp, comps);
+    COUNT(*swp, swaps);
+}
+
+// Index of the median of arr[a], arr[b], arr[c]
+static int median_of_three(int arr[], int a, int b, int c, long long *comp) {
+    COUNT(*comp, 2);
+    if (arr[a] < arr[b]) {
+        if (arr[b] < arr[c]) return b;
+        COUNT(*comp, 1);
+        return arr[a] < arr[c] ? c : a;
+    }
+    if (arr[a] < arr[c]) return a;
+    COUNT(*comp, 1);
+    return arr[b] < arr[c] ? c : b;
+}
+
+// Hoare partition around a median-of-three (or ninther) pivot. Both scans stop on keys equal to
+// the pivot, so runs of duplicates split evenly instead of degrading to quadratic time.
 int partition(int arr[], int low, int high, long long *comp, long long *swp) {
-    int pivot = arr[high];
-    int i = low - 1;
-    for (int j = low; j < high; j++) {
-        (*comp)++;
-        if (arr[j] < pivot) {
+    long long comps = 0, swaps = 0;
+    int n = high - low + 1;
+    int mid = low + n / 2;
+    int m;
+    if (n > NINTHER_THRESHOLD) {
+        int step = n / 8;
+        int m1 = median_of_three(arr, low, low + step, low + 2 * step, &comps);
+        int m2 = median_of_three(arr, mid - step, mid, mid + step, &comps);
+        int m3 = median_of_three(arr, high - 2 * step, high - step, high, &comps);
+        m = median_of_three(arr, m1, m2, m3, &comps);
+    } else {
+        m = median_of_three(arr, low, mid, high, &comps);
+    }
+    swap_int(arr, low, m, &swaps);
+
+    int pivot = arr[low];
+    int i = low, j = high + 1;
+    while (1) {
+        do {
             i++;
-            int temp = arr[i];
-            arr[i] = arr[j];
-            arr[j] = temp;
-            (*swp)++;
+            COUNT(comps, 1);
+        } while (i <= high && arr[i] < pivot);
+        do {
+            j--;
+            COUNT(comps, 1);
+        } while (arr[j] > pivot);   // stops at arr[low] == pivot at the latest
+        if (i >= j) break;
+        swap_int(arr, i, j, &swaps);
+    }
+    swap_int(arr, low, j, &swaps);
+    COUNT(*comp, comps);
+    COUNT(*swp, swaps);
+    return j;
+}
+
+// Recurse into the smaller side and loop on the larger one, so the stack stays O(log n); once
+// depth_limit partitions have not finished a range it is heapsorted instead
+static void intro_sort_loop(int arr[], int low, int high, int depth_limit, long long *comp, long long *swp) {
+    while (high - low + 1 > INSERTION_CUTOFF) {
+        if (depth_limit-- == 0) {
+            heap_sort(arr + low, high - low + 1, comp, swp);
+            return;
+        }
+        int pi = partition(arr, low, high, comp, swp);
+        if (pi - low < high - pi) {
+            intro_sort_loop(arr, low, pi - 1, depth_limit, comp, swp);
+            low = pi + 1;
+        } else {
+            intro_sort_loop(arr, pi + 1, high, depth_limit, comp, swp);
+            high = pi - 1;
         }
     }
-    int temp = arr[i + 1];
-    arr[i + 1] = arr[high];
-    arr[high] = temp;
-    (*swp)++;
-    return i + 1;
+    insertion_sort(arr, low, high, comp, swp);
 }
 
+// Introsort over arr[low..high]: quicksort with a 2 * log2(n) depth limit
 void quick_sort(int arr[], int low, int high, long long *comp, long long *swp) {
-    if (low < high) {
-        int pi = partition(arr, low, high, comp, swp);
-        quick_sort(arr, low, pi - 1, comp, swp);
-        quick_sort(arr, pi + 1, high, comp, swp);
+    int n = high - low + 1;
+    if (n < 2) return;
+    int depth_limit = 2 * (31 - __builtin_clz((unsigned int)n));
+    intro_sort_loop(arr, low, high, depth_limit, comp, swp);
+}
+
+// Pattern-defeating quicksort (pdqsort) with BlockQuicksort's branchless partition. Comparison
+// results are stored as byte offsets in 64-entry blocks and the misplaced elements are then
+// exchanged in a cycle, so the partition loop has no data-dependent branch. A partition that
+// needed no exchanges triggers a bounded insertion sort that finishes sorted runs in linear time,
+// and badly unbalanced partitions shuffle a few elements to break up adversarial patterns, with
+// heapsort as the last resort after log2(n) of them.
+#define PDQ_INSERTION_THRESHOLD 24
+#define PDQ_NINTHER_THRESHOLD 128
+#define PDQ_PARTIAL_INSERTION_LIMIT 8
+#define PDQ_BLOCK_SIZE 64
+
+static inline void pdq_swap(int *a, int *b, long long *swp) {
+    int temp = *a;
+    *a = *b;
+    *b = temp;
+    COUNT(*swp, 1);
+}
+
+static inline void pdq_sort2(int *a, int *b, long long *comp, long long *swp) {
+    COUNT(*comp, 1);
+    if (*b < *a) pdq_swap(a, b, swp);
+}
+
+static inline void pdq_sort3(int *a, int *b, int *c, long long *comp, long long *swp) {
+    pdq_sort2(a, b, comp, swp);
+    pdq_sort2(b, c, comp, swp);
+    pdq_sort2(a, b, comp, swp);
+}
+
+// Insertion sort of [begin, end) that relies on begin[-1] being no larger than any element
+static void pdq_unguarded_insertion_sort(int *begin, int *end, long long *comp, long long *swp) {
+    long long comps = 0, swaps = 0;
+    for (int *cur = begin + 1; cur < end; cur++) {
+        int key = *cur;
+        int *sift = cur;
+        COUNT(comps, 1);
+        while (key < sift[-1]) {
+            *sift = sift[-1];
+            COUNT(swaps, 1);
+            sift--;
+            COUNT(comps, 1);
+        }
+        *sift = key;
+    }
+    COUNT(*comp, comps);
+    COUNT(*swp, swaps);
+}
+
+// Insertion sort that gives up once more than PDQ_PARTIAL_INSERTION_LIMIT elements have moved;
+// returns 1 if [begin, end) ended up sorted
+static int pdq_partial_insertion_sort(int *begin, int *end, long long *comp, long long *swp) {
+    long long comps = 0, swaps = 0;
+    if (begin == end) return 1;
+    long limit = 0;
+    for (int *cur = begin + 1; cur < end; cur++) {
+        int key = *cur;
+        int *sift = cur;
+        COUNT(comps, 1);
+        if (key < sift[-1]) {
+            do {
+                *sift = sift[-1];
+                COUNT(swaps, 1);
+                sift--;
+                if (sift == begin) break;
+                COUNT(comps, 1);
+            } while (key < sift[-1]);
+            *sift = key;
+            limit += cur - sift;
+        }
+        if (limit > PDQ_PARTIAL_INSERTION_LIMIT) {
+            COUNT(*comp, comps);
+            COUNT(*swp, swaps);
+            return 0;
+        }
+    }
+    COUNT(*comp, comps);
+    COUNT(*swp, swaps);
+    return 1;
+}
+
+// Exchange num misplaced pairs given by the offset blocks. With equal block counts every
+// pair is swapped; otherwise the elements are rotated through one temporary (num + 1 moves).
+static inline void pdq_swap_offsets(int *first, int *last, const unsigned char *offsets_l,
+                                    const unsigned char *offsets_r, size_t num, int use_swaps, long long *swp) {
+    if (use_swaps) {
+        for (size_t i = 0; i < num; i++) {
+            int *l = first + offsets_l[i], *r = last - offsets_r[i];
+            int temp = *l;
+            *l = *r;
+            *r = temp;
+        }
+        COUNT(*swp, (long long)num);
+    } else if (num > 0) {
+        int *l = first + offsets_l[0], *r = last - offsets_r[0];
+        int temp = *l;
+        *l = *r;
+        for (size_t i = 1; i < num; i++) {
+            l = first + offsets_l[i];
+            *r = *l;
+            r = last - offsets_r[i];
+            *l = *r;
+        }
+        *r = temp;
+        COUNT(*swp, (long long)num);
+    }
+}
+
+// Partition [begin, end) around *begin into < pivot and >= pivot. Returns the pivot's final
+// position; *already_partitioned is set when no element had to move.
+static int *pdq_partition_right(int *begin, int *end, int *already_partitioned, long long *comp, long long *swp) {
+    long long comps = 0, swaps = 0;
+    int pivot = *begin;
+    int *first = begin, *last = end;
+
+    // The median-of-three guarantees an element >= pivot to stop this scan
+    do {
+        first++;
+        COUNT(comps, 1);
+    } while (*first < pivot);
+    if (first - 1 == begin) {
+        while (first < last) {
+            COUNT(comps, 1);
+            if (*--last < pivot) break;
+        }
+    } else {
+        do {
+            COUNT(comps, 1);
+        } while (!(*--last < pivot));
+    }
+
+    *already_partitioned = first >= last;
+    if (!*already_partitioned) {
+        pdq_swap(first, last, &swaps);
+        first++;
+
+        _Alignas(64) unsigned char offsets_l[PDQ_BLOCK_SIZE];
+        _Alignas(64) unsigned char offsets_r[PDQ_BLOCK_SIZE];
+        int *offsets_l_base = first, *offsets_r_base = last;
+        size_t num_l = 0, num_r = 0, start_l = 0, start_r = 0;
+
+        while (first < last) {
+            // Refill whichever offset blocks are empty, splitting the unknown range between them
+            size_t num_unknown = (size_t)(last - first);
+            size_t left_split = num_l == 0 ? (num_r == 0 ? num_unknown / 2 : num_unknown) : 0;
+            size_t right_split = num_r == 0 ? num_unknown - left_split : 0;
+            if (left_split > PDQ_BLOCK_SIZE) left_split = PDQ_BLOCK_SIZE;
+            if (right_split > PDQ_BLOCK_SIZE) right_split = PDQ_BLOCK_SIZE;
+
+            for (size_t i = 0; i < left_split; i++) {
+                offsets_l[num_l] = (unsigned char)i;
+                num_l += !(*first < pivot);
+                first++;
+            }
+            for (size_t i = 0; i < right_split;) {
+                offsets_r[num_r] = (unsigned char)++i;
+                num_r += *--last < pivot;
+            }
+            COUNT(comps, (long long)(left_split + right_split));
+
+            size_t num = num_l < num_r ? num_l : num_r;
+            pdq_swap_offsets(offsets_l_base, offsets_r_base, offsets_l + start_l, offsets_r + start_r, num,
+                             num_l == num_r, &swaps);
+            num_l -= num;
+            num_r -= num;
+            start_l += num;
+            start_r += num;
+            if (num_l == 0) {
+                start_l = 0;
+                offsets_l_base = first;
+            }
+            if (num_r == 0) {
+                start_r = 0;
+                offsets_r_base = last;
+            }
+        }
+
+        // One block may still hold misplaced elements; move them across the boundary
+        if (num_l) {
+            while (num_l--) pdq_swap(offsets_l_base + offsets_l[start_l + num_l], --last, &swaps);
+            first = last;
+        }
+        if (num_r) {
+            while (num_r--) pdq_swap(offsets_r_base - offsets_r[start_r + num_r], first++, &swaps);
+            last = first;
+        }
+    }
+
+    int *pivot_pos = first - 1;
+    *begin = *pivot_pos;
+    *pivot_pos = pivot;
+    COUNT(swaps, 1);
+    COUNT(*comp, comps);
+    COUNT(*swp, swaps);
+    return pivot_pos;
+}
+
+// Partition [begin, end) into <= pivot and > pivot. Used when the pivot equals the element just
+// left of the range, so everything equal to it is already in place after one pass.
+static int *pdq_partition_left(int *begin, int *end, long long *comp, long long *swp) {
+    long long comps = 0, swaps = 0;
+    int pivot = *begin;
+    int *first = begin, *last = end;
+
+    do {
+        COUNT(comps, 1);
+    } while (pivot < *--last);
+    if (last + 1 == end) {
+        while (first < last) {
+            COUNT(comps, 1);
+            if (pivot < *++first) break;
+        }
+    } else {
+        do {
+            COUNT(comps, 1);
+        } while (!(pivot < *++first));
+    }
+
+    while (first < last) {
+        pdq_swap(first, last, &swaps);
+        do {
+            COUNT(comps, 1);
+        } while (pivot < *--last);
+        do {
+            COUNT(comps, 1);
+        } while (!(pivot < *++first));
+    }
+
+    *begin = *last;
+    *last = pivot;
+    COUNT(swaps, 1);
+    COUNT(*comp, comps);
+    COUNT(*swp, swaps);
+    return last;
+}
+
+static void pdq_sort_loop(int *begin, int *end, int bad_allowed, int leftmost, long long *comp, long long *swp) {
+    long long comps = 0, swaps = 0;    // pivot selection and pattern breaking; callees count their own
+    while (1) {
+        long size = end - begin;
+        if (size < PDQ_INSERTION_THRESHOLD) {
+            if (leftmost) {
+                if (size > 1) insertion_sort(begin, 0, (int)size - 1, comp, swp);
+            } else {
+                pdq_unguarded_insertion_sort(begin, end, comp, swp);
+            }
+            break;
+        }
+
+        // Pivot to *begin: median of three, or pseudo-median of nine for large ranges
+        long s2 = size / 2;
+        if (size > PDQ_NINTHER_THRESHOLD) {
+            pdq_sort3(begin, begin + s2, end - 1, &comps, &swaps);
+            pdq_sort3(begin + 1, begin + (s2 - 1), end - 2, &comps, &swaps);
+            pdq_sort3(begin + 2, begin + (s2 + 1), end - 3, &comps, &swaps);
+            pdq_sort3(begin + (s2 - 1), begin + s2, begin + (s2 + 1), &comps, &swaps);
+            pdq_swap(begin, begin + s2, &swaps);
+        } else {
+            pdq_sort3(begin + s2, begin, end - 1, &comps, &swaps);
+        }
+
+        // A pivot equal to the element before the range means many duplicates: put every
+        // element equal to it on the left and never look at them again
+        if (!leftmost) {
+            COUNT(comps, 1);
+            if (!(begin[-1] < *begin)) {
+                begin = pdq_partition_left(begin, end, comp, swp) + 1;
+                continue;
+            }
+        }
+
+        int already_partitioned;
+        int *pivot_pos = pdq_partition_right(begin, end, &already_partitioned, comp, swp);
+        long l_size = pivot_pos - begin;
+        long r_size = end - (pivot_pos + 1);
+
+        if (l_size < size / 8 || r_size < size / 8) {
+            if (--bad_allowed == 0) {
+                heap_sort(begin, (int)size, comp, swp);
+                break;
+            }
+            // Swap a few elements out of place to break patterns that defeat the pivot choice
+            if (l_size >= PDQ_INSERTION_THRESHOLD) {
+                pdq_swap(begin, begin + l_size / 4, &swaps);
+                pdq_swap(pivot_pos - 1, pivot_pos - l_size / 4, &swaps);
+                if (l_size > PDQ_NINTHER_THRESHOLD) {
+                    pdq_swap(begin + 1, begin + (l_size / 4 + 1), &swaps);
+                    pdq_swap(begin + 2, begin + (l_size / 4 + 2), &swaps);
+                    pdq_swap(pivot_pos - 2, pivot_pos - (l_size / 4 + 1), &swaps);
+                    pdq_swap(pivot_pos - 3, pivot_pos - (l_size / 4 + 2), &swaps);
+                }
+            }
+            if (r_size >= PDQ_INSERTION_THRESHOLD) {
+                pdq_swap(pivot_pos + 1, pivot_pos + (1 + r_size / 4), &swaps);
+                pdq_swap(end - 1, end - r_size / 4, &swaps);
+                if (r_size > PDQ_NINTHER_THRESHOLD) {
+                    pdq_swap(pivot_pos + 2, pivot_pos + (2 + r_size / 4), &swaps);
+                    pdq_swap(pivot_pos + 3, pivot_pos + (3 + r_size / 4), &swaps);
+                    pdq_swap(end - 2, end - (1 + r_size / 4), &swaps);
+                    pdq_swap(end - 3, end - (2 + r_size / 4), &swaps);
+                }
+            }
+        } else if (already_partitioned && pdq_partial_insertion_sort(begin, pivot_pos, comp, swp) &&
+                   pdq_partial_insertion_sort(pivot_pos + 1, end, comp, swp)) {
+            // Nothing moved and both sides were nearly sorted
+            break;
+        }
+
+        // Recurse into the smaller side, loop on the larger
+        if (l_size < r_size) {
+            pdq_sort_loop(begin, pivot_pos, bad_allowed, leftmost, comp, swp);
+            begin = pivot_pos + 1;
+            leftmost = 0;
+        } else {
+            pdq_sort_loop(pivot_pos + 1, end, bad_allowed, 0, comp, swp);
+            end = pivot_pos;
+        }
+    }
+    COUNT(*comp, comps);
+    COUNT(*swp, swaps);
+}
+
+void pdq_sort(int arr[], int n, long long *comp, long long *swp) {
+    if (n < 2) return;
+    pdq_sort_loop(arr, arr + n, 31 - __builtin_clz((unsigned int)n), 1, comp, swp);
+}
+
+// Radix sorts over the 32-bit keys, with the sign bit flipped so signed order matches unsigned
+// digit order. They make no comparisons (apart from MSD's insertion-sort tails); every element
+// written to its bucket counts as a swap.
+#define RADIX_BITS 8
+#define RADIX_BUCKETS (1 << RADIX_BITS)
+#define RADIX_PASSES (32 / RADIX_BITS)
+#define RADIX_WC_ENTRIES 16     // ints per write-combining buffer: one 64-byte cache line
+#define RADIX_MSD_CUTOFF 64     // MSD buckets this small are finished by insertion sort
+
+static inline unsigned int radix_digit(int x, int shift) {
+    return (((unsigned int)x ^ 0x80000000u) >> shift) & (RADIX_BUCKETS - 1);
+}
+
+// LSD radix sort, one 8-bit digit per pass. All four histograms come from a single read of the
+// input, and a pass whose digit is the same for every key is skipped. Scatters go through a
+// cache-line buffer per bucket whose slots mirror the positions in a line of dst: a bucket's first
+// flush fills up to the next 64-byte boundary, and every later one stores a whole aligned line,
+// so each pass writes full lines to 256 streams instead of single ints, which keeps the TLB and
+// L1 from thrashing once n outgrows the caches.
+void radix_lsd_sort(int arr[], int n, long long *comp, long long *swp) {
+    (void)comp;
+    if (n < 2) return;
+    size_t counts[RADIX_PASSES][RADIX_BUCKETS];
+    memset(counts, 0, sizeof(counts));
+    for (int i = 0; i < n; i++) {
+        unsigned int u = (unsigned int)arr[i] ^ 0x80000000u;
+        for (int p = 0; p < RADIX_PASSES; p++) counts[p][(u >> (p * RADIX_BITS)) & (RADIX_BUCKETS - 1)]++;
+    }
+
+    arena_mark_t mark = arena_mark();
+    int *tmp = arena_alloc((size_t)n * sizeof(int));
+    _Alignas(64) int wc[RADIX_BUCKETS][RADIX_WC_ENTRIES];
+    unsigned char fill[RADIX_BUCKETS];
+    unsigned char skip[RADIX_BUCKETS];  // leading slots of a bucket's first line that belong to the bucket before
+    size_t offset[RADIX_BUCKETS];
+    int *src = arr, *dst = tmp;
+    for (int p = 0; p < RADIX_PASSES; p++) {
+        int shift = p * RADIX_BITS;
+        if (counts[p][radix_digit(src[0], shift)] == (size_t)n) continue;
+
+        size_t sum = 0;
+        for (int b = 0; b < RADIX_BUCKETS; b++) {
+            offset[b] = sum;
+            sum += counts[p][b];
+            fill[b] = skip[b] = (unsigned char)(((uintptr_t)(dst + offset[b]) % 64) / sizeof(int));
+        }
+        for (int i = 0; i < n; i++) {
+            unsigned int d = radix_digit(src[i], shift);
+            wc[d][fill[d]++] = src[i];
+            if (fill[d] == RADIX_WC_ENTRIES) {
+                if (skip[d]) {
+                    memcpy(dst + offset[d], wc[d] + skip[d], (RADIX_WC_ENTRIES - skip[d]) * sizeof(int));
+                    offset[d] += RADIX_WC_ENTRIES - skip[d];
+                    skip[d] = 0;
+                } else {
+                    memcpy(dst + offset[d], wc[d], sizeof(wc[d]));
+                    offset[d] += RADIX_WC_ENTRIES;
+                }
+                fill[d] = 0;
+            }
+        }
+        for (int b = 0; b < RADIX_BUCKETS; b++) {
+            memcpy(dst + offset[b], wc[b] + skip[b], (size_t)(fill[b] - skip[b]) * sizeof(int));
+        }
+        COUNT(*swp, n);
+        int *t = src;
+        src = dst;
+        dst = t;
+    }
+    if (src != arr) {
+        memcpy(arr, src, (size_t)n * sizeof(int));
+        COUNT(*swp, n);
     }
+    arena_release(mark);
+}
+
+// In-place MSD radix sort (American flag sort): permute arr by the digit at shift in cycles,
+// then recurse into every bucket on the next digit down
+static void radix_msd(int arr[], int n, int shift, long long *comp, long long *swp) {
+    long long swaps = 0;
+    if (n <= RADIX_MSD_CUTOFF) {
+        insertion_sort(arr, 0, n - 1, comp, swp);
+        return;
+    }
+    size_t counts[RADIX_BUCKETS] = {0};
+    for (int i = 0; i < n; i++) counts[radix_digit(arr[i], shift)]++;
+
+    if (counts[radix_digit(arr[0], shift)] != (size_t)n) {
+        size_t head[RADIX_BUCKETS], tail[RADIX_BUCKETS];
+        size_t sum = 0;
+        for (int b = 0; b < RADIX_BUCKETS; b++) {
+            head[b] = sum;
+            sum += counts[b];
+            tail[b] = sum;
+        }
+        // Each element is picked up from the first unsorted slot of its bucket and carried
+        // to the bucket it belongs in until the cycle closes
+        for (int b = 0; b < RADIX_BUCKETS; b++) {
+            while (head[b] < tail[b]) {
+                int v = arr[head[b]];
+                unsigned int d = radix_digit(v, shift);
+                while (d != (unsigned int)b) {
+                    int t = arr[head[d]];
+                    arr[head[d]++] = v;
+                    COUNT(swaps, 1);
+                    v = t;
+                    d = radix_digit(v, shift);
+                }
+                arr[head[b]++] = v;
+                COUNT(swaps, 1);
+            }
+        }
+    }
+    COUNT(*swp, swaps);
+
+    if (shift == 0) return;
+    size_t start = 0;
+    for (int b = 0; b < RADIX_BUCKETS; b++) {
+        if (counts[b] > 1) radix_msd(arr + start, (int)counts[b], shift - RADIX_BITS, comp, swp);
+        start += counts[b];
+    }
+}
+
+void radix_msd_sort(int arr[], int n, long long *comp, long long *swp) {
+    radix_msd(arr, n, 32 - RADIX_BITS, comp, swp);
 }
 
 void merge(int arr[], int l, int m, int r, long long *comp, long long *swp) {
+    long long comps = 0, swaps = 0;
     int n1 = m - l + 1;
     int n2 = r - m;
-    int *L = malloc(n1 * sizeof(int));
-    int *R = malloc(n2 * sizeof(int));
+    arena_mark_t mark = arena_mark();
+    int *L = arena_alloc(n1 * sizeof(int));
+    int *R = arena_alloc(n2 * sizeof(int));
     for (int i = 0; i < n1; i++) {
         L[i] = arr[l + i];
-        (*swp)++;
+        COUNT(swaps, 1);
     }
     for (int j = 0; j < n2; j++) {
         R[j] = arr[m + 1 + j];
-        (*swp)++;
+        COUNT(swaps, 1);
     }
     int i = 0, j = 0, k = l;
     while (i < n1 && j < n2) {
-        (*comp)++;
+        COUNT(comps, 1);
         if (L[i] <= R[j]) {
             arr[k] = L[i];
             i++;
@@ -85,23 +693,24 @@ void merge(int arr[], int l, int m, int r, long long *comp, long long *swp) {
             arr[k] = R[j];
             j++;
         }
-        (*swp)++;
+        COUNT(swaps, 1);
         k++;
     }
     while (i < n1) {
         arr[k] = L[i];
-        (*swp)++;
+        COUNT(swaps, 1);
         i++;
         k++;
     }
     while (j < n2) {
         arr[k] = R[j];
-        (*swp)++;
+        COUNT(swaps, 1);
         j++;
         k++;
     }
-    free(L);
-    free(R);
+    arena_release(mark);
+    COUNT(*comp, comps);
+    COUNT(*swp, swaps);
 }
 
 void merge_sort(int arr[], int l, int r, long long *comp, long long *swp) {
@@ -113,128 +722,1520 @@ void merge_sort(int arr[], int l, int r, long long *comp, long long *swp) {
     }
 }
 
+// Parallel merge sort on the work_steal.h pool. One scratch buffer of n ints is allocated up
+// front and each level of the recursion merges from one buffer into the other, so nothing is
+// copied back. Both halves of a split are sorted as tasks, and merges above PMS_MERGE_GRAIN
+// are split at the output midpoint by co-ranking (a binary search for how many of the first
+// i outputs come from each input), so the top-level merges run in parallel too.
+#define PMS_INSERTION_CUTOFF 32     // leaves this small are insertion sorted
+#define PMS_SORT_GRAIN 8192         // below this a subtree runs inline instead of as tasks
+#define PMS_MERGE_GRAIN 16384       // outputs per sequential merge
+
+// Number of elements of a in the first i outputs of a stable merge of a and b
+static long pms_co_rank(long i, const int *a, long na, const int *b, long nb, long long *comp) {
+    long lo = i > nb ? i - nb : 0;
+    long hi = i < na ? i : na;
+    while (lo < hi) {
+        long j = lo + (hi - lo) / 2;
+        COUNT(*comp, 1);
+        if (a[j] <= b[i - j - 1]) {
+            lo = j + 1;
+        } else {
+            hi = j;
+        }
+    }
+    return lo;
+}
+
+typedef struct {
+    ws_task_t task;
+    const int *a, *b;
+    long na, nb;
+    int *out;
+    long long comps, swaps;
+} pms_merge_task_t;
+
+static void pms_merge_task(ws_task_t *task);
+
+static void pms_merge_run(pms_merge_task_t *t) {
+    const int *a = t->a, *b = t->b;
+    long na = t->na, nb = t->nb;
+    if (na + nb > PMS_MERGE_GRAIN && ws_worker_index() >= 0) {
+        long i = (na + nb) / 2;
+        long j = pms_co_rank(i, a, na, b, nb, &t->comps);
+        pms_merge_task_t left = {{pms_merge_task, NULL}, a, b, j, i - j, t->out, 0, 0};
+        pms_merge_task_t right = {{pms_merge_task, NULL}, a + j, b + (i - j), na - j, nb - (i - j), t->out + i, 0, 0};
+        ws_group_t group;
+        ws_group_init(&group);
+        ws_spawn(&group, &right.task);
+        pms_merge_run(&left);
+        ws_wait(&group);
+        COUNT(t->comps, left.comps + right.comps);
+        COUNT(t->swaps, left.swaps + right.swaps);
+        return;
+    }
+    int *out = t->out;
+    long i = 0, j = 0, k = 0;
+    // Branch-free selection: on random keys the comparison is a coin flip
+    while (i < na && j < nb) {
+        int x = a[i], y = b[j];
+        int take_a = x <= y;
+        out[k++] = take_a ? x : y;
+        i += take_a;
+        j += !take_a;
+    }
+    COUNT(t->comps, k);
+    memcpy(out + k, a + i, (size_t)(na - i) * sizeof(int));
+    k += na - i;
+    memcpy(out + k, b + j, (size_t)(nb - j) * sizeof(int));
+    COUNT(t->swaps, na + nb);
+}
+
+static void pms_merge_task(ws_task_t *task) {
+    pms_merge_run((pms_merge_task_t *)task);
+}
+
+typedef struct {
+    ws_task_t task;
+    int *src, *tmp;     // the same range in both buffers
+    long n;
+    int to_tmp;         // leave the sorted range in tmp instead of src
+    long long comps, swaps;
+} pms_sort_task_t;
+
+static void pms_sort_task(ws_task_t *task);
+
+static void pms_sort_run(pms_sort_task_t *t) {
+    long n = t->n;
+    if (n <= PMS_INSERTION_CUTOFF) {
+        if (n > 1) insertion_sort(t->src, 0, (int)n - 1, &t->comps, &t->swaps);
+        if (t->to_tmp) {
+            memcpy(t->tmp, t->src, (size_t)n * sizeof(int));
+            COUNT(t->swaps, n);
+        }
+        return;
+    }
+    // Halves finish in the buffer this level merges from
+    long h = n / 2;
+    pms_sort_task_t left = {{pms_sort_task, NULL}, t->src, t->tmp, h, !t->to_tmp, 0, 0};
+    pms_sort_task_t right = {{pms_sort_task, NULL}, t->src + h, t->tmp + h, n - h, !t->to_tmp, 0, 0};
+    if (n > PMS_SORT_GRAIN && ws_worker_index() >= 0) {
+        ws_group_t group;
+        ws_group_init(&group);
+        ws_spawn(&group, &right.task);
+        pms_sort_run(&left);
+        ws_wait(&group);
+    } else {
+        pms_sort_run(&left);
+        pms_sort_run(&right);
+    }
+    const int *from = t->to_tmp ? t->src : t->tmp;
+    pms_merge_task_t merge = {{pms_merge_task, NULL}, from, from + h, h, n - h, t->to_tmp ? t->tmp : t->src, 0, 0};
+    pms_merge_run(&merge);
+    COUNT(t->comps, left.comps + right.comps + merge.comps);
+    COUNT(t->swaps, left.swaps + right.swaps + merge.swaps);
+}
+
+static void pms_sort_task(ws_task_t *task) {
+    pms_sort_run((pms_sort_task_t *)task);
+}
+
+// Sort arr[0..n-1] on the pool the calling thread belongs to (serially outside a pool)
+void parallel_merge_sort(int arr[], long n, long long *comp, long long *swp) {
+    if (n < 2) return;
+    arena_mark_t mark = arena_mark();
+    int *tmp = arena_alloc((size_t)n * sizeof(int));
+    pms_sort_task_t root = {{pms_sort_task, NULL}, arr, tmp, n, 0, 0, 0};
+    pms_sort_run(&root);
+    arena_release(mark);
+    COUNT(*comp, root.comps);
+    COUNT(*swp, root.swaps);
+}
+
+// Sift arr[i] down the max-heap arr[0..n-1]
 void heapify(int arr[], int n, int i, long long *comp, long long *swp) {
-    int largest = i;
-    int left = 2 * i + 1;
-    int right = 2 * i + 2;
-    if (left < n) {
-        (*comp)++;
-        if (arr[left] > arr[largest]) largest = left;
-    }
-    if (right < n) {
-        (*comp)++;
-        if (arr[right] > arr[largest]) largest = right;
-    }
-    if (largest != i) {
+    long long comps = 0, swaps = 0;
+    while (1) {
+        int largest = i;
+        int left = 2 * i + 1;
+        int right = 2 * i + 2;
+        if (left < n) {
+            COUNT(comps, 1);
+            if (arr[left] > arr[largest]) largest = left;
+        }
+        if (right < n) {
+            COUNT(comps, 1);
+            if (arr[right] > arr[largest]) largest = right;
+        }
+        if (largest == i) break;
         int temp = arr[i];
         arr[i] = arr[largest];
         arr[largest] = temp;
-        (*swp)++;
-        heapify(arr, n, largest, comp, swp);
+        COUNT(swaps, 1);
+        i = largest;
     }
+    COUNT(*comp, comps);
+    COUNT(*swp, swaps);
 }
 
 void heap_sort(int arr[], int n, long long *comp, long long *swp) {
+    long long comps = 0, swaps = 0;
     for (int i = n / 2 - 1; i >= 0; i--) {
-        heapify(arr, n, i, comp, swp);
+        heapify(arr, n, i, &comps, &swaps);
     }
     for (int i = n - 1; i > 0; i--) {
         int temp = arr[0];
         arr[0] = arr[i];
         arr[i] = temp;
-        (*swp)++;
-        heapify(arr, i, 0, comp, swp);
+        COUNT(swaps, 1);
+        heapify(arr, i, 0, &comps, &swaps);
     }
+    COUNT(*comp, comps);
+    COUNT(*swp, swaps);
 }
 
-int main() {
-    srand(time(NULL));
-    omp_set_num_threads(12);  // Set to 12 threads for Intel Core i5-12450H
-    char *algos[] = {"bubble", "quick", "merge", "heap"};
-    int num_algos = 4;
-    FILE *fp = fopen("results.txt", "w");
-    if (fp == NULL) {
-        perror("Error opening file");
-        return 1;
+// Bottom-up heapsort (Floyd): sift the hole left at the root straight down to a leaf along the
+// larger children, one comparison per level, then sift the displaced element back up from there.
+// It rarely climbs more than a level or two, so this takes about n log2 n comparisons instead of
+// the 2 n log2 n of heapify's compare-with-both-children descent, and it is iterative.
+//
+// Picking the larger child with a conditional move wins while the heap is cache resident, but
+// beyond that the next load has to wait for the comparison; a predicted branch lets the CPU fetch
+// down the (half the time right) path early, which is twice as fast at 10M elements.
+#define HEAP_BRANCHLESS_MAX (1 << 18)
+
+static void bottom_up_sift(int arr[], int n, int i, int x, long long *comp, long long *swp) {
+    long long comps = 0, swaps = 0;
+    int j = i;
+    int c;
+    // Full-width levels have two children; only the last node can be lone
+    if (n <= HEAP_BRANCHLESS_MAX) {
+        while ((c = 2 * j + 1) < n - 1) {
+            c += arr[c + 1] > arr[c];
+            COUNT(comps, 1);
+            arr[j] = arr[c];
+            COUNT(swaps, 1);
+            j = c;
+        }
+    } else {
+        while ((c = 2 * j + 1) < n - 1) {
+            if (arr[c + 1] > arr[c]) c++;
+            COUNT(comps, 1);
+            arr[j] = arr[c];
+            COUNT(swaps, 1);
+            j = c;
+        }
     }
-    for (int size = 100; size <= 1000; size += 100) {
-        for (int a = 0; a < num_algos; a++) {
-            char *algo = algos[a];
-            double *cycles = malloc(ITER * sizeof(double));
-            long long *comps = malloc(ITER * sizeof(long long));
-            long long *swaps = malloc(ITER * sizeof(long long));
-            long long sum_comps = 0, sum_swaps = 0;
-            double sum_cycles = 0.0;
-#pragma omp parallel for reduction(+:sum_cycles, sum_comps, sum_swaps)
-            for (int iter = 0; iter < ITER; iter++) {
-                unsigned int seed = (unsigned int)(time(NULL) ^ (omp_get_thread_num() << 16) ^ iter);
-                int *arr = malloc(size * sizeof(int));
-                for (int i = 0; i < size; i++) {
-                    arr[i] = rand_r(&seed);
-                }
-                long long c = 0, s = 0;
-                clock_t start = clock();
-                if (strcmp(algo, "bubble") == 0) {
-                    bubble_sort(arr, size, &c, &s);
-                } else if (strcmp(algo, "quick") == 0) {
-                    quick_sort(arr, 0, size - 1, &c, &s);
-                } else if (strcmp(algo, "merge") == 0) {
-                    merge_sort(arr, 0, size - 1, &c, &s);
-                } else if (strcmp(algo, "heap") == 0) {
-                    heap_sort(arr, size, &c, &s);
+    if (c == n - 1) {
+        arr[j] = arr[c];
+        COUNT(swaps, 1);
+        j = c;
+    }
+    while (j > i) {
+        int p = (j - 1) / 2;
+        COUNT(comps, 1);
+        if (!(x > arr[p])) break;
+        arr[j] = arr[p];
+        COUNT(swaps, 1);
+        j = p;
+    }
+    arr[j] = x;
+    COUNT(swaps, 1);
+    COUNT(*comp, comps);
+    COUNT(*swp, swaps);
+}
+
+void bottom_up_heap_sort(int arr[], int n, long long *comp, long long *swp) {
+    for (int i = n / 2 - 1; i >= 0; i--) {
+        bottom_up_sift(arr, n, i, arr[i], comp, swp);
+    }
+    for (int end = n - 1; end > 0; end--) {
+        int x = arr[end];
+        arr[end] = arr[0];
+        COUNT(*swp, 1);
+        bottom_up_sift(arr, end, 0, x, comp, swp);
+    }
+}
+
+// d-ary heap with each node's children in one aligned group: node k is stored at buf[k + d - 1]
+// of a 64-byte aligned buffer, so the children d*k+1 .. d*k+d start at a multiple of d and the
+// whole group lies in one cache line (d = 4 or 8 ints of a 16-int line). The tree is log2(d)
+// times shallower than the binary heap, and each level costs one line instead of a scattered
+// pair, at d - 1 comparisons to find the largest child. Sifting is bottom-up as above.
+static inline void dary_sift(int *heap, int n, int i, int x, int d, long long *comp, long long *swp) {
+    long long comps = 0, swaps = 0;
+    int j = i;
+    long first;
+    while ((first = (long)d * j + 1) < n) {
+        int last = first + d <= n ? (int)first + d : n;
+        int c = (int)first;
+        int best = heap[c];
+        for (int k = (int)first + 1; k < last; k++) {
+            int v = heap[k];
+            c = v > best ? k : c;
+            best = v > best ? v : best;
+        }
+        COUNT(comps, last - first - 1);
+        heap[j] = best;
+        COUNT(swaps, 1);
+        j = c;
+    }
+    while (j > i) {
+        int p = (j - 1) / d;
+        COUNT(comps, 1);
+        if (!(x > heap[p])) break;
+        heap[j] = heap[p];
+        COUNT(swaps, 1);
+        j = p;
+    }
+    heap[j] = x;
+    COUNT(swaps, 1);
+    COUNT(*comp, comps);
+    COUNT(*swp, swaps);
+}
+
+// Build the heap in an aligned copy and extract the maximum into arr from the back
+static inline void dary_heap_sort(int arr[], int n, int d, long long *comp, long long *swp) {
+    if (n < 2) return;
+    arena_mark_t mark = arena_mark();
+    int *buf = arena_alloc((size_t)(n + d - 1) * sizeof(int));
+    int *heap = buf + d - 1;
+    memcpy(heap, arr, (size_t)n * sizeof(int));
+    COUNT(*swp, n);
+    for (int i = (n - 2) / d; i >= 0; i--) {
+        dary_sift(heap, n, i, heap[i], d, comp, swp);
+    }
+    for (int end = n - 1; end > 0; end--) {
+        arr[end] = heap[0];
+        COUNT(*swp, 1);
+        dary_sift(heap, end, 0, heap[end], d, comp, swp);
+    }
+    arr[0] = heap[0];
+    COUNT(*swp, 1);
+    arena_release(mark);
+}
+
+void heap4_sort(int arr[], int n, long long *comp, long long *swp) {
+    dary_heap_sort(arr, n, 4, comp, swp);
+}
+
+void heap8_sort(int arr[], int n, long long *comp, long long *swp) {
+    dary_heap_sort(arr, n, 8, comp, swp);
+}
+
+// AVX-512 sorting kernels, selected at run time with the scalar sorts as fallback.
+//
+// Small arrays (up to SIMD_NETWORK_MAX ints) are padded with INT_MAX to a power-of-two number of
+// 16-lane vectors and sorted by a bitonic network: each vector is sorted in-register, then
+// sorted vectors are merged pairwise by flipping one against the reverse of the other and
+// cleaning each half with min/max against shuffled copies. No step depends on the data, so
+// there is nothing to mispredict. simd_merge() merges two sorted runs 16 outputs at a time with
+// the same 32-lane merge network, and simd_partition() is an in-place quicksort partition that
+// classifies 16 keys per compare and writes each side with vpcompressd.
+//
+// Counters: every lane of a vector min/max counts as one comparison and every element stored
+// counts as one swap, so the numbers stay comparable with the scalar sorts.
+#define SIMD_NETWORK_MAX 256    // largest array the bitonic network sorts (16 vectors)
+
+#define SIMD_TARGET __attribute__((target("avx512f")))
+
+static int simd_supported(void) {
+    static int supported = -1;
+    if (supported < 0) supported = __builtin_cpu_supports("avx512f");
+    return supported;
+}
+
+// Lanes set in take_max get max(v, w), the rest min(v, w)
+SIMD_TARGET static inline __m512i simd_minmax(__m512i v, __m512i w, __mmask16 take_max) {
+    return _mm512_mask_max_epi32(_mm512_min_epi32(v, w), take_max, v, w);
+}
+
+// Partner lanes i ^ 1, i ^ 2, i ^ 4 and i ^ 8
+SIMD_TARGET static inline __m512i simd_xor1(__m512i v) { return _mm512_shuffle_epi32(v, _MM_PERM_CDAB); }
+SIMD_TARGET static inline __m512i simd_xor2(__m512i v) { return _mm512_shuffle_epi32(v, _MM_PERM_BADC); }
+SIMD_TARGET static inline __m512i simd_xor4(__m512i v) { return _mm512_shuffle_i32x4(v, v, _MM_PERM_CDAB); }
+SIMD_TARGET static inline __m512i simd_xor8(__m512i v) { return _mm512_shuffle_i32x4(v, v, _MM_PERM_BADC); }
+
+SIMD_TARGET static inline __m512i simd_reverse(__m512i v) {
+    return _mm512_permutexvar_epi32(_mm512_set_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15), v);
+}
+
+// Full 16-lane bitonic sort: 10 compare-exchange stages. The masks mark the lanes that keep the
+// larger value, which alternates between ascending and descending blocks until the last merge.
+SIMD_TARGET static inline __m512i simd_sort16(__m512i v) {
+    v = simd_minmax(v, simd_xor1(v), 0x6666);
+    v = simd_minmax(v, simd_xor2(v), 0x3c3c);
+    v = simd_minmax(v, simd_xor1(v), 0x5a5a);
+    v = simd_minmax(v, simd_xor4(v), 0x0ff0);
+    v = simd_minmax(v, simd_xor2(v), 0x33cc);
+    v = simd_minmax(v, simd_xor1(v), 0x55aa);
+    v = simd_minmax(v, simd_xor8(v), 0xff00);
+    v = simd_minmax(v, simd_xor4(v), 0xf0f0);
+    v = simd_minmax(v, simd_xor2(v), 0xcccc);
+    v = simd_minmax(v, simd_xor1(v), 0xaaaa);
+    return v;
+}
+
+// Sort a bitonic vector ascending (the last four stages of the network)
+SIMD_TARGET static inline __m512i simd_clean16(__m512i v) {
+    v = simd_minmax(v, simd_xor8(v), 0xff00);
+    v = simd_minmax(v, simd_xor4(v), 0xf0f0);
+    v = simd_minmax(v, simd_xor2(v), 0xcccc);
+    v = simd_minmax(v, simd_xor1(v), 0xaaaa);
+    return v;
+}
+
+// Merge two ascending vectors: *lo gets the 16 smallest, *hi the 16 largest, both ascending
+SIMD_TARGET static inline void simd_merge32(__m512i *lo, __m512i *hi) {
+    __m512i r = simd_reverse(*hi);
+    __m512i mn = _mm512_min_epi32(*lo, r);
+    __m512i mx = _mm512_max_epi32(*lo, r);
+    *lo = simd_clean16(mn);
+    *hi = simd_clean16(mx);
+}
+
+// Bitonic sort of arr[0..n-1] for n <= SIMD_NETWORK_MAX
+SIMD_TARGET static void simd_network_sort(int arr[], int n, long long *comp, long long *swp) {
+    if (n < 2) return;
+    __m512i v[SIMD_NETWORK_MAX / 16];
+    int used = (n + 15) / 16;
+    int nv = 1;
+    while (nv < used) nv *= 2;
+    __m512i pad = _mm512_set1_epi32(INT_MAX);
+    for (int i = 0; i < nv; i++) {
+        int left = n - 16 * i;
+        __mmask16 m = left >= 16 ? 0xffff : left > 0 ? (__mmask16)((1u << left) - 1) : 0;
+        v[i] = simd_sort16(_mm512_mask_loadu_epi32(pad, m, arr + 16 * i));
+    }
+    long long stages = 10 * nv;
+
+    for (int s = 2; s <= nv; s *= 2) {
+        for (int b = 0; b < nv; b += s) {
+            // Flip: vector i against the reverse of its mirror, leaving two bitonic halves
+            for (int i = 0; i < s / 2; i++) {
+                __m512i r = simd_reverse(v[b + s - 1 - i]);
+                __m512i mn = _mm512_min_epi32(v[b + i], r);
+                v[b + s - 1 - i] = simd_reverse(_mm512_max_epi32(v[b + i], r));
+                v[b + i] = mn;
+            }
+            // Half-cleaners across whole vectors
+            for (int d = s / 4; d >= 1; d /= 2) {
+                for (int i = b; i < b + s; i++) {
+                    if ((i - b) & d) continue;
+                    __m512i mn = _mm512_min_epi32(v[i], v[i + d]);
+                    v[i + d] = _mm512_max_epi32(v[i], v[i + d]);
+                    v[i] = mn;
                 }
-                clock_t end = clock();
-                cycles[iter] = (double)(end - start);
-                comps[iter] = c;
-                swaps[iter] = s;
-                sum_cycles += cycles[iter];
-                sum_comps += comps[iter];
-                sum_swaps += swaps[iter];
-                free(arr);
             }
-            qsort(cycles, ITER, sizeof(double), cmp_d);
-            qsort(comps, ITER, sizeof(long long), cmp_ll);
-            qsort(swaps, ITER, sizeof(long long), cmp_ll);
-            double min_cycles = cycles[0];
-            double max_cycles = cycles[ITER - 1];
-            double avg_cycles = sum_cycles / ITER;
-            double med_cycles = (cycles[ITER / 2 - 1] + cycles[ITER / 2]) / 2.0;
-
-            double min_comps = (double)comps[0];
-            double max_comps = (double)comps[ITER - 1];
-            double avg_comps = (double)sum_comps / ITER;
-            double med_comps = (double)(comps[ITER / 2 - 1] + comps[ITER / 2]) / 2.0;
-
-            double min_swaps = (double)swaps[0];
-            double max_swaps = (double)swaps[ITER - 1];
-            double avg_swaps = (double)sum_swaps / ITER;
-            double med_swaps = (double)(swaps[ITER / 2 - 1] + swaps[ITER / 2]) / 2.0;
-
-            double complexity;
-            if (strcmp(algo, "bubble") == 0) {
-                complexity = (double)size * size;
-            } else {
-                complexity = (double)size * (log(size) / log(2));
+        }
+        for (int i = 0; i < nv; i++) v[i] = simd_clean16(v[i]);
+        stages += (long long)nv * (4 + __builtin_ctz((unsigned int)s));
+    }
+
+    for (int i = 0; i < used; i++) {
+        int left = n - 16 * i;
+        __mmask16 m = left >= 16 ? 0xffff : (__mmask16)((1u << left) - 1);
+        _mm512_mask_storeu_epi32(arr + 16 * i, m, v[i]);
+    }
+    COUNT(*comp, stages * 16 / 2);
+    COUNT(*swp, n);
+}
+
+// Branch-free scalar merge of x and y into out; returns the number of elements written
+static long simd_scalar_merge(const int *x, long nx, const int *y, long ny, int *out, long long *comp) {
+    long p = 0, q = 0, k = 0;
+    while (p < nx && q < ny) {
+        int u = x[p], w = y[q];
+        int take_x = u <= w;
+        out[k++] = take_x ? u : w;
+        p += take_x;
+        q += !take_x;
+    }
+    COUNT(*comp, k);
+    memcpy(out + k, x + p, (size_t)(nx - p) * sizeof(int));
+    k += nx - p;
+    memcpy(out + k, y + q, (size_t)(ny - q) * sizeof(int));
+    return k + ny - q;
+}
+
+// Merge sorted a[0..na-1] and b[0..nb-1] into out. The vector loop keeps the 16 largest
+// elements seen so far in a register and pulls the next block from whichever run has the smaller
+// head; once that run has fewer than 16 left the rest is merged with scalar code.
+SIMD_TARGET static void simd_merge(const int *a, long na, const int *b, long nb, int *out, long long *comp,
+                                   long long *swp) {
+    if (na < 16 || nb < 16) {
+        COUNT(*swp, simd_scalar_merge(a, na, b, nb, out, comp));
+        return;
+    }
+    __m512i lo = _mm512_loadu_si512(a), hi = _mm512_loadu_si512(b);
+    long i = 16, j = 16, k = 16;
+    simd_merge32(&lo, &hi);
+    _mm512_storeu_si512(out, lo);
+    long long blocks = 1;
+    while (1) {
+        __m512i next;
+        if (i < na && (j >= nb || a[i] <= b[j])) {
+            if (na - i < 16) break;
+            next = _mm512_loadu_si512(a + i);
+            i += 16;
+        } else {
+            if (j >= nb || nb - j < 16) break;
+            next = _mm512_loadu_si512(b + j);
+            j += 16;
+        }
+        simd_merge32(&next, &hi);
+        _mm512_storeu_si512(out + k, next);
+        k += 16;
+        blocks++;
+    }
+    COUNT(*comp, blocks * 80 + (i - 16) / 16 + (j - 16) / 16);
+
+    // The run that stopped the loop has fewer than 16 left: merge it with the carried vector
+    // first, then that (at most 31 elements) with the other run
+    int carry[16], buf[32];
+    _mm512_storeu_si512(carry, hi);
+    const int *x = a + i, *y = b + j;
+    long nx = na - i, ny = nb - j;
+    if (nx < ny) {
+        nx = simd_scalar_merge(carry, 16, x, nx, buf, comp);
+        x = buf;
+    } else {
+        ny = simd_scalar_merge(carry, 16, y, ny, buf, comp);
+        y = buf;
+    }
+    k += simd_scalar_merge(x, nx, y, ny, out + k, comp);
+    COUNT(*swp, k);
+}
+
+// Sort runs of SIMD_NETWORK_MAX with the network, then merge runs pairwise between arr and one
+// scratch buffer until a single run remains
+SIMD_TARGET static void simd_merge_sort_avx512(int arr[], int n, long long *comp, long long *swp) {
+    for (int i = 0; i < n; i += SIMD_NETWORK_MAX) {
+        simd_network_sort(arr + i, n - i < SIMD_NETWORK_MAX ? n - i : SIMD_NETWORK_MAX, comp, swp);
+    }
+    if (n <= SIMD_NETWORK_MAX) return;
+    arena_mark_t mark = arena_mark();
+    int *tmp = arena_alloc((size_t)n * sizeof(int));
+    int *src = arr, *dst = tmp;
+    for (long width = SIMD_NETWORK_MAX; width < n; width *= 2) {
+        for (long lo = 0; lo < n; lo += 2 * width) {
+            long mid = lo + width < n ? lo + width : n;
+            long hi = lo + 2 * width < n ? lo + 2 * width : n;
+            simd_merge(src + lo, mid - lo, src + mid, hi - mid, dst + lo, comp, swp);
+        }
+        int *t = src;
+        src = dst;
+        dst = t;
+    }
+    if (src != arr) {
+        memcpy(arr, src, (size_t)n * sizeof(int));
+        COUNT(*swp, n);
+    }
+    arena_release(mark);
+}
+
+void simd_merge_sort(int arr[], int n, long long *comp, long long *swp) {
+    if (simd_supported()) {
+        simd_merge_sort_avx512(arr, n, comp, swp);
+    } else {
+        merge_sort(arr, 0, n - 1, comp, swp);
+    }
+}
+
+// Partition classified with one compare per 16 keys, written with vpcompressd
+SIMD_TARGET static inline void simd_partition_vec(__m512i v, __m512i pv, int *arr, long *l_store, long *r_store) {
+    __mmask16 lt = _mm512_cmplt_epi32_mask(v, pv);
+    int cnt = __builtin_popcount(lt);
+    _mm512_mask_compressstoreu_epi32(arr + *l_store, lt, v);
+    *l_store += cnt;
+    *r_store -= 16 - cnt;
+    _mm512_mask_compressstoreu_epi32(arr + *r_store, (__mmask16)~lt, v);
+}
+
+// In-place partition of arr[lo..hi) (at least 32 elements) into keys < pivot followed by keys
+// >= pivot; returns the index of the first key >= pivot. The first and last vectors are held in
+// registers so both ends start with 16 free slots, and each step reads from the end with less
+// free space, which keeps a full vector of room on the side that could need it.
+SIMD_TARGET static long simd_partition(int *arr, long lo, long hi, int pivot, long long *comp, long long *swp) {
+    __m512i pv = _mm512_set1_epi32(pivot);
+    __m512i first = _mm512_loadu_si512(arr + lo), last = _mm512_loadu_si512(arr + hi - 16);
+    long l = lo + 16, r = hi - 16;
+    long l_store = lo, r_store = hi;
+    while (r - l >= 16) {
+        __m512i v;
+        if (l - l_store <= r_store - r) {
+            v = _mm512_loadu_si512(arr + l);
+            l += 16;
+        } else {
+            r -= 16;
+            v = _mm512_loadu_si512(arr + r);
+        }
+        simd_partition_vec(v, pv, arr, &l_store, &r_store);
+    }
+    // Fewer than 16 unread keys remain
+    int rest = (int)(r - l);
+    if (rest > 0) {
+        __mmask16 valid = (__mmask16)((1u << rest) - 1);
+        __m512i v = _mm512_maskz_loadu_epi32(valid, arr + l);
+        __mmask16 lt = _mm512_mask_cmplt_epi32_mask(valid, v, pv);
+        int cnt = __builtin_popcount(lt);
+        _mm512_mask_compressstoreu_epi32(arr + l_store, lt, v);
+        l_store += cnt;
+        r_store -= rest - cnt;
+        _mm512_mask_compressstoreu_epi32(arr + r_store, valid & (__mmask16)~lt, v);
+    }
+    simd_partition_vec(first, pv, arr, &l_store, &r_store);
+    simd_partition_vec(last, pv, arr, &l_store, &r_store);
+    COUNT(*comp, hi - lo);
+    COUNT(*swp, hi - lo);
+    return l_store;
+}
+
+// Quicksort on simd_partition with ninther pivots, network-sorted leaves and the same
+// depth-limited heapsort fallback as the introsort
+SIMD_TARGET static void simd_quick_sort_loop(int arr[], long lo, long hi, int depth_limit, long long *comp,
+                                             long long *swp) {
+    while (hi - lo > SIMD_NETWORK_MAX) {
+        if (depth_limit-- == 0) {
+            heap_sort(arr + lo, (int)(hi - lo), comp, swp);
+            return;
+        }
+        long n = hi - lo, step = n / 8, mid = lo + n / 2;
+        int m1 = median_of_three(arr, (int)lo, (int)(lo + step), (int)(lo + 2 * step), comp);
+        int m2 = median_of_three(arr, (int)(mid - step), (int)mid, (int)(mid + step), comp);
+        int m3 = median_of_three(arr, (int)(hi - 1 - 2 * step), (int)(hi - 1 - step), (int)(hi - 1), comp);
+        int pivot = arr[median_of_three(arr, m1, m2, m3, comp)];
+
+        long k = simd_partition(arr, lo, hi, pivot, comp, swp);
+        if (k == lo) {
+            // The pivot is the minimum: split off every copy of it, which are then in place
+            if (pivot == INT_MAX) return;
+            k = simd_partition(arr, lo, hi, pivot + 1, comp, swp);
+            lo = k;
+            continue;
+        }
+        if (k - lo < hi - k) {
+            simd_quick_sort_loop(arr, lo, k, depth_limit, comp, swp);
+            lo = k;
+        } else {
+            simd_quick_sort_loop(arr, k, hi, depth_limit, comp, swp);
+            hi = k;
+        }
+    }
+    simd_network_sort(arr + lo, (int)(hi - lo), comp, swp);
+}
+
+void simd_quick_sort(int arr[], int n, long long *comp, long long *swp) {
+    if (n < 2) return;
+    if (simd_supported()) {
+        simd_quick_sort_loop(arr, 0, n, 2 * (31 - __builtin_clz((unsigned int)n)), comp, swp);
+    } else {
+        quick_sort(arr, 0, n - 1, comp, swp);
+    }
+}
+
+// Every algorithm behind one signature, sorting arr[0..n-1]
+typedef void (*sort_fn_t)(int arr[], int n, long long *comp, long long *swp);
+
+static void quick_sort_all(int arr[], int n, long long *comp, long long *swp) {
+    quick_sort(arr, 0, n - 1, comp, swp);
+}
+
+static void merge_sort_all(int arr[], int n, long long *comp, long long *swp) {
+    merge_sort(arr, 0, n - 1, comp, swp);
+}
+
+static void parallel_merge_sort_all(int arr[], int n, long long *comp, long long *swp) {
+    parallel_merge_sort(arr, n, comp, swp);
+}
+
+// Input distributions: random and few_unique draw from rand_r, the others are fixed patterns
+enum { DIST_RANDOM, DIST_SORTED, DIST_REVERSE, DIST_ORGAN_PIPE, DIST_FEW_UNIQUE, NUM_DISTS };
+
+#define DIST_RANDOM_NAME "random"
+#define DIST_SORTED_NAME "sorted"
+#define DIST_REVERSE_NAME "reverse"
+#define DIST_ORGAN_PIPE_NAME "organ_pipe"
+#define DIST_FEW_UNIQUE_NAME "few_unique"
+
+#define FEW_UNIQUE_KEYS 16
+
+static void fill_distribution(int arr[], int n, int dist, unsigned int *seed) {
+    for (int i = 0; i < n; i++) {
+        switch (dist) {
+        case DIST_SORTED: arr[i] = i; break;
+        case DIST_REVERSE: arr[i] = n - i; break;
+        case DIST_ORGAN_PIPE: arr[i] = i < n / 2 ? i : n - i; break;
+        case DIST_FEW_UNIQUE: arr[i] = rand_r(seed) % FEW_UNIQUE_KEYS; break;
+        default: arr[i] = rand_r(seed); break;
+        }
+    }
+}
+
+// What a benchmark case sorts: passed through bench_case_t.arg
+typedef struct {
+    sort_fn_t sort;
+    int dist;
+    int parallel;       // run on a work-stealing pool of params.threads workers
+} sort_case_arg_t;
+
+typedef struct {
+    sort_fn_t sort;
+    int dist;
+    int parallel;
+    ws_pool_t pool;
+    int *arr;
+    int n;
+    unsigned int seed;
+    long long comps, swaps;
+} sort_bench_t;
+
+static void *sort_bench_setup(const bench_params_t *params, const void *arg) {
+    const sort_case_arg_t *a = arg;
+    sort_bench_t *b = malloc(sizeof(sort_bench_t));
+    b->sort = a->sort;
+    b->dist = a->dist;
+    b->parallel = a->parallel;
+    if (b->parallel) ws_pool_init(&b->pool, params->threads);
+    b->n = (int)params->size;
+    b->arr = malloc(b->n * sizeof(int));
+    b->seed = (unsigned int)time(NULL) ^ (unsigned int)params->size;
+    return b;
+}
+
+static void sort_bench_prepare(void *ctx) {
+    sort_bench_t *b = ctx;
+    fill_distribution(b->arr, b->n, b->dist, &b->seed);
+    b->comps = 0;
+    b->swaps = 0;
+}
+
+static void sort_bench_run(void *ctx) {
+    sort_bench_t *b = ctx;
+    b->sort(b->arr, b->n, &b->comps, &b->swaps);
+}
+
+static void sort_bench_extra(void *ctx, double *values) {
+    sort_bench_t *b = ctx;
+    values[0] = (double)b->comps;
+    values[1] = (double)b->swaps;
+}
+
+static void sort_bench_teardown(void *ctx) {
+    sort_bench_t *b = ctx;
+    if (b->parallel) ws_pool_destroy(&b->pool);
+    free(b->arr);
+    free(b);
+    arena_free();
+}
+
+// The backend column names the input distribution
+#define SORT_CASE(algo, fn, dist) \
+    {.name = algo, .backend = dist##_NAME, .setup = sort_bench_setup, .prepare = sort_bench_prepare, \
+     .run = sort_bench_run, .teardown = sort_bench_teardown, .bytes_per_run = SIZE_MAX, .num_extra = 2, \
+     .extra_names = {"comps", "swaps"}, .extra = sort_bench_extra, .arg = &(const sort_case_arg_t){fn, dist, 0}}
+
+// Parallel cases sweep the thread counts
+#define PAR_SORT_CASE(algo, fn, dist) \
+    {.name = algo, .backend = dist##_NAME, .setup = sort_bench_setup, .prepare = sort_bench_prepare, \
+     .run = sort_bench_run, .teardown = sort_bench_teardown, .bytes_per_run = SIZE_MAX, .num_extra = 2, \
+     .extra_names = {"comps", "swaps"}, .extra = sort_bench_extra, .max_threads = 1024, \
+     .arg = &(const sort_case_arg_t){fn, dist, 1}}
+
+static const bench_case_t sort_cases[] = {
+    SORT_CASE("bubble", bubble_sort, DIST_RANDOM),
+    SORT_CASE("quick", quick_sort_all, DIST_RANDOM),
+    SORT_CASE("merge", merge_sort_all, DIST_RANDOM),
+    SORT_CASE("heap", heap_sort, DIST_RANDOM),
+    SORT_CASE("pdq", pdq_sort, DIST_RANDOM),
+    SORT_CASE("radix_lsd", radix_lsd_sort, DIST_RANDOM),
+    SORT_CASE("radix_msd", radix_msd_sort, DIST_RANDOM),
+    PAR_SORT_CASE("pmerge", parallel_merge_sort_all, DIST_RANDOM),
+    SORT_CASE("simd_quick", simd_quick_sort, DIST_RANDOM),
+    SORT_CASE("simd_merge", simd_merge_sort, DIST_RANDOM),
+    SORT_CASE("heap_bu", bottom_up_heap_sort, DIST_RANDOM),
+    SORT_CASE("heap4", heap4_sort, DIST_RANDOM),
+    SORT_CASE("heap8", heap8_sort, DIST_RANDOM),
+};
+
+// Every algorithm except bubble sort on every distribution
+#define DIST_CASES(dist) \
+    SORT_CASE("quick", quick_sort_all, dist), SORT_CASE("merge", merge_sort_all, dist), \
+    SORT_CASE("heap", heap_sort, dist), SORT_CASE("pdq", pdq_sort, dist), \
+    SORT_CASE("radix_lsd", radix_lsd_sort, dist), SORT_CASE("radix_msd", radix_msd_sort, dist), \
+    SORT_CASE("simd_quick", simd_quick_sort, dist), SORT_CASE("simd_merge", simd_merge_sort, dist)
+
+static const bench_case_t dist_cases[] = {
+    DIST_CASES(DIST_RANDOM), DIST_CASES(DIST_SORTED), DIST_CASES(DIST_REVERSE),
+    DIST_CASES(DIST_ORGAN_PIPE), DIST_CASES(DIST_FEW_UNIQUE),
+};
+
+// The heap variants against the recursive binary heap_sort
+static const bench_case_t heap_cases[] = {
+    SORT_CASE("heap", heap_sort, DIST_RANDOM),
+    SORT_CASE("heap_bu", bottom_up_heap_sort, DIST_RANDOM),
+    SORT_CASE("heap4", heap4_sort, DIST_RANDOM),
+    SORT_CASE("heap8", heap8_sort, DIST_RANDOM),
+};
+
+// Scaling of the parallel sort against the best serial merge sort
+static const bench_case_t par_cases[] = {
+    SORT_CASE("merge", merge_sort_all, DIST_RANDOM),
+    PAR_SORT_CASE("pmerge", parallel_merge_sort_all, DIST_RANDOM),
+};
+
+// Typed sorts from sort_typed.h against qsort on the same data: 64-bit keys, doubles, 16-byte
+// and 128-byte records keyed by their first word, and C strings. The records check whether the
+// inlined comparison still pays once moving elements dominates, and how the indirect sort's
+// single move per record compares with the direct sorts.
+typedef struct {
+    uint64_t key;
+    uint64_t payload;
+} rec16_t;
+
+typedef struct {
+    uint64_t key;
+    char payload[120];
+} rec128_t;
+
+#define REC_KEY(r) ((r)->key)
+SORT_DEFINE_KEY(sort_rec16, rec16_t, REC_KEY)
+SORT_DEFINE_KEY(sort_rec128, rec128_t, REC_KEY)
+
+#define TYPED_STR_LEN 16   // random lowercase strings of this length
+#define TYPED_SELECT_K 100 // elements kept by the partial sort and top-k cases
+
+static int cmp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static int cmp_rec16(const void *a, const void *b) {
+    return cmp_u64(&((const rec16_t *)a)->key, &((const rec16_t *)b)->key);
+}
+
+static int cmp_rec128(const void *a, const void *b) {
+    return cmp_u64(&((const rec128_t *)a)->key, &((const rec128_t *)b)->key);
+}
+
+static int cmp_str(const void *a, const void *b) {
+    return strcmp(*(const char *const *)a, *(const char *const *)b);
+}
+
+enum { TYPED_U64, TYPED_DOUBLE, TYPED_REC16, TYPED_REC128, TYPED_STR };
+enum { TYPED_QSORT, TYPED_SORT, TYPED_STABLE, TYPED_INDIRECT, TYPED_NTH, TYPED_PARTIAL, TYPED_TOPK };
+
+static const size_t typed_elem_size[] = {sizeof(uint64_t), sizeof(double), sizeof(rec16_t), sizeof(rec128_t),
+                                         sizeof(const char *)};
+
+typedef struct {
+    int type;
+    int variant;
+} typed_case_arg_t;
+
+typedef struct {
+    int type;
+    int variant;
+    size_t n;
+    void *orig;         // the input, copied into arr before every run
+    void *arr;
+    void *topk;         // TYPED_SELECT_K elements for TYPED_TOPK
+    char *strings;      // backing store for TYPED_STR
+} typed_bench_t;
+
+static void *typed_bench_setup(const bench_params_t *params, const void *arg) {
+    const typed_case_arg_t *a = arg;
+    typed_bench_t *b = calloc(1, sizeof(typed_bench_t));
+    b->type = a->type;
+    b->variant = a->variant;
+    b->n = params->size;
+    size_t bytes = b->n * typed_elem_size[b->type];
+    b->orig = malloc(bytes);
+    b->arr = malloc(bytes);
+    b->topk = malloc(TYPED_SELECT_K * typed_elem_size[b->type]);
+    unsigned int seed = (unsigned int)time(NULL) ^ (unsigned int)params->size;
+    for (size_t i = 0; i < b->n; i++) {
+        uint64_t r = (uint64_t)rand_r(&seed) << 33 ^ (uint64_t)rand_r(&seed) << 16 ^ (uint64_t)rand_r(&seed);
+        switch (b->type) {
+        case TYPED_U64:
+            ((uint64_t *)b->orig)[i] = r;
+            break;
+        case TYPED_DOUBLE:
+            ((double *)b->orig)[i] = (double)(r >> 11) * 0x1p-53 * 2e6 - 1e6;
+            break;
+        case TYPED_REC16:
+            ((rec16_t *)b->orig)[i] = (rec16_t){r, i};
+            break;
+        case TYPED_REC128: {
+            rec128_t *rec = &((rec128_t *)b->orig)[i];
+            rec->key = r;
+            memset(rec->payload, (int)(i & 0xff), sizeof(rec->payload));
+            break;
+        }
+        case TYPED_STR:
+            if (!b->strings) b->strings = malloc(b->n * (TYPED_STR_LEN + 1));
+            char *str = b->strings + i * (TYPED_STR_LEN + 1);
+            for (int c = 0; c < TYPED_STR_LEN; c++) str[c] = (char)('a' + rand_r(&seed) % 26);
+            str[TYPED_STR_LEN] = '\0';
+            ((const char **)b->orig)[i] = str;
+            break;
+        }
+    }
+    return b;
+}
+
+static void typed_bench_prepare(void *ctx) {
+    typed_bench_t *b = ctx;
+    memcpy(b->arr, b->orig, b->n * typed_elem_size[b->type]);
+}
+
+// Dispatch on the variant for one sort_typed.h family and its qsort comparator. The selection
+// variants find the median, the TYPED_SELECT_K smallest in place, and the TYPED_SELECT_K smallest
+// of the array read as a stream.
+#define TYPED_RUN(family, T, cmp)                                                   \
+    switch (b->variant) {                                                           \
+    case TYPED_QSORT: qsort(b->arr, b->n, sizeof(T), cmp); break;                   \
+    case TYPED_SORT: family##_sort(b->arr, b->n); break;                            \
+    case TYPED_STABLE: family##_stable_sort(b->arr, b->n); break;                   \
+    case TYPED_INDIRECT: family##_sort_indirect(b->arr, b->n); break;               \
+    case TYPED_NTH: family##_nth_element(b->arr, b->n, b->n / 2); break;            \
+    case TYPED_PARTIAL: family##_partial_sort(b->arr, b->n, TYPED_SELECT_K); break; \
+    case TYPED_TOPK: {                                                              \
+        family##_topk_t t;                                                          \
+        family##_topk_init(&t, b->topk, TYPED_SELECT_K);                            \
+        family##_topk_push_many(&t, b->arr, b->n);                                  \
+        family##_topk_finish(&t);                                                   \
+        break;                                                                      \
+    }                                                                               \
+    }
+
+static void typed_bench_run(void *ctx) {
+    typed_bench_t *b = ctx;
+    switch (b->type) {
+    case TYPED_U64: TYPED_RUN(sort_u64, uint64_t, cmp_u64) break;
+    case TYPED_DOUBLE: TYPED_RUN(sort_double, double, cmp_double) break;
+    case TYPED_REC16: TYPED_RUN(sort_rec16, rec16_t, cmp_rec16) break;
+    case TYPED_REC128: TYPED_RUN(sort_rec128, rec128_t, cmp_rec128) break;
+    case TYPED_STR: TYPED_RUN(sort_str, sort_str_t, cmp_str) break;
+    }
+}
+
+static void typed_bench_teardown(void *ctx) {
+    typed_bench_t *b = ctx;
+    free(b->orig);
+    free(b->arr);
+    free(b->topk);
+    free(b->strings);
+    free(b);
+}
+
+// The name column is the element type, the backend column the sort
+#define TYPED_CASE(type_name, type, variant_name, variant) \
+    {.name = type_name, .backend = variant_name, .setup = typed_bench_setup, .prepare = typed_bench_prepare, \
+     .run = typed_bench_run, .teardown = typed_bench_teardown, .bytes_per_run = SIZE_MAX, \
+     .arg = &(const typed_case_arg_t){type, variant}}
+
+#define TYPED_CASES(type_name, type) \
+    TYPED_CASE(type_name, type, "qsort", TYPED_QSORT), TYPED_CASE(type_name, type, "typed", TYPED_SORT), \
+    TYPED_CASE(type_name, type, "stable", TYPED_STABLE)
+
+static const bench_case_t typed_cases[] = {
+    TYPED_CASES("u64", TYPED_U64),
+    TYPED_CASES("double", TYPED_DOUBLE),
+    TYPED_CASES("rec16", TYPED_REC16),
+    TYPED_CASES("rec128", TYPED_REC128),
+    TYPED_CASE("rec128", TYPED_REC128, "indirect", TYPED_INDIRECT),
+    TYPED_CASES("str", TYPED_STR),
+};
+
+// Selection against sorting everything and reading off the answer
+#define SELECT_CASES(type_name, type) \
+    TYPED_CASE(type_name, type, "qsort", TYPED_QSORT), TYPED_CASE(type_name, type, "typed", TYPED_SORT), \
+    TYPED_CASE(type_name, type, "nth_element", TYPED_NTH), \
+    TYPED_CASE(type_name, type, "partial_sort", TYPED_PARTIAL), TYPED_CASE(type_name, type, "topk", TYPED_TOPK)
+
+static const bench_case_t select_cases[] = {
+    SELECT_CASES("u64", TYPED_U64),
+    SELECT_CASES("double", TYPED_DOUBLE),
+    SELECT_CASES("rec16", TYPED_REC16),
+};
+
+// External merge sort for files of native-endian ints larger than memory.
+//
+// Run formation reads the input a memory budget at a time, sorts each chunk in place with
+// simd_quick_sort (in place, so a run is the whole budget) and appends it to one unlinked temp
+// file. All I/O goes through EXT_IO_ALIGN-aligned buffers in requests of up to EXT_IO_MAX bytes.
+//
+// The merge drives a loser tree over as many runs as the budget allows. Each run has two buffers:
+// while the tree drains one, a POSIX AIO read fills the other, so the merge waits on the disk
+// only when it outruns it. The output is double-buffered the same way with aio_write. When there
+// are more runs than the fan-in, extra passes merge groups of runs into a second temp file.
+#define EXT_IO_ALIGN 4096
+#define EXT_IO_MAX (64 << 20)       // largest single read or write in bytes
+#define EXT_MIN_BUF (256 << 10)     // smallest per-run merge buffer; below it the fan-in shrinks
+#define EXT_MAX_BUF (8 << 20)       // largest per-run merge buffer
+#define EXT_DONE LLONG_MAX          // loser-tree key of an exhausted run
+
+typedef struct {
+    off_t offset;       // bytes
+    long long n;        // ints
+} ext_run_t;
+
+typedef struct {
+    const char *input;      // NULL: generate size random ints in tmp_dir
+    const char *output;     // NULL: a temp file in tmp_dir, checked and removed
+    const char *tmp_dir;
+    size_t mem;             // memory budget in bytes
+    long long size;
+} ext_config_t;
+
+static int ext_pread_full(int fd, void *buf, size_t len, off_t off, size_t *got) {
+    size_t done = 0;
+    while (done < len) {
+        size_t want = len - done < EXT_IO_MAX ? len - done : EXT_IO_MAX;
+        ssize_t r = pread(fd, (char *)buf + done, want, off + (off_t)done);
+        if (r < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        if (r == 0) break;
+        done += (size_t)r;
+    }
+    *got = done;
+    return 0;
+}
+
+static int ext_pwrite_full(int fd, const void *buf, size_t len, off_t off) {
+    size_t done = 0;
+    while (done < len) {
+        size_t want = len - done < EXT_IO_MAX ? len - done : EXT_IO_MAX;
+        ssize_t r = pwrite(fd, (const char *)buf + done, want, off + (off_t)done);
+        if (r < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        done += (size_t)r;
+    }
+    return 0;
+}
+
+// Wait for an AIO request; a short transfer is completed synchronously. Returns the bytes moved
+static ssize_t ext_aio_finish(struct aiocb *cb, int write) {
+    const struct aiocb *list[1] = {cb};
+    while (aio_error(cb) == EINPROGRESS) aio_suspend(list, 1, NULL);
+    ssize_t r = aio_return(cb);
+    if (r < 0) return -1;
+    size_t done = (size_t)r, len = cb->aio_nbytes;
+    if (done < len) {
+        char *buf = (char *)cb->aio_buf + done;
+        off_t off = cb->aio_offset + (off_t)done;
+        if (write) {
+            if (ext_pwrite_full(cb->aio_fildes, buf, len - done, off) != 0) return -1;
+            done = len;
+        } else {
+            size_t got;
+            if (ext_pread_full(cb->aio_fildes, buf, len - done, off, &got) != 0) return -1;
+            done += got;
+        }
+    }
+    return (ssize_t)done;
+}
+
+// One run being merged: the tree consumes buf[cur] while buf[cur ^ 1] is being read
+typedef struct {
+    int fd;
+    off_t next, end;        // next byte to request and the end of the run
+    int *buf[2];
+    struct aiocb cb[2];
+    int pending[2];         // 1 while a read into buf[i] is in flight
+    int cur;
+    size_t pos, len;        // ints consumed and available in buf[cur]
+    size_t cap;             // bytes per buffer
+} ext_reader_t;
+
+static int ext_reader_issue(ext_reader_t *r, int b) {
+    r->pending[b] = 0;
+    if (r->next >= r->end) return 0;
+    size_t len = (size_t)(r->end - r->next) < r->cap ? (size_t)(r->end - r->next) : r->cap;
+    struct aiocb *cb = &r->cb[b];
+    memset(cb, 0, sizeof(*cb));
+    cb->aio_fildes = r->fd;
+    cb->aio_offset = r->next;
+    cb->aio_buf = r->buf[b];
+    cb->aio_nbytes = len;
+    if (aio_read(cb) != 0) return -1;
+    r->pending[b] = 1;
+    r->next += (off_t)len;
+    return 0;
+}
+
+// Make buf[cur] current: wait for its read and start the next one into the other buffer.
+// Returns the ints now available, 0 at the end of the run or -1 on an I/O error
+static long ext_reader_fill(ext_reader_t *r) {
+    r->pos = 0;
+    r->len = 0;
+    if (!r->pending[r->cur]) return 0;
+    ssize_t got = ext_aio_finish(&r->cb[r->cur], 0);
+    r->pending[r->cur] = 0;
+    if (got < 0 || ext_reader_issue(r, r->cur ^ 1) != 0) return -1;
+    r->len = (size_t)got / sizeof(int);
+    return (long)r->len;
+}
+
+typedef struct {
+    int fd;
+    off_t off;
+    int *buf[2];
+    struct aiocb cb;        // the write in flight from buf[cur ^ 1], if pending
+    int pending;
+    int cur;
+    size_t pos, cap;        // ints in buf[cur] and the capacity in ints
+} ext_writer_t;
+
+static int ext_writer_flush(ext_writer_t *w) {
+    if (w->pending && ext_aio_finish(&w->cb, 1) < 0) return -1;
+    w->pending = 0;
+    if (w->pos == 0) return 0;
+    memset(&w->cb, 0, sizeof(w->cb));
+    w->cb.aio_fildes = w->fd;
+    w->cb.aio_offset = w->off;
+    w->cb.aio_buf = w->buf[w->cur];
+    w->cb.aio_nbytes = w->pos * sizeof(int);
+    if (aio_write(&w->cb) != 0) return -1;
+    w->pending = 1;
+    w->off += (off_t)(w->pos * sizeof(int));
+    w->cur ^= 1;
+    w->pos = 0;
+    return 0;
+}
+
+// Loser tree over k runs: tree[0] is the run with the smallest head, tree[1..k-1] the loser of
+// the match at that node, and run i plays from leaf k + i
+static int ext_tree_build(int *tree, const long long *key, int k, int node) {
+    if (node >= k) return node - k;
+    int a = ext_tree_build(tree, key, k, 2 * node);
+    int b = ext_tree_build(tree, key, k, 2 * node + 1);
+    if (key[b] < key[a]) {
+        tree[node] = a;
+        return b;
+    }
+    tree[node] = b;
+    return a;
+}
+
+// The winner's key changed: replay its path to the root, one comparison per level
+static inline void ext_tree_replay(int *tree, const long long *key, int k) {
+    int w = tree[0];
+    for (int node = (w + k) / 2; node > 0; node /= 2) {
+        if (key[tree[node]] < key[w]) {
+            int t = tree[node];
+            tree[node] = w;
+            w = t;
+        }
+    }
+    tree[0] = w;
+}
+
+// Merge runs[0..k-1] of in_fd to out_fd at out_off, with per-run buffers of buf_bytes
+static int ext_merge(int in_fd, const ext_run_t *runs, int k, int out_fd, off_t out_off, size_t buf_bytes) {
+    if (k < 1) return 0;
+    ext_reader_t *rd = calloc((size_t)k, sizeof(ext_reader_t));
+    long long *key = malloc((size_t)k * sizeof(long long));
+    int *tree = malloc((size_t)k * sizeof(int));
+    ext_writer_t w = {.fd = out_fd, .off = out_off, .cap = buf_bytes / sizeof(int)};
+    int status = -1;
+    w.buf[0] = aligned_alloc(EXT_IO_ALIGN, buf_bytes);
+    w.buf[1] = aligned_alloc(EXT_IO_ALIGN, buf_bytes);
+    if (!rd || !key || !tree || !w.buf[0] || !w.buf[1]) goto done;
+    for (int i = 0; i < k; i++) {
+        ext_reader_t *r = &rd[i];
+        r->fd = in_fd;
+        r->next = runs[i].offset;
+        r->end = runs[i].offset + (off_t)(runs[i].n * (long long)sizeof(int));
+        r->cap = buf_bytes;
+        r->buf[0] = aligned_alloc(EXT_IO_ALIGN, buf_bytes);
+        r->buf[1] = aligned_alloc(EXT_IO_ALIGN, buf_bytes);
+        if (!r->buf[0] || !r->buf[1] || ext_reader_issue(r, 0) != 0) goto done;
+    }
+    for (int i = 0; i < k; i++) {
+        long got = ext_reader_fill(&rd[i]);
+        if (got < 0) goto done;
+        key[i] = got ? rd[i].buf[0][0] : EXT_DONE;
+    }
+    tree[0] = ext_tree_build(tree, key, k, 1);
+
+    while (key[tree[0]] != EXT_DONE) {
+        int i = tree[0];
+        ext_reader_t *r = &rd[i];
+        w.buf[w.cur][w.pos++] = (int)key[i];
+        if (w.pos == w.cap && ext_writer_flush(&w) != 0) goto done;
+        if (++r->pos == r->len) {
+            r->cur ^= 1;
+            long got = ext_reader_fill(r);
+            if (got < 0) goto done;
+            key[i] = got ? r->buf[r->cur][0] : EXT_DONE;
+        } else {
+            key[i] = r->buf[r->cur][r->pos];
+        }
+        ext_tree_replay(tree, key, k);
+    }
+    // Flush the tail, then wait for it
+    if (ext_writer_flush(&w) == 0 && ext_writer_flush(&w) == 0) status = 0;
+
+done:
+    if (w.pending) ext_aio_finish(&w.cb, 1);
+    for (int i = 0; rd && i < k; i++) {
+        for (int b = 0; b < 2; b++) {
+            if (rd[i].pending[b]) ext_aio_finish(&rd[i].cb[b], 0);
+            free(rd[i].buf[b]);
+        }
+    }
+    free(w.buf[0]);
+    free(w.buf[1]);
+    free(rd);
+    free(key);
+    free(tree);
+    return status;
+}
+
+// Fan-in and per-run buffer size that fit the budget: k runs and the output, two buffers each
+static int ext_fan_in(size_t mem, int nruns, size_t *buf_bytes) {
+    size_t b = mem / (2 * ((size_t)nruns + 1));
+    if (b > EXT_MAX_BUF) b = EXT_MAX_BUF;
+    b &= ~(size_t)(EXT_IO_ALIGN - 1);
+    if (b >= EXT_MIN_BUF) {
+        *buf_bytes = b;
+        return nruns;
+    }
+    *buf_bytes = EXT_MIN_BUF;
+    long fan = (long)(mem / (2 * (size_t)EXT_MIN_BUF)) - 1;
+    return fan < 2 ? 2 : (int)fan;
+}
+
+static int ext_tmp_file(const char *dir) {
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/extsort.XXXXXX", dir);
+    int fd = mkstemp(path);
+    if (fd >= 0) unlink(path);
+    return fd;
+}
+
+// Push written data to the disk and out of the page cache, so the next pass really reads it
+static void ext_drop_cache(int fd) {
+    fdatasync(fd);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+}
+
+static double ext_mbps(double bytes, uint64_t ns) {
+    return ns ? bytes / 1e6 / ((double)ns / 1e9) : 0.0;
+}
+
+// Sequential write then read of bytes through a temp file in dir, bypassing the page cache for
+// the read; the ceiling each sort pass is measured against
+static int ext_disk_bandwidth(const char *dir, size_t bytes, double *write_mbps, double *read_mbps) {
+    int fd = ext_tmp_file(dir);
+    char *buf = aligned_alloc(EXT_IO_ALIGN, EXT_IO_MAX);
+    if (fd < 0 || !buf) {
+        if (fd >= 0) close(fd);
+        free(buf);
+        return -1;
+    }
+    memset(buf, 0x5a, EXT_IO_MAX);
+    int status = 0;
+    uint64_t t0 = bench_raw_ns();
+    for (size_t off = 0; off < bytes && status == 0; off += EXT_IO_MAX) {
+        size_t len = bytes - off < EXT_IO_MAX ? bytes - off : EXT_IO_MAX;
+        status = ext_pwrite_full(fd, buf, len, (off_t)off);
+    }
+    ext_drop_cache(fd);
+    uint64_t t1 = bench_raw_ns();
+    for (size_t off = 0; off < bytes && status == 0; off += EXT_IO_MAX) {
+        size_t got;
+        status = ext_pread_full(fd, buf, EXT_IO_MAX, (off_t)off, &got);
+    }
+    uint64_t t2 = bench_raw_ns();
+    *write_mbps = ext_mbps((double)bytes, t1 - t0);
+    *read_mbps = ext_mbps((double)bytes, t2 - t1);
+    close(fd);
+    free(buf);
+    return status;
+}
+
+// Fill fd with n random ints
+static int ext_generate(int fd, long long n) {
+    size_t chunk = EXT_IO_MAX / sizeof(int);
+    int *buf = aligned_alloc(EXT_IO_ALIGN, EXT_IO_MAX);
+    if (!buf) return -1;
+    unsigned int seed = (unsigned int)time(NULL);
+    int status = 0;
+    for (long long done = 0; done < n && status == 0; done += (long long)chunk) {
+        size_t len = (size_t)(n - done) < chunk ? (size_t)(n - done) : chunk;
+        for (size_t i = 0; i < len; i++) buf[i] = (int)((unsigned int)rand_r(&seed) << 1 ^ (unsigned int)rand_r(&seed));
+        status = ext_pwrite_full(fd, buf, len * sizeof(int), (off_t)(done * (long long)sizeof(int)));
+    }
+    free(buf);
+    ext_drop_cache(fd);
+    return status;
+}
+
+// Stream the output back: sorted, n ints, and the same wrapping sum as the input
+static int ext_verify(int fd, long long n, uint64_t sum) {
+    int *buf = aligned_alloc(EXT_IO_ALIGN, EXT_IO_MAX);
+    if (!buf) return -1;
+    long long seen = 0;
+    int prev = INT_MIN, ok = 1;
+    uint64_t s = 0;
+    size_t got;
+    while (ok && ext_pread_full(fd, buf, EXT_IO_MAX, (off_t)(seen * (long long)sizeof(int)), &got) == 0 && got) {
+        size_t m = got / sizeof(int);
+        for (size_t i = 0; i < m; i++) {
+            if (buf[i] < prev) ok = 0;
+            prev = buf[i];
+            s += (uint64_t)(unsigned int)buf[i];
+        }
+        seen += (long long)m;
+    }
+    free(buf);
+    return ok && seen == n && s == sum ? 0 : -1;
+}
+
+static int ext_sort(const ext_config_t *cfg) {
+    int status = 1;
+    int in_fd = -1, out_fd = -1, tmp_fd[2] = {-1, -1};
+    ext_run_t *runs = NULL, *next_runs = NULL;
+    int *arr = NULL;
+
+    if (cfg->input) {
+        in_fd = open(cfg->input, O_RDONLY);
+    } else {
+        in_fd = ext_tmp_file(cfg->tmp_dir);
+        if (in_fd >= 0 && ext_generate(in_fd, cfg->size) != 0) {
+            printf("Error: Could not write input to %s.\n", cfg->tmp_dir);
+            goto done;
+        }
+    }
+    out_fd = cfg->output ? open(cfg->output, O_RDWR | O_CREAT | O_TRUNC, 0644) : ext_tmp_file(cfg->tmp_dir);
+    tmp_fd[0] = ext_tmp_file(cfg->tmp_dir);
+    tmp_fd[1] = ext_tmp_file(cfg->tmp_dir);
+    if (in_fd < 0 || out_fd < 0 || tmp_fd[0] < 0 || tmp_fd[1] < 0) {
+        perror("Error opening file");
+        goto done;
+    }
+    struct stat st;
+    fstat(in_fd, &st);
+    long long n = (long long)st.st_size / (long long)sizeof(int);
+    double bytes = (double)n * sizeof(int);
+
+    double disk_write, disk_read;
+    size_t probe = st.st_size < (1 << 30) ? (size_t)st.st_size : (1 << 30);
+    if (probe < EXT_IO_MAX) probe = EXT_IO_MAX;
+    if (ext_disk_bandwidth(cfg->tmp_dir, probe, &disk_write, &disk_read) != 0) {
+        printf("Error: Could not measure disk bandwidth in %s.\n", cfg->tmp_dir);
+        goto done;
+    }
+    // A pass reads and writes everything once: its ceiling is the two transfers back to back
+    double pass_bound = 1.0 / (1.0 / disk_write + 1.0 / disk_read);
+    printf("input %.1f MB, budget %.1f MB, temp %s\n", bytes / 1e6, (double)cfg->mem / 1e6, cfg->tmp_dir);
+    printf("disk: write %.1f MB/s, read %.1f MB/s, one pass at most %.1f MB/s\n", disk_write, disk_read,
+           pass_bound);
+
+    // Run formation
+    size_t chunk = cfg->mem / sizeof(int);
+    chunk &= ~(size_t)(EXT_IO_ALIGN / sizeof(int) - 1);
+    if (chunk > (size_t)1 << 30) chunk = (size_t)1 << 30;     // simd_quick_sort takes an int count
+    if (chunk == 0) chunk = EXT_IO_ALIGN / sizeof(int);
+    arr = aligned_alloc(EXT_IO_ALIGN, chunk * sizeof(int));
+    int nruns = 0, max_runs = (int)(n / (long long)chunk) + 1;
+    runs = malloc((size_t)max_runs * sizeof(ext_run_t));
+    next_runs = malloc((size_t)max_runs * sizeof(ext_run_t));
+    if (!arr || !runs || !next_runs) {
+        printf("Error: Could not allocate a %zu MB run buffer.\n", chunk * sizeof(int) >> 20);
+        goto done;
+    }
+    uint64_t sum = 0, t0 = bench_raw_ns(), total_ns = 0;
+    off_t off = 0;
+    size_t got;
+    long long comps = 0, swaps = 0;
+    while (ext_pread_full(in_fd, arr, chunk * sizeof(int), off, &got) == 0 && got >= sizeof(int)) {
+        int m = (int)(got / sizeof(int));
+        for (int i = 0; i < m; i++) sum += (uint64_t)(unsigned int)arr[i];
+        simd_quick_sort(arr, m, &comps, &swaps);
+        if (ext_pwrite_full(tmp_fd[0], arr, (size_t)m * sizeof(int), off) != 0) {
+            perror("Error writing run");
+            goto done;
+        }
+        runs[nruns++] = (ext_run_t){off, m};
+        off += (off_t)((size_t)m * sizeof(int));
+    }
+    free(arr);
+    arr = NULL;
+    ext_drop_cache(tmp_fd[0]);
+    uint64_t ns = bench_raw_ns() - t0;
+    total_ns += ns;
+    printf("runs: %d of up to %.1f MB in %.2f s, %.1f MB/s\n", nruns, (double)chunk * sizeof(int) / 1e6,
+           (double)ns / 1e9, ext_mbps(bytes, ns));
+
+    // Intermediate passes until one merge can take every run, then the final merge into out_fd
+    int src = 0;
+    for (int pass = 1;; pass++) {
+        size_t buf_bytes;
+        int fan = ext_fan_in(cfg->mem, nruns, &buf_bytes);
+        int final = fan >= nruns;
+        int dst_fd = final ? out_fd : tmp_fd[src ^ 1];
+        int groups = 0;
+        t0 = bench_raw_ns();
+        off = 0;
+        for (int g = 0; g < nruns; g += fan) {
+            int k = nruns - g < fan ? nruns - g : fan;
+            long long m = 0;
+            for (int i = 0; i < k; i++) m += runs[g + i].n;
+            if (ext_merge(tmp_fd[src], runs + g, k, dst_fd, off, buf_bytes) != 0) {
+                perror("Error merging runs");
+                goto done;
             }
-            min_comps /= complexity;
-            max_comps /= complexity;
-            avg_comps /= complexity;
-            med_comps /= complexity;
-            min_swaps /= complexity;
-            max_swaps /= complexity;
-            avg_swaps /= complexity;
-            med_swaps /= complexity;
+            next_runs[groups++] = (ext_run_t){off, m};
+            off += (off_t)(m * (long long)sizeof(int));
+        }
+        ext_drop_cache(dst_fd);
+        ns = bench_raw_ns() - t0;
+        total_ns += ns;
+        printf("merge pass %d: %d runs, fan-in %d, %zu KB buffers, %.2f s, %.1f MB/s\n", pass, nruns,
+               final ? nruns : fan, buf_bytes >> 10, (double)ns / 1e9, ext_mbps(bytes, ns));
+        if (final) break;
+        ext_run_t *t = runs;
+        runs = next_runs;
+        next_runs = t;
+        nruns = groups;
+        src ^= 1;
+    }
+    printf("total: %.2f s, %.1f MB/s\n", (double)total_ns / 1e9, ext_mbps(bytes, total_ns));
 
-            fprintf(fp, "%s,%d,%.2f,%.2f,%.2f,%.2f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f\n",
-                   algo, size, min_cycles, max_cycles, avg_cycles, med_cycles,
-                   min_comps, max_comps, avg_comps, med_comps,
-                   min_swaps, max_swaps, avg_swaps, med_swaps);
+    if (ext_verify(out_fd, n, sum) != 0) {
+        printf("Error: Output is not the sorted input.\n");
+        goto done;
+    }
+    printf("output verified\n");
+    status = 0;
+
+done:
+    free(arr);
+    free(runs);
+    free(next_runs);
+    if (in_fd >= 0) close(in_fd);
+    if (out_fd >= 0) close(out_fd);
+    if (tmp_fd[0] >= 0) close(tmp_fd[0]);
+    if (tmp_fd[1] >= 0) close(tmp_fd[1]);
+    return status;
+}
 
-            free(cycles);
-            free(comps);
-            free(swaps);
+// ./sorting extsort [--input FILE] [--output FILE] [--size N] [--mem MB] [--tmp DIR]
+static int ext_sort_main(int argc, char **argv) {
+    ext_config_t cfg = {NULL, NULL, getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp", (size_t)256 << 20, 1LL << 28};
+    for (int i = 0; i < argc; i++) {
+        if (i + 1 < argc && strcmp(argv[i], "--input") == 0) {
+            cfg.input = argv[++i];
+        } else if (i + 1 < argc && strcmp(argv[i], "--output") == 0) {
+            cfg.output = argv[++i];
+        } else if (i + 1 < argc && strcmp(argv[i], "--size") == 0) {
+            cfg.size = atoll(argv[++i]);
+        } else if (i + 1 < argc && strcmp(argv[i], "--mem") == 0) {
+            cfg.mem = (size_t)atoll(argv[++i]) << 20;
+        } else if (i + 1 < argc && strcmp(argv[i], "--tmp") == 0) {
+            cfg.tmp_dir = argv[++i];
+        } else {
+            printf("Usage: ./sorting extsort [--input FILE] [--output FILE] [--size N] [--mem MB] [--tmp DIR]\n");
+            return 1;
         }
     }
+    // Smallest budget a 2-way merge fits in: two runs and the output, two EXT_MIN_BUF buffers each
+    if (cfg.mem < 6 * (size_t)EXT_MIN_BUF) cfg.mem = 6 * (size_t)EXT_MIN_BUF;
+    return ext_sort(&cfg);
+}
+
+// Usage: ./sorting [bench.h flags]             random inputs, writes results.txt for analysis_sorting.py
+//        ./sorting dist [bench.h flags]        every distribution, table (and --csv/--json) only
+//        ./sorting par [bench.h flags]         parallel merge sort from 1 thread up to every core
+//        ./sorting heap [bench.h flags]        heapsort variants from 1k to 100M elements
+//        ./sorting typed [bench.h flags]       sort_typed.h against qsort on keys, records and strings
+//        ./sorting select [bench.h flags]      median, partial sort and top-k against full sorts
+//        ./sorting extsort [ext_sort_main flags] external merge sort of an int file, e.g. larger than RAM
+int main(int argc, char **argv) {
+    bench_config_t cfg;
+    if (argc > 1 && strcmp(argv[1], "dist") == 0) {
+        bench_config_init(&cfg, 200, 5);
+        size_t sizes[] = {1000, 100000, 1000000};
+        for (int i = 0; i < 3; i++) cfg.sizes[cfg.num_sizes++] = sizes[i];
+        return bench_main(dist_cases, sizeof(dist_cases) / sizeof(dist_cases[0]), &cfg, argc - 2, argv + 2);
+    }
+    if (argc > 1 && strcmp(argv[1], "heap") == 0) {
+        bench_config_init(&cfg, 5, 1);
+        size_t sizes[] = {1000, 100000, 1000000, 10000000, 100000000};
+        for (int i = 0; i < 5; i++) cfg.sizes[cfg.num_sizes++] = sizes[i];
+        return bench_main(heap_cases, sizeof(heap_cases) / sizeof(heap_cases[0]), &cfg, argc - 2, argv + 2);
+    }
+    if (argc > 1 && strcmp(argv[1], "typed") == 0) {
+        bench_config_init(&cfg, 20, 2);
+        size_t sizes[] = {1000, 100000, 1000000};
+        for (int i = 0; i < 3; i++) cfg.sizes[cfg.num_sizes++] = sizes[i];
+        return bench_main(typed_cases, sizeof(typed_cases) / sizeof(typed_cases[0]), &cfg, argc - 2, argv + 2);
+    }
+    if (argc > 1 && strcmp(argv[1], "select") == 0) {
+        bench_config_init(&cfg, 20, 2);
+        size_t sizes[] = {10000, 1000000, 10000000};
+        for (int i = 0; i < 3; i++) cfg.sizes[cfg.num_sizes++] = sizes[i];
+        return bench_main(select_cases, sizeof(select_cases) / sizeof(select_cases[0]), &cfg, argc - 2, argv + 2);
+    }
+    if (argc > 1 && strcmp(argv[1], "extsort") == 0) {
+        return ext_sort_main(argc - 2, argv + 2);
+    }
+    if (argc > 1 && strcmp(argv[1], "par") == 0) {
+        // 1M and 16M by default; up to 1G elements with --sizes (8 GB with the scratch buffer)
+        bench_config_init(&cfg, 10, 1);
+        cfg.sizes[cfg.num_sizes++] = 1 << 20;
+        cfg.sizes[cfg.num_sizes++] = 1 << 24;
+        int cores = get_nprocs();
+        for (int t = 1; t < cores && cfg.num_threads < BENCH_MAX_SWEEP - 1; t *= 2) cfg.threads[cfg.num_threads++] = t;
+        cfg.threads[cfg.num_threads++] = cores;
+        return bench_main(par_cases, sizeof(par_cases) / sizeof(par_cases[0]), &cfg, argc - 2, argv + 2);
+    }
+
+    bench_config_init(&cfg, ITER, 10);
+    for (int size = 100; size <= 1000; size += 100) {
+        cfg.sizes[cfg.num_sizes++] = (size_t)size;
+    }
+    if (bench_parse_args(&cfg, argc - 1, argv + 1) != 0) {
+        return 1;
+    }
+
+    FILE *fp = fopen("results.txt", "w");
+    if (fp == NULL) {
+        perror("Error opening file");
+        return 1;
+    }
+    int num_results;
+    bench_result_t *results = bench_run_suite(sort_cases, sizeof(sort_cases) / sizeof(sort_cases[0]), &cfg, &num_results);
+    for (int r = 0; r < num_results; r++) {
+        const bench_result_t *res = &results[r];
+        const char *algo = res->bc->name;
+        double size = (double)res->params.size;
+        double complexity;
+        if (strcmp(algo, "bubble") == 0) {
+            complexity = size * size;
+        } else {
+            complexity = size * (log(size) / log(2));
+        }
+        const bench_summary_t *comps = &res->extra[0], *swaps = &res->extra[1];
+        fprintf(fp, "%s,%zu,%.2f,%.2f,%.2f,%.2f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f\n",
+               algo, res->params.size, res->min, res->max, res->mean, res->median,
+               comps->min / complexity, comps->max / complexity, comps->mean / complexity, comps->median / complexity,
+               swaps->min / complexity, swaps->max / complexity, swaps->mean / complexity, swaps->median / complexity);
+    }
+    free(results);
     fclose(fp);
     return 0;
-}
\ No newline at end of file
+}
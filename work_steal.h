@@ -0,0 +1,296 @@
+// Work-stealing task pool: one Chase-Lev deque per worker, owners push and pop at the bottom,
+// idle workers steal from the top of a random victim. Tasks are caller-owned ws_task_t records
+// (no allocation per spawn) and complete into a ws_group_t counter; ws_wait() runs tasks until
+// the group drains, so fork-join code can spawn from inside tasks.
+//
+// The thread that calls ws_pool_init() acts as worker 0 while it is inside ws_wait(); only that
+// thread may spawn from outside a task.
+#ifndef WORK_STEAL_H
+#define WORK_STEAL_H
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <immintrin.h>
+
+#define WS_DEQUE_SIZE 4096     // per-worker deque capacity (power of two); a full deque runs the task inline
+#define WS_SPIN_ROUNDS 64      // failed steal rounds before an idle worker sleeps
+
+typedef struct ws_task ws_task_t;
+typedef struct ws_pool ws_pool_t;
+
+typedef struct {
+    atomic_long pending;
+} ws_group_t;
+
+struct ws_task {
+    void (*fn)(ws_task_t *task);
+    ws_group_t *group;
+};
+
+typedef struct {
+    _Alignas(64) atomic_long top;
+    _Alignas(64) atomic_long bottom;
+    _Atomic(ws_task_t *) *buf;
+} ws_deque_t;
+
+typedef struct {
+    _Alignas(64) uint64_t tasks;
+    uint64_t steals;            // tasks taken from another worker's deque
+    uint64_t steal_attempts;
+    uint64_t busy_ns;           // time spent running tasks
+} ws_worker_stats_t;
+
+typedef struct {
+    ws_pool_t *pool;
+    int index;
+    int depth;                  // nesting of ws_run through ws_wait inside a task
+    uint64_t rng;
+    ws_deque_t deque;
+    ws_worker_stats_t stats;
+    pthread_t thread;
+} ws_worker_t;
+
+struct ws_pool {
+    int nthreads;
+    ws_worker_t *workers;
+    atomic_int stop;
+    atomic_int sleepers;
+    pthread_mutex_t sleep_lock;
+    pthread_cond_t sleep_cond;
+    uint64_t start_ns;
+};
+
+static _Thread_local ws_worker_t *ws_self = NULL;
+
+static inline uint64_t ws_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static inline int ws_deque_push(ws_deque_t *d, ws_task_t *task) {
+    long b = atomic_load_explicit(&d->bottom, memory_order_relaxed);
+    long t = atomic_load_explicit(&d->top, memory_order_acquire);
+    if (b - t >= WS_DEQUE_SIZE) return -1;
+    atomic_store_explicit(&d->buf[b & (WS_DEQUE_SIZE - 1)], task, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+    return 0;
+}
+
+static inline ws_task_t *ws_deque_pop(ws_deque_t *d) {
+    long b = atomic_load_explicit(&d->bottom, memory_order_relaxed) - 1;
+    atomic_store_explicit(&d->bottom, b, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    long t = atomic_load_explicit(&d->top, memory_order_relaxed);
+    ws_task_t *task = NULL;
+    if (t <= b) {
+        task = atomic_load_explicit(&d->buf[b & (WS_DEQUE_SIZE - 1)], memory_order_relaxed);
+        if (t == b) {
+            // Last entry: race the thieves for it
+            if (!atomic_compare_exchange_strong_explicit(&d->top, &t, t + 1, memory_order_seq_cst,
+                                                         memory_order_relaxed)) {
+                task = NULL;
+            }
+            atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+        }
+    } else {
+        atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+    }
+    return task;
+}
+
+static inline ws_task_t *ws_deque_steal(ws_deque_t *d) {
+    long t = atomic_load_explicit(&d->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    long b = atomic_load_explicit(&d->bottom, memory_order_acquire);
+    if (t >= b) return NULL;
+    ws_task_t *task = atomic_load_explicit(&d->buf[t & (WS_DEQUE_SIZE - 1)], memory_order_relaxed);
+    if (!atomic_compare_exchange_strong_explicit(&d->top, &t, t + 1, memory_order_seq_cst, memory_order_relaxed)) {
+        return NULL;
+    }
+    return task;
+}
+
+static inline void ws_run(ws_worker_t *self, ws_task_t *task) {
+    ws_group_t *group = task->group;
+    uint64_t start = self->depth++ == 0 ? ws_now_ns() : 0;
+    task->fn(task);
+    if (--self->depth == 0) self->stats.busy_ns += ws_now_ns() - start;
+    self->stats.tasks++;
+    atomic_fetch_sub_explicit(&group->pending, 1, memory_order_release);
+}
+
+// Own deque first, then one pass over random victims
+static inline ws_task_t *ws_find_task(ws_worker_t *self) {
+    ws_task_t *task = ws_deque_pop(&self->deque);
+    if (task) return task;
+    ws_pool_t *pool = self->pool;
+    for (int i = 0; i < pool->nthreads - 1; i++) {
+        self->rng ^= self->rng << 13;
+        self->rng ^= self->rng >> 7;
+        self->rng ^= self->rng << 17;
+        int victim = (int)(self->rng % (uint64_t)pool->nthreads);
+        if (victim == self->index) victim = (victim + 1) % pool->nthreads;
+        self->stats.steal_attempts++;
+        task = ws_deque_steal(&pool->workers[victim].deque);
+        if (task) {
+            self->stats.steals++;
+            return task;
+        }
+    }
+    return NULL;
+}
+
+static inline int ws_any_work(ws_pool_t *pool) {
+    for (int i = 0; i < pool->nthreads; i++) {
+        ws_deque_t *d = &pool->workers[i].deque;
+        if (atomic_load(&d->bottom) > atomic_load(&d->top)) return 1;
+    }
+    return 0;
+}
+
+static inline void *ws_worker_main(void *arg) {
+    ws_worker_t *self = arg;
+    ws_pool_t *pool = self->pool;
+    ws_self = self;
+    int idle = 0;
+    while (!atomic_load_explicit(&pool->stop, memory_order_acquire)) {
+        ws_task_t *task = ws_find_task(self);
+        if (task) {
+            ws_run(self, task);
+            idle = 0;
+            continue;
+        }
+        if (++idle < WS_SPIN_ROUNDS) {
+            _mm_pause();
+            continue;
+        }
+        // Sleep until a spawn signals; the timeout only guards against a missed wake-up
+        pthread_mutex_lock(&pool->sleep_lock);
+        atomic_fetch_add(&pool->sleepers, 1);
+        if (!ws_any_work(pool) && !atomic_load(&pool->stop)) {
+            struct timespec ts;
+            clock_gettime(CLOCK_REALTIME, &ts);
+            ts.tv_nsec += 1000000;
+            if (ts.tv_nsec >= 1000000000) {
+                ts.tv_sec++;
+                ts.tv_nsec -= 1000000000;
+            }
+            pthread_cond_timedwait(&pool->sleep_cond, &pool->sleep_lock, &ts);
+        }
+        atomic_fetch_sub(&pool->sleepers, 1);
+        pthread_mutex_unlock(&pool->sleep_lock);
+        idle = 0;
+    }
+    return NULL;
+}
+
+// Start a pool of nthreads workers (0 = all online cores), counting the calling thread
+static inline int ws_pool_init(ws_pool_t *pool, int nthreads) {
+    if (nthreads <= 0) nthreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (nthreads <= 0) nthreads = 1;
+    pool->nthreads = nthreads;
+    pool->workers = aligned_alloc(64, (size_t)nthreads * sizeof(ws_worker_t));
+    if (!pool->workers) return -1;
+    memset(pool->workers, 0, (size_t)nthreads * sizeof(ws_worker_t));
+    atomic_init(&pool->stop, 0);
+    atomic_init(&pool->sleepers, 0);
+    pthread_mutex_init(&pool->sleep_lock, NULL);
+    pthread_cond_init(&pool->sleep_cond, NULL);
+    for (int i = 0; i < nthreads; i++) {
+        ws_worker_t *w = &pool->workers[i];
+        w->pool = pool;
+        w->index = i;
+        w->rng = 0x9E3779B97F4A7C15ULL * (uint64_t)(i + 1);
+        atomic_init(&w->deque.top, 0);
+        atomic_init(&w->deque.bottom, 0);
+        w->deque.buf = calloc(WS_DEQUE_SIZE, sizeof(*w->deque.buf));
+    }
+    ws_self = &pool->workers[0];
+    pool->start_ns = ws_now_ns();
+    for (int i = 1; i < nthreads; i++) {
+        pthread_create(&pool->workers[i].thread, NULL, ws_worker_main, &pool->workers[i]);
+    }
+    return 0;
+}
+
+// Stop and join the worker threads, after which their counters can be read; idempotent
+static inline void ws_pool_stop(ws_pool_t *pool) {
+    if (atomic_exchange(&pool->stop, 1)) return;
+    pthread_mutex_lock(&pool->sleep_lock);
+    pthread_cond_broadcast(&pool->sleep_cond);
+    pthread_mutex_unlock(&pool->sleep_lock);
+    for (int i = 1; i < pool->nthreads; i++) pthread_join(pool->workers[i].thread, NULL);
+}
+
+static inline void ws_pool_destroy(ws_pool_t *pool) {
+    ws_pool_stop(pool);
+    for (int i = 0; i < pool->nthreads; i++) free(pool->workers[i].deque.buf);
+    if (ws_self && ws_self->pool == pool) ws_self = NULL;
+    pthread_mutex_destroy(&pool->sleep_lock);
+    pthread_cond_destroy(&pool->sleep_cond);
+    free(pool->workers);
+}
+
+// Index of the calling worker, or -1 outside the pool
+static inline int ws_worker_index(void) {
+    return ws_self ? ws_self->index : -1;
+}
+
+static inline void ws_group_init(ws_group_t *group) {
+    atomic_init(&group->pending, 0);
+}
+
+// Queue task on the calling worker's deque
+static inline void ws_spawn(ws_group_t *group, ws_task_t *task) {
+    ws_worker_t *self = ws_self;
+    task->group = group;
+    atomic_fetch_add_explicit(&group->pending, 1, memory_order_relaxed);
+    if (ws_deque_push(&self->deque, task) != 0) {
+        ws_run(self, task);
+        return;
+    }
+    ws_pool_t *pool = self->pool;
+    if (atomic_load(&pool->sleepers) > 0) {
+        pthread_mutex_lock(&pool->sleep_lock);
+        pthread_cond_signal(&pool->sleep_cond);
+        pthread_mutex_unlock(&pool->sleep_lock);
+    }
+}
+
+// Run queued and stolen tasks until every task spawned into group has finished
+static inline void ws_wait(ws_group_t *group) {
+    ws_worker_t *self = ws_self;
+    while (atomic_load_explicit(&group->pending, memory_order_acquire) > 0) {
+        ws_task_t *task = ws_find_task(self);
+        if (task) {
+            ws_run(self, task);
+        } else {
+            _mm_pause();
+        }
+    }
+}
+
+// Summed counters since ws_pool_init; utilization is busy time over threads * wall time.
+// Workers update their counters unsynchronized, so call this after ws_pool_stop.
+static inline void ws_pool_totals(ws_pool_t *pool, ws_worker_stats_t *total, double *utilization) {
+    memset(total, 0, sizeof(*total));
+    for (int i = 0; i < pool->nthreads; i++) {
+        const ws_worker_stats_t *s = &pool->workers[i].stats;
+        total->tasks += s->tasks;
+        total->steals += s->steals;
+        total->steal_attempts += s->steal_attempts;
+        total->busy_ns += s->busy_ns;
+    }
+    double wall = (double)(ws_now_ns() - pool->start_ns);
+    *utilization = wall > 0 ? (double)total->busy_ns / (wall * pool->nthreads) : 0.0;
+}
+
+#endif